@@ -1,21 +1,47 @@
 #ifndef LOO_INCLUDE_LOO_AABB_HPP
 #define LOO_INCLUDE_LOO_AABB_HPP
 
+#include <cstddef>
 #include <glm/mat4x4.hpp>
 #include <glm/vec3.hpp>
 
+#include "predefs.hpp"
+
 namespace loo {
 struct AABB {
     glm::vec3 min, max;
     AABB();
     AABB(const glm::vec3& min, const glm::vec3& max) : min(min), max(max) {}
-    AABB(const AABB& aabb) : min(aabb.min), max(aabb.max) {}
+    AABB(const AABB& aabb) = default;
     void merge(const AABB& aabb);
+    // Bounds of the box moved by an affine matrix (the last row is ignored),
+    // after Arvo: the center goes through the matrix, the half extent
+    // through its absolute 3x3 part. Empty boxes stay empty.
     AABB transform(const glm::mat4& mat) const;
+    // bounds of the 8 corners after the matrix and the perspective divide,
+    // for projections; corners behind the eye make it meaningless
+    AABB transformProjective(const glm::mat4& mat) const;
     glm::vec3 getCenter() const;
     glm::vec3 getDiagonal() const;
     float getVolume() const;
+    bool isEmpty() const;
+};
+
+// boxes as center and half extent arrays, the layout batched kernels want
+struct AABBArrays {
+    float* centerX;
+    float* centerY;
+    float* centerZ;
+    float* extentX;
+    float* extentY;
+    float* extentZ;
 };
+
+// AABB::transform of count boxes by as many affine matrices, 8 at a time with
+// AVX2 or 4 with SSE. boxes is only read and may be the same arrays as result.
+LOO_EXPORT void transformAABBs(const AABBArrays& boxes,
+                               const glm::mat4* matrices, size_t count,
+                               const AABBArrays& result);
 };  // namespace loo
 
 #endif /* LOO_INCLUDE_LOO_AABB_HPP */
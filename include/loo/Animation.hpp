@@ -6,9 +6,12 @@
 #include <string>
 #include <vector>
 #include "Bone.hpp"
+#include "Pose.hpp"
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
 namespace loo {
+class ThreadPool;
+
 struct AssimpNodeData {
     glm::mat4 transformation;
     std::string name;
@@ -16,6 +19,23 @@ struct AssimpNodeData {
     std::vector<AssimpNodeData> children;
 };
 
+// AssimpNodeData flattened into arrays, joints are sorted parents first so
+// that a pose is evaluated in a single forward pass without any name lookup
+struct Skeleton {
+    // -1 for the root
+    std::vector<int> parents;
+    // in Animation::bones, -1 for joints without keys
+    std::vector<int> channels;
+    // in Animation::boneMatrices and the final matrices, -1 for joints which
+    // move no vertex
+    std::vector<int> boneIndices;
+    // local transform of joints without keys
+    std::vector<glm::mat4> bindLocalTransforms;
+    std::vector<std::string> names;
+
+    size_t size() const { return parents.size(); }
+};
+
 class Animation {
    public:
     Animation() = default;
@@ -30,7 +50,9 @@ class Animation {
           bones(std::move(bones)),
           rootNode(std::move(rootNode)),
           boneIndexMap(std::move(boneIndexMap)),
-          boneMatrices(std::move(boneMatrices)) {}
+          boneMatrices(std::move(boneMatrices)) {
+        compileSkeleton();
+    }
 
     ~Animation() = default;
 
@@ -51,60 +73,40 @@ class Animation {
 
     std::map<std::string, int> boneIndexMap;
     std::vector<glm::mat4> boneMatrices;
+    // rootNode compiled against bones and boneIndexMap
+    Skeleton skeleton;
+
+   private:
+    void compileSkeleton();
 };
 
 class Animator {
    public:
-    Animator(std::unique_ptr<Animation> animation)
-        : m_currentAnimation(std::move(animation)), m_currentTime(0.0f) {
+    Animator(std::shared_ptr<Animation> animation = nullptr)
+        : m_currentTime(0.0f) {
 
         finalBoneMatrices.reserve(BONES_MAX_COUNT);
 
         for (int i = 0; i < BONES_MAX_COUNT; i++)
             finalBoneMatrices.push_back(glm::identity<glm::mat4>());
+        resetAnimation(std::move(animation));
     }
 
-    void updateAnimation(float dt) {
-        if (m_currentAnimation) {
-            m_currentTime += m_currentAnimation->ticksPerSecond * dt;
-            m_currentTime = fmod(m_currentTime, m_currentAnimation->duration);
-            calculateBoneTransform(&m_currentAnimation->rootNode,
-                                   glm::identity<glm::mat4>());
-        }
-    }
-
-    void resetAnimation(std::shared_ptr<Animation> animation) {
-        m_currentAnimation = animation;
-        m_currentTime = 0.0f;
-    }
-
-    void calculateBoneTransform(const AssimpNodeData* node,
-                                glm::mat4 parentTransform) {
-        std::string nodeName = node->name;
-        glm::mat4 nodeTransform = node->transformation;
-
-        Bone* bone = m_currentAnimation->findBone(nodeName);
+    void updateAnimation(float dt);
+    // the two halves of updateAnimation: move the clock, then write the pose
+    // to getBoneCount() matrices at palette
+    void advanceTime(float dt);
+    void evaluate(glm::mat4* palette);
 
-        if (bone) {
-            bone->update(m_currentTime);
-            nodeTransform = bone->localTransform;
-        }
-
-        glm::mat4 globalTransformation = parentTransform * nodeTransform;
-
-        auto boneInfoMap = m_currentAnimation->boneIndexMap;
-        if (boneInfoMap.find(nodeName) != boneInfoMap.end()) {
-            int index = boneInfoMap[nodeName];
-            glm::mat4 offset = m_currentAnimation->boneMatrices[index];
-            finalBoneMatrices[index] = globalTransformation * offset;
-        }
-
-        for (int i = 0; i < node->childrenCount; i++) {
-            calculateBoneTransform(&node->children[i], globalTransformation);
-        }
-    }
+    void resetAnimation(std::shared_ptr<Animation> animation);
 
     bool hasAnimation() { return m_currentAnimation != nullptr; }
+    // matrices evaluate() writes
+    size_t getBoneCount() const {
+        return m_currentAnimation ? m_currentAnimation->boneMatrices.size()
+                                  : 0;
+    }
+    float getCurrentTime() const { return m_currentTime; }
 
     std::vector<glm::mat4> finalBoneMatrices;
     std::vector<glm::mat4> boneMatrices;
@@ -112,10 +114,52 @@ class Animator {
    private:
     std::shared_ptr<Animation> m_currentAnimation;
     float m_currentTime;
+    // model space transform of every joint, sized once per animation
+    std::vector<glm::mat4> m_globalTransforms;
+    // by Animation::bones, the animation itself is never modified
+    std::vector<BoneCursor> m_cursors;
+    PoseSampler m_sampler;
+    // by Animation::bones
+    std::vector<glm::mat4> m_localTransforms;
+    // by bone index, global transforms waiting for their offset matrix
+    std::vector<glm::mat4> m_boneGlobals;
 };
 
 std::shared_ptr<Animation> createAnimationFromAssimp(
     const aiScene& assimpScene, std::map<std::string, int>& boneIndexMap,
     std::vector<glm::mat4>& boneOffsetMatrices);
+
+// Play the animation forward over frameCount frames, sampling every bone with
+// a linear key search from the first key (the old Bone path) and with
+// Bone::sample, and log both timings. Returns how many times faster sample()
+// is.
+double measureKeyframeSampling(const Animation& animation,
+                               size_t frameCount = 1000);
+
+// Animators of a crowd updated together, one pool task per animator. Every
+// animator evaluates with its own scratch buffers straight into a shared
+// palette, so the hot path takes no lock and allocates nothing once the set
+// of animators is stable.
+class AnimatorBatch {
+   public:
+    // advance and evaluate every animator, ThreadPool::global() if pool is
+    // null; the animators must stay alive for the call only
+    void update(const std::vector<Animator*>& animators, float dt,
+                ThreadPool* pool = nullptr);
+    // bone matrices of every animator back to back, ready for one upload
+    const std::vector<glm::mat4>& getPalette() const { return m_palette; }
+    // first palette matrix of animators[i] in the last update()
+    size_t getPaletteOffset(size_t i) const { return m_offsets[i]; }
+
+   private:
+    std::vector<glm::mat4> m_palette;
+    std::vector<size_t> m_offsets;
+};
+
+// Update characterCount animators of the animation for frameCount frames on
+// pools of 1, 4 and 16 threads, and log characters per millisecond for each.
+void measureAnimatorBatch(std::shared_ptr<Animation> animation,
+                          size_t characterCount = 1000,
+                          size_t frameCount = 100);
 }  // namespace loo
 #endif /* LOO_INCLUDE_LOO_ANIMATION_HPP */
@@ -0,0 +1,149 @@
+#ifndef LOO_INCLUDE_LOO_BVH_HPP
+#define LOO_INCLUDE_LOO_BVH_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "AABB.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+class Scene;
+class ThreadPool;
+
+constexpr uint32_t BVH_INVALID_INDEX = ~0u;
+// primitives per leaf at most
+constexpr size_t BVH_MAX_LEAF_SIZE = 8;
+
+struct Ray {
+    glm::vec3 origin;
+    // need not be normalized, distances are in units of its length
+    glm::vec3 direction;
+    float tMin{0.0f};
+    float tMax{std::numeric_limits<float>::infinity()};
+};
+
+struct RayHit {
+    float t{std::numeric_limits<float>::infinity()};
+    // barycentrics of vertices 1 and 2
+    float u{0.0f}, v{0.0f};
+    // triangle t uses Mesh::indices[3t .. 3t + 2]
+    uint32_t triangle{BVH_INVALID_INDEX};
+    // in Scene::getMeshes() and its Mesh::instances, SceneBVH only
+    uint32_t mesh{BVH_INVALID_INDEX};
+    uint32_t instance{BVH_INVALID_INDEX};
+
+    bool isHit() const { return triangle != BVH_INVALID_INDEX; }
+};
+
+// four child boxes in SoA layout so that one ray is tested against all of
+// them at once
+struct alignas(16) BVH4Node {
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+    // node index for inner children, first primitive for leaves
+    uint32_t child[4];
+    // primitives of a leaf, 0 for inner nodes and empty slots
+    uint32_t count[4];
+
+    bool isLeaf(int i) const { return count[i] != 0; }
+    bool isEmpty(int i) const {
+        return count[i] == 0 && child[i] == BVH_INVALID_INDEX;
+    }
+};
+static_assert(sizeof(BVH4Node) == 128, "two cache lines per node");
+
+// 4-wide bounding volume hierarchy over a set of primitive bounds. The build
+// is a top-down binned SAH split into a binary tree (subtrees run in parallel)
+// which is then collapsed by opening the largest children first.
+class LOO_EXPORT BVH4 {
+   public:
+    void build(const std::vector<AABB>& bounds, ThreadPool* pool = nullptr);
+    const std::vector<BVH4Node>& getNodes() const { return m_nodes; }
+    // leaves cover ranges of this array, which holds input primitive indices
+    const std::vector<uint32_t>& getPrimitiveOrder() const { return m_order; }
+    const AABB& getBounds() const { return m_bounds; }
+    bool isEmpty() const { return m_nodes.empty(); }
+
+   private:
+    std::vector<BVH4Node> m_nodes;
+    std::vector<uint32_t> m_order;
+    AABB m_bounds;
+};
+
+// Triangle BVH of a mesh in object space, built from its vertices or from its
+// positions when only those are resident (see MeshResidency).
+class LOO_EXPORT MeshBVH {
+   public:
+    MeshBVH() = default;
+    explicit MeshBVH(const Mesh& mesh, ThreadPool* pool = nullptr) {
+        build(mesh, pool);
+    }
+    void build(const Mesh& mesh, ThreadPool* pool = nullptr);
+    void build(const std::vector<glm::vec3>& positions,
+               const std::vector<unsigned int>& indices,
+               ThreadPool* pool = nullptr);
+
+    // closest hit within [ray.tMin, min(ray.tMax, hit.t)], hit is only
+    // written when something closer is found
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    // any hit within [ray.tMin, ray.tMax], for visibility rays
+    bool occluded(const Ray& ray) const;
+    const AABB& getBounds() const { return m_bvh.getBounds(); }
+    size_t countNodes() const { return m_bvh.getNodes().size(); }
+    size_t countTriangles() const { return m_triangles.size(); }
+
+   private:
+    // Moller-Trumbore setup, in leaf order
+    struct Triangle {
+        glm::vec3 v0, edge1, edge2;
+        uint32_t index;
+    };
+
+    BVH4 m_bvh;
+    std::vector<Triangle> m_triangles;
+};
+
+// Top level BVH over the mesh instances of a scene in world space (scene model
+// matrix times the instance matrix), rays are moved into each instance's
+// object space. Mesh BVHs are built in parallel and shared by the instances
+// of a mesh and between rebuilds.
+class LOO_EXPORT SceneBVH {
+   public:
+    void build(const Scene& scene, ThreadPool* pool = nullptr);
+    // rebuild the top level only, after meshes or the scene moved
+    void updateTransforms(const Scene& scene);
+
+    bool intersect(const Ray& ray, RayHit& hit) const;
+    bool occluded(const Ray& ray) const;
+    const AABB& getBounds() const { return m_bvh.getBounds(); }
+    size_t countInstances() const { return m_instances.size(); }
+
+   private:
+    struct Instance {
+        std::shared_ptr<const MeshBVH> bvh;
+        glm::mat4 worldToObject;
+        uint32_t mesh;
+        uint32_t instance;
+    };
+
+    BVH4 m_bvh;
+    std::vector<Instance> m_instances;
+    // by mesh, null for meshes without triangles
+    std::vector<std::shared_ptr<const MeshBVH>> m_meshBVHs;
+};
+
+// Trace rayCount random rays through the scene bounds on every thread of the
+// pool and log the throughput, returns Mrays/s
+LOO_EXPORT double measureRayThroughput(const SceneBVH& bvh,
+                                       size_t rayCount = 1 << 20,
+                                       bool anyHit = false,
+                                       ThreadPool* pool = nullptr);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_BVH_HPP */
@@ -0,0 +1,116 @@
+#ifndef LOO_INCLUDE_LOO_BLEND_TREE_HPP
+#define LOO_INCLUDE_LOO_BLEND_TREE_HPP
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Bone.hpp"
+#include "Pose.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+class Animation;
+class ThreadPool;
+
+// no per joint weights, the node weight applies to every joint
+constexpr size_t BLEND_NO_MASK = static_cast<size_t>(-1);
+
+// Clips sampled into local poses over the Skeleton of one animation and
+// combined by blend and additive nodes. Every node writes a pose of every
+// joint in the BonePoseArrays layout and is evaluated after the nodes it
+// reads, in the order they were added; the last node is the output. Building
+// allocates, playing and evaluating don't.
+class LOO_EXPORT BlendTree {
+   public:
+    // joints, bind pose and offset matrices come from skeleton, which may be
+    // one of the clips
+    explicit BlendTree(std::shared_ptr<Animation> skeleton);
+
+    // Sample clip, matching its bones to joints by name. Joints it has no
+    // keys for keep the bind pose.
+    size_t addClip(std::shared_ptr<Animation> clip);
+    // from a to b by weight, scaled per joint by the mask
+    size_t addBlend(size_t a, size_t b, float weight = 0.5f,
+                    size_t mask = BLEND_NO_MASK);
+    // What the clip of node additive does relative to its first frame, on
+    // top of base by weight, scaled per joint by the mask. additive must be
+    // a clip node.
+    size_t addAdditive(size_t base, size_t additive, float weight = 1.0f,
+                       size_t mask = BLEND_NO_MASK);
+    // one weight per joint of the skeleton, for addBlend and addAdditive
+    size_t addMask(std::vector<float> jointWeights);
+    // weight on joint and everything below it, 0 elsewhere, e.g. the upper
+    // body from the spine
+    std::vector<float> makeSubtreeMask(const std::string& joint,
+                                       float weight = 1.0f) const;
+
+    // weight of a blend or additive node
+    void setWeight(size_t node, float weight);
+    float getWeight(size_t node) const;
+    // move the weight to target over seconds of advance(), for transitions
+    void fadeWeight(size_t node, float target, float seconds);
+    // time of a clip node in ticks
+    void setTime(size_t node, float time);
+    float getTime(size_t node) const;
+    // every clip by dt seconds, looping, and every fade
+    void advance(float dt);
+    // write the output pose to getBoneCount() matrices at palette, like
+    // Animator::evaluate
+    void evaluate(glm::mat4* palette);
+
+    size_t getNodeCount() const { return m_nodes.size(); }
+    size_t getJointCount() const { return m_jointCount; }
+    size_t getBoneCount() const { return m_boneGlobals.size(); }
+    // local pose of a joint as of the last evaluate()
+    BonePose getLocalPose(size_t joint) const;
+
+   private:
+    enum class NodeType { Clip, Blend, Additive };
+    struct Node {
+        NodeType type;
+        size_t inputs[2]{0, 0};
+        size_t mask{BLEND_NO_MASK};
+        float weight{0.0f};
+        // fadeWeight() target and change per second
+        float targetWeight{0.0f};
+        float fadeRate{0.0f};
+        // clip nodes
+        std::shared_ptr<Animation> clip;
+        float time{0.0f};
+        // by joint, -1 for joints keeping the bind pose
+        std::vector<int> channels;
+        std::vector<BoneCursor> cursors;
+        PoseSampler sampler;
+        // clip nodes read by additive nodes, their first frame inverted
+        PoseBuffer inverseReference;
+        // blend and additive nodes
+        PoseBuffer pose;
+    };
+
+    BonePoseArrays getOutput(size_t node);
+    size_t addNode(Node node);
+
+    std::shared_ptr<Animation> m_skeleton;
+    size_t m_jointCount{0};
+    std::vector<BonePose> m_bindPoses;
+    std::vector<Node> m_nodes;
+    std::vector<std::vector<float>> m_masks;
+    // scratch of evaluate(), sized by the constructor
+    std::vector<float> m_factors;
+    std::vector<glm::mat4> m_localTransforms;
+    std::vector<glm::mat4> m_globalTransforms;
+    // by bone index, global transforms waiting for their offset matrix
+    std::vector<glm::mat4> m_boneGlobals;
+};
+
+// Evaluate characterCount copies of tree for frameCount frames at 60 Hz on
+// every hardware thread and log characters per millisecond, along with the
+// share of a 60 Hz frame the whole crowd takes.
+LOO_EXPORT void measureBlendTree(const BlendTree& tree,
+                                 size_t characterCount = 1000,
+                                 size_t frameCount = 100);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_BLEND_TREE_HPP */
@@ -1,6 +1,7 @@
 #ifndef LOO_INCLUDE_LOO_BONE_HPP
 #define LOO_INCLUDE_LOO_BONE_HPP
 #include <assimp/anim.h>
+#include <cstdint>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/matrix.hpp>
 #include <glm/vec3.hpp>
@@ -25,27 +26,70 @@ struct KeyScale {
     float timeStamp;
 };
 
+// key times and values of one channel in separate arrays, times increase
+template <typename T>
+struct KeyTrack {
+    std::vector<float> times;
+    std::vector<T> values;
+
+    size_t size() const { return times.size(); }
+    // Key i of the pair (i, i + 1) around time, clamped to the first and
+    // last pair. Playback moving forward finds it a few steps from cursor,
+    // seeks and loop wraps fall back to a binary search. cursor is left on
+    // the result.
+    size_t findKey(float time, uint32_t& cursor) const;
+    // interpolation factor between key and key + 1, clamped to [0, 1]
+    float getFactor(size_t key, float time) const;
+};
+
+// where each track of a bone was last sampled, kept by whoever plays the
+// animation so that bones can be shared
+struct BoneCursor {
+    uint32_t position{0};
+    uint32_t rotation{0};
+    uint32_t scale{0};
+};
+
+// local transform of a bone split into its parts
+struct BonePose {
+    glm::vec3 translation{0.0f};
+    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale{1.0f};
+
+    glm::mat4 toMatrix() const;
+};
+
 class Bone {
    private:
-    std::vector<KeyPosition> m_positions;
-    std::vector<KeyRotation> m_rotations;
-    std::vector<KeyScale> m_scales;
+    KeyTrack<glm::vec3> m_positions;
+    KeyTrack<glm::quat> m_rotations;
+    KeyTrack<glm::vec3> m_scales;
+    // used by update()
+    BoneCursor m_cursor;
 
    public:
     /*reads keyframes from aiNodeAnim*/
     Bone(const std::string& name, int id, std::vector<KeyPosition> positions,
          std::vector<KeyRotation> rotations, std::vector<KeyScale> scales);
 
+    // interpolate the three tracks at animationTime, the bone is left alone
+    BonePose sample(float animationTime, BoneCursor& cursor) const;
+
     /*interpolates  b/w positions,rotations & scaling keys based on the curren time of 
     the animation and prepares the local transformation matrix by combining all keys 
     tranformations*/
     void update(float animationTime) {
-        glm::mat4 translation = interpolatePosition(animationTime);
-        glm::mat4 rotation = interpolateRotation(animationTime);
-        glm::mat4 scale = interpolateScaling(animationTime);
-        localTransform = translation * rotation * scale;
+        localTransform = sample(animationTime, m_cursor).toMatrix();
     }
 
+    std::vector<KeyPosition> getPositionKeys() const;
+    std::vector<KeyRotation> getRotationKeys() const;
+    std::vector<KeyScale> getScaleKeys() const;
+    const KeyTrack<glm::vec3>& getPositionTrack() const { return m_positions; }
+    const KeyTrack<glm::quat>& getRotationTrack() const { return m_rotations; }
+    const KeyTrack<glm::vec3>& getScaleTrack() const { return m_scales; }
+
+    // linear scans from the first key, sample() doesn't use them
     int getPositionIndex(float animationTime);
     int getRotationIndex(float animationTime);
     int getScaleIndex(float animationTime);
@@ -53,16 +97,6 @@ class Bone {
     glm::mat4 localTransform;
     std::string name;
     int id;
-
-   private:
-    float getScaleFactor(float lastTimeStamp, float nextTimeStamp,
-                         float animationTime);
-
-    glm::mat4 interpolatePosition(float animationTime);
-
-    glm::mat4 interpolateRotation(float animationTime);
-
-    glm::mat4 interpolateScaling(float animationTime);
 };
 
 Bone createBoneFromAssimp(const std::string& name, int id,
@@ -0,0 +1,97 @@
+#ifndef LOO_INCLUDE_LOO_CLIP_COMPRESSION_HPP
+#define LOO_INCLUDE_LOO_CLIP_COMPRESSION_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <string>
+#include <vector>
+
+#include "Bone.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+class Animation;
+
+struct ClipCompressionOptions {
+    // largest error key reduction may add to a joint, on top of the
+    // quantization: distance for translations, radians for rotations and
+    // per component for scales
+    float translationTolerance{1e-3f};
+    float rotationTolerance{1e-3f};
+    float scaleTolerance{1e-3f};
+};
+
+// One channel of a compressed bone, 8 bytes a key instead of 16 or 20.
+// Constant channels keep a single value and no key.
+struct CompressedTrack {
+    // key times in CompressedClip::timeStep units
+    std::vector<uint16_t> times;
+    // 3 words a key: translations and scales are quantized over [min,
+    // min + 65535 * step], rotations are stored as their smallest three
+    // components in 15 bits each plus the index of the largest in 2 bits
+    std::vector<uint16_t> values;
+    glm::vec3 min{0.0f}, step{0.0f};
+    // xyz or a quaternion as xyzw, for constant tracks
+    glm::vec4 constant{0.0f};
+
+    size_t size() const { return times.size(); }
+    size_t getByteSize() const;
+};
+
+struct CompressedBone {
+    std::string name;
+    int id;
+    CompressedTrack translation, rotation, scale;
+};
+
+// Bones of an animation with constant channels folded, keys that linear
+// interpolation of their neighbours reproduces within the tolerances dropped,
+// and everything left quantized. Rotations are interpolated with nlerp, the
+// tolerance covers the difference to the original slerp at every key.
+class LOO_EXPORT CompressedClip {
+   public:
+    CompressedClip() = default;
+    explicit CompressedClip(const Animation& animation,
+                            const ClipCompressionOptions& options = {});
+
+    size_t size() const { return bones.size(); }
+    // like Bone::sample, cursor belongs to the caller
+    BonePose sample(size_t bone, float animationTime,
+                    BoneCursor& cursor) const;
+    size_t getByteSize() const;
+
+    float duration{0.0f};
+    int ticksPerSecond{0};
+    // ticks per unit of the key times, the spacing of the keys when they
+    // are on a grid which makes the times exact, else duration / 65535
+    float timeStep{1.0f};
+    // in the order of Animation::bones
+    std::vector<CompressedBone> bones;
+};
+
+struct ClipCompressionReport {
+    size_t rawByteSize{0};
+    size_t compressedByteSize{0};
+    // raw over compressed size
+    float ratio{0.0f};
+    size_t rawKeyCount{0};
+    size_t keyCount{0};
+    size_t constantTrackCount{0};
+    // largest differences in joint (bone local) space over the sampled frames
+    float maxTranslationError{0.0f};
+    float maxRotationError{0.0f};
+    float maxScaleError{0.0f};
+    // both sampled with cursors over the same frames
+    double rawSampleMs{0.0};
+    double compressedSampleMs{0.0};
+};
+
+// Compare the clip with the animation it was compressed from at frameCount
+// times over its duration, time the sampling of both and log the report.
+LOO_EXPORT ClipCompressionReport
+measureClipCompression(const Animation& animation, const CompressedClip& clip,
+                       size_t frameCount = 1000);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_CLIP_COMPRESSION_HPP */
@@ -0,0 +1,76 @@
+#ifndef LOO_INCLUDE_LOO_FRUSTUM_HPP
+#define LOO_INCLUDE_LOO_FRUSTUM_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+#include "AABB.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+class Camera;
+class Scene;
+
+enum FrustumPlane {
+    FRUSTUM_PLANE_LEFT = 0,
+    FRUSTUM_PLANE_RIGHT,
+    FRUSTUM_PLANE_BOTTOM,
+    FRUSTUM_PLANE_TOP,
+    FRUSTUM_PLANE_NEAR,
+    FRUSTUM_PLANE_FAR,
+    FRUSTUM_PLANE_COUNT
+};
+
+struct LOO_EXPORT Frustum {
+    // normalized, dot(plane.xyz, p) + plane.w >= 0 inside
+    glm::vec4 planes[FRUSTUM_PLANE_COUNT];
+
+    // Gribb-Hartmann extraction from projection * view (* model), in the
+    // space the matrix maps from. zeroToOne is the clip depth range of the
+    // matrix, -1..1 planes are still conservative for a 0..1 matrix. Reverse
+    // Z (near and far swapped) only swaps the two planes, an infinite far
+    // plane is replaced by one that is always passed.
+    static Frustum fromMatrix(const glm::mat4& viewProjection,
+                              bool zeroToOne = false);
+    // world space frustum of Camera::getProjectionMatrix(reverseZ01) times
+    // Camera::getViewMatrix()
+    static Frustum fromCamera(const Camera& camera, bool reverseZ01 = false);
+
+    bool intersects(const AABB& aabb) const;
+};
+
+// Boxes in SoA layout (centers and half extents) for cullFrustum, arrays are
+// padded to a multiple of 8.
+class LOO_EXPORT CullingBounds {
+   public:
+    void resize(size_t count);
+    void set(size_t index, const AABB& aabb);
+    size_t size() const { return m_count; }
+    // world space boxes of the scene meshes, in Scene::getMeshes() order, an
+    // instanced mesh gets one box around all of its instances; transformed in
+    // one transformAABBs() batch
+    void update(const Scene& scene);
+
+   private:
+    friend LOO_EXPORT size_t cullFrustum(const Frustum& frustum,
+                                         const CullingBounds& bounds,
+                                         std::vector<uint32_t>& visible);
+    size_t m_count{0};
+    std::vector<float> m_centerX, m_centerY, m_centerZ;
+    std::vector<float> m_extentX, m_extentY, m_extentZ;
+    // update() input, one entry per mesh instance
+    std::vector<float> m_instanceBoxes;
+    std::vector<glm::mat4> m_instanceMatrices;
+};
+
+// Test every box against the frustum, 8 at a time with AVX2 or 4 with SSE,
+// and write the indices of the ones inside or intersecting to visible in
+// increasing order. Returns their count.
+LOO_EXPORT size_t cullFrustum(const Frustum& frustum,
+                              const CullingBounds& bounds,
+                              std::vector<uint32_t>& visible);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_FRUSTUM_HPP */
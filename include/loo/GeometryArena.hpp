@@ -0,0 +1,109 @@
+#ifndef LOO_INCLUDE_LOO_GEOMETRY_ARENA_HPP
+#define LOO_INCLUDE_LOO_GEOMETRY_ARENA_HPP
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "VertexFormat.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+class GeometryArena;
+
+// vertex layout of an arena vertex buffer, each one gets its own VAO
+struct GeometryLayout {
+    VertexFormat format{VertexFormat::Full};
+    // packed layouts only, see PackedVertexStream
+    bool skinned{false};
+    GLenum texCoordType{GL_HALF_FLOAT};
+
+    GLsizei getStride() const;
+    bool operator==(const GeometryLayout& other) const;
+};
+
+// first fit free list over [0, capacity), adjacent free ranges are merged
+class LOO_EXPORT RangeAllocator {
+   public:
+    // returns false when no free range is large enough
+    bool allocate(size_t size, size_t alignment, size_t& offset);
+    void free(size_t offset, size_t size);
+    void grow(size_t capacity);
+    size_t getCapacity() const { return m_capacity; }
+    size_t getUsed() const { return m_used; }
+
+   private:
+    // offset -> size
+    std::map<size_t, size_t> m_free;
+    size_t m_capacity{0};
+    size_t m_used{0};
+};
+
+// a mesh's share of an arena, given back when the last owner drops it
+struct LOO_EXPORT GeometryRange {
+    std::shared_ptr<GeometryArena> arena;
+    size_t layoutIndex{0};
+    // in vertices of the layout
+    size_t baseVertex{0}, vertexCount{0};
+    // in bytes
+    size_t indexOffset{0}, indexSize{0};
+
+    GeometryRange() = default;
+    GeometryRange(const GeometryRange&) = delete;
+    ~GeometryRange();
+};
+
+// Sub-allocates the geometry of many meshes out of a few large immutable
+// buffers: one vertex buffer and one VAO per vertex layout, and a single
+// index buffer attached to every VAO. Meshes draw with their base vertex and
+// first index, so consecutive meshes of a layout never rebind anything.
+// Buffers grow by reallocation, the VAO names stay the same. GL thread only,
+// must be owned by a shared_ptr.
+class LOO_EXPORT GeometryArena
+    : public std::enable_shared_from_this<GeometryArena> {
+   public:
+    explicit GeometryArena(size_t vertexBytes = 64 << 20,
+                           size_t indexBytes = 16 << 20);
+    GeometryArena(const GeometryArena&) = delete;
+    ~GeometryArena();
+
+    // copy vertexCount vertices of the layout and indexSize bytes of indices
+    // into the arena
+    std::shared_ptr<GeometryRange> allocate(const GeometryLayout& layout,
+                                            const void* vertexData,
+                                            size_t vertexCount,
+                                            const void* indexData,
+                                            size_t indexSize);
+    GLuint getVertexArray(size_t layoutIndex) const {
+        return m_layouts[layoutIndex].vao;
+    }
+    GLuint getIndexBuffer() const { return m_indexBuffer; }
+    size_t countLayouts() const { return m_layouts.size(); }
+    // bytes in use / reserved over every buffer
+    size_t getUsedBytes() const;
+    size_t getCapacityBytes() const;
+
+   private:
+    friend struct GeometryRange;
+    struct LayoutBuffer {
+        GeometryLayout layout;
+        GLuint vao{0}, vbo{0};
+        RangeAllocator vertices;
+    };
+
+    size_t findLayout(const GeometryLayout& layout);
+    void growVertexBuffer(LayoutBuffer& buffer, size_t minVertexCount);
+    void growIndexBuffer(size_t minSize);
+    void release(const GeometryRange& range);
+
+    std::vector<LayoutBuffer> m_layouts;
+    GLuint m_indexBuffer{0};
+    RangeAllocator m_indices;
+    size_t m_initialVertexBytes;
+};
+
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_GEOMETRY_ARENA_HPP */
@@ -0,0 +1,161 @@
+#ifndef LOO_INCLUDE_LOO_INDIRECT_DRAW_HPP
+#define LOO_INCLUDE_LOO_INDIRECT_DRAW_HPP
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <functional>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+class Material;
+
+// shader storage binding of the IndirectDrawData array, see INDIRECT_DRAW_GLSL
+constexpr GLuint INDIRECT_DRAW_DATA_BINDING = 6;
+
+// command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    // in indices of the bucket's index type
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// per draw shader data, std430 layout of INDIRECT_DRAW_GLSL
+struct IndirectDrawData {
+    glm::mat4 objectMatrix;
+    glm::mat4 objectMatrixPrev;
+    // Mesh::getPositionDecodeMatrix() split in scale and offset
+    glm::vec4 positionDecodeScale;
+    glm::vec4 positionDecodeOffset;
+    // in IndirectDrawList::getMaterials()
+    GLuint materialIndex;
+    GLuint lod;
+    GLuint padding[2];
+};
+static_assert(sizeof(IndirectDrawData) == 176, "std430 layout mismatch");
+
+enum class IndirectBucketMode {
+    // one multi draw per material, materials are bound in between
+    Material,
+    // one multi draw per alpha blend / double sided combination, for shaders
+    // fetching their material through materialIndex
+    State,
+};
+
+struct IndirectDrawOptions {
+    IndirectBucketMode bucketMode{IndirectBucketMode::Material};
+    // level of detail of every draw, clamped per mesh
+    size_t lod{0};
+};
+
+// draws sharing a vao, an index type and a material or state
+struct IndirectDrawBucket {
+    GLuint vao{0};
+    GLenum indexType{GL_UNSIGNED_INT};
+    // null with IndirectBucketMode::State
+    std::shared_ptr<Material> material;
+    bool alphaBlend{false};
+    bool doubleSided{false};
+    // range in the command buffer
+    size_t firstCommand{0}, commandCount{0};
+};
+
+// bind the material and set the state of a bucket before it is drawn
+using IndirectDrawCallback = std::function<void(const IndirectDrawBucket&)>;
+
+// Command and per draw buffers of a mesh list for glMultiDrawElementsIndirect.
+// Every mesh is one command drawing all of its Mesh::instances, each instance
+// has its draw data entry and the command's baseInstance is the first one, so
+// the vertex shader reads looDrawData[gl_BaseInstance + gl_InstanceID]
+// (looGetDrawData()). Meshes prepared into
+// a GeometryArena share the vao of their layout, so a whole bucket goes out in
+// a single call; other meshes end up in a bucket of their own. Opaque buckets
+// come before the alpha blended ones. GL thread only.
+class LOO_EXPORT IndirectDrawList {
+   public:
+    IndirectDrawList() = default;
+    IndirectDrawList(const IndirectDrawList&) = delete;
+    ~IndirectDrawList();
+
+    // sort prepared meshes into buckets, upload commands and draw data
+    void build(const std::vector<std::shared_ptr<Mesh>>& meshes,
+               const IndirectDrawOptions& options = {});
+    // upload the matrices of the meshes given to build() again
+    void updateDrawData();
+    // only those of some of them, in runs of consecutive draws
+    void updateDrawData(const std::vector<const Mesh*>& meshes);
+    // one glMultiDrawElementsIndirect per bucket with the bound program
+    void draw(const IndirectDrawCallback& beforeBucket = nullptr) const;
+
+    const std::vector<IndirectDrawBucket>& getBuckets() const {
+        return m_buckets;
+    }
+    // distinct materials in first use order
+    const std::vector<std::shared_ptr<Material>>& getMaterials() const {
+        return m_materials;
+    }
+    const IndirectDrawOptions& getOptions() const { return m_options; }
+    // whether build() last saw these meshes with as many instances and the
+    // same bucket mode and level, so updateDrawData() is enough
+    bool isBuiltFrom(const std::vector<std::shared_ptr<Mesh>>& meshes,
+                     const IndirectDrawOptions& options) const;
+    size_t countDraws() const { return m_meshes.size(); }
+    size_t countInstances() const { return m_drawData.size(); }
+
+   private:
+    void fillDrawData(size_t draw);
+
+    IndirectDrawOptions m_options;
+    // meshes given to build() and their instances, meshes without triangles
+    // included
+    size_t m_sourceMeshCount{0}, m_sourceInstanceCount{0};
+    // in draw order
+    std::vector<std::shared_ptr<Mesh>> m_meshes;
+    std::unordered_map<const Mesh*, uint32_t> m_drawIndices;
+    // draw data of draw i is [m_firstInstances[i], m_firstInstances[i + 1])
+    std::vector<GLuint> m_firstInstances;
+    std::vector<GLuint> m_materialIndices;
+    std::vector<std::shared_ptr<Material>> m_materials;
+    std::vector<IndirectDrawBucket> m_buckets;
+    std::vector<IndirectDrawData> m_drawData;
+    GLuint m_commandBuffer{0}, m_drawDataBuffer{0};
+    size_t m_commandCapacity{0}, m_drawDataCapacity{0};
+};
+
+// GLSL side of IndirectDrawData, needs GLSL 4.60 for gl_BaseInstance:
+//   LooDrawData draw = looGetDrawData();
+//   worldPos = model * draw.objectMatrix *
+//              vec4(looDecodePosition(draw, pos.xyz), 1)
+constexpr const char* INDIRECT_DRAW_GLSL = R"(
+struct LooDrawData {
+    mat4 objectMatrix;
+    mat4 objectMatrixPrev;
+    vec4 positionDecodeScale;
+    vec4 positionDecodeOffset;
+    uint materialIndex;
+    uint lod;
+    uint padding0;
+    uint padding1;
+};
+layout(std430, binding = 6) readonly buffer LooDrawDataBuffer {
+    LooDrawData looDrawData[];
+};
+LooDrawData looGetDrawData() {
+    return looDrawData[gl_BaseInstance + gl_InstanceID];
+}
+vec3 looDecodePosition(LooDrawData draw, vec3 p) {
+    return draw.positionDecodeOffset.xyz + draw.positionDecodeScale.xyz * p;
+}
+)";
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_INDIRECT_DRAW_HPP */
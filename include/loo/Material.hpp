@@ -58,6 +58,41 @@ struct MetallicRoughnessWorkFlow {
 constexpr unsigned int LOO_MATERIAL_FLAG_ALPHA_BLEND = 0x1,
                        LOO_MATERIAL_FLAG_DOUBLE_SIDED = 0x2;
 
+enum BaseMaterialTextureSlot {
+    BASE_MATERIAL_TEX_AMBIENT = 0,
+    BASE_MATERIAL_TEX_DIFFUSE,
+    BASE_MATERIAL_TEX_SPECULAR,
+    BASE_MATERIAL_TEX_DISPLACEMENT,
+    BASE_MATERIAL_TEX_NORMAL,
+    BASE_MATERIAL_TEX_OPACITY,
+    BASE_MATERIAL_TEX_HEIGHT,
+    BASE_MATERIAL_TEX_EMISSIVE,
+    BASE_MATERIAL_TEX_BASE_COLOR,
+    BASE_MATERIAL_TEX_OCCLUSION,
+    BASE_MATERIAL_TEX_METALLIC,
+    BASE_MATERIAL_TEX_ROUGHNESS,
+    BASE_MATERIAL_TEX_COUNT
+};
+
+struct MaterialTextureDesc {
+    // empty if the slot has no texture
+    std::string filename{};
+    unsigned int options{0};
+    GLenum wrap{GL_REPEAT};
+};
+
+// Plain data description of a BaseMaterial, holds no GL resource so it can
+// be built off the GL thread and serialized into the scene cache.
+struct BaseMaterialDesc {
+    BlinnPhongWorkFlow bpWorkFlow{};
+    glm::vec4 baseColor{0.0f};
+    float metallic{0.0f};
+    float roughness{0.0f};
+    glm::vec3 emissiveFactor{0.0f};
+    unsigned int flags = 0;
+    MaterialTextureDesc textures[BASE_MATERIAL_TEX_COUNT];
+};
+
 struct BaseMaterial : public Material {
 
     void bind(const ShaderProgram& sp) override { NOT_IMPLEMENTED_RUNTIME(); }
@@ -81,7 +116,16 @@ struct BaseMaterial : public Material {
     MetallicRoughnessWorkFlow mrWorkFlow;
 
     unsigned int flags = 0;
+
+    // description this material was built from, null for materials created
+    // by hand
+    std::shared_ptr<const BaseMaterialDesc> desc{};
 };
+BaseMaterialDesc createBaseMaterialDescFromAssimp(
+    const aiMaterial* aMaterial, std::filesystem::path objParent);
+// loads the textures, must be called on the GL thread
+std::shared_ptr<loo::BaseMaterial> createBaseMaterialFromDesc(
+    const BaseMaterialDesc& desc);
 std::shared_ptr<loo::BaseMaterial> createBaseMaterialFromAssimp(
     const aiMaterial* aMaterial, std::filesystem::path objParent);
 }  // namespace loo
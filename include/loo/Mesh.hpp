@@ -1,17 +1,36 @@
 #ifndef LOO_INCLUDE_LOO_MESH_HPP
 #define LOO_INCLUDE_LOO_MESH_HPP
+#include <functional>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include "AABB.hpp"
 #include "Bone.hpp"
 #include "Material.hpp"
+#include "MeshLod.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshResidency.hpp"
+#include "Meshlet.hpp"
+#include "SceneGraph.hpp"
 #include "Shader.hpp"
+#include "VertexFormat.hpp"
 #include "predefs.hpp"
 
 namespace loo {
+class GeometryArena;
+struct GeometryRange;
+
+// post-process steps of every assimp import, also part of the scene cache key
+constexpr unsigned int ASSIMP_IMPORT_FLAGS =
+    aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals |
+    aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes |
+    aiProcess_LimitBoneWeights | aiProcess_ImproveCacheLocality |
+    aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
+    aiProcess_SplitLargeMeshes | aiProcess_RemoveRedundantMaterials;
+
 struct LOO_EXPORT Vertex {
     glm::vec3 position;
     glm::vec3 normal;
@@ -26,6 +45,13 @@ struct LOO_EXPORT Vertex {
     void orthogonalizeTangent();
 };
 
+// another placement of a mesh's geometry and material, see Mesh::instances
+struct MeshInstance {
+    glm::mat4 objectMatrix;
+    glm::mat4 objectMatrixPrev;
+    uint32_t node{SCENE_GRAPH_NO_NODE};
+};
+
 struct LOO_EXPORT Mesh {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
@@ -34,12 +60,34 @@ struct LOO_EXPORT Mesh {
     glm::mat4 objectMatrix;
     glm::mat4 objectMatrixPrev;
     AABB aabb;
+    // meshlet partition of indices, empty unless buildMeshlets() ran
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshletBounds> meshletBounds;
+    // mesh vertex index of every meshlet vertex
+    std::vector<unsigned int> meshletVertices;
+    // meshlet local vertex indices, 3 per triangle
+    std::vector<uint8_t> meshletTriangles;
+    // simplified levels 1..n sharing vertices, level 0 is indices itself,
+    // empty unless generateMeshLods() ran
+    std::vector<MeshLod> lods;
+    // object space positions, only filled by
+    // releaseCpuData(MeshResidency::PositionsOnly)
+    std::vector<glm::vec3> positions;
+    // position of the mesh in the import order of its model, identifies it
+    // to its MeshDataSource
+    size_t sourceIndex{0};
+    // SceneGraph node the mesh hangs on, objectMatrix is its world matrix
+    uint32_t node{SCENE_GRAPH_NO_NODE};
+    // Placements past the first one (objectMatrix / node) when the model
+    // uses the same geometry several times, see
+    // MeshImportOptions::instanceMeshes. Instance 0 is the mesh itself.
+    std::vector<MeshInstance> instances;
 
     Mesh(std::vector<Vertex>&& vertices, std::vector<unsigned int>&& indicies,
          std::shared_ptr<Material> material, std::string name,
          const glm::mat4& transform, AABB aabb)
-        : vertices(vertices),
-          indices(indicies),
+        : vertices(std::move(vertices)),
+          indices(std::move(indicies)),
           material(material),
           name(std::move(name)),
           objectMatrix(transform),
@@ -52,21 +100,176 @@ struct LOO_EXPORT Mesh {
         return material ? material->isDoubleSided() : false;
     }
 
-    GLuint vao, vbo, ebo;
-    void prepare();
+    // GPU side vertex layout, applied by prepare()
+    VertexFormat vertexFormat{VertexFormat::Full};
+    // vbo and ebo are 0 for meshes living in a GeometryArena, their vao is
+    // shared by every mesh of the same layout
+    GLuint vao{0}, vbo{0}, ebo{0};
+    // upload into buffers of its own, or into the arena (which must be owned
+    // by a shared_ptr) if not null, released data is restored first; the
+    // buffers of a previous call are deleted
+    void prepare(GeometryArena* arena = nullptr);
+    // Free the CPU geometry of a prepared mesh, see MeshResidency. Drawing and
+    // counting keep working. Returns the reclaimed bytes.
+    size_t releaseCpuData(MeshResidency residency);
+    // load the released data again through the data source, false if there
+    // is none or it failed. GL thread, sources may create materials.
+    bool restoreCpuData();
+    // take the CPU data of a freshly loaded copy of this mesh
+    void restoreCpuData(Mesh& loaded);
+    MeshResidency getResidency() const { return m_residency; }
+    void setDataSource(std::shared_ptr<MeshDataSource> source) {
+        m_dataSource = std::move(source);
+    }
+    const std::shared_ptr<MeshDataSource>& getDataSource() const {
+        return m_dataSource;
+    }
+    // maps the vertex shader position input to object space, identity unless
+    // the mesh was prepared with VertexFormat::Packed
+    glm::mat4 getPositionDecodeMatrix() const;
+    // type of the indices in ebo, GL_UNSIGNED_SHORT when every vertex can be
+    // addressed with 16 bits, set by prepare()
+    GLenum getIndexType() const { return m_indexType; }
+    size_t getIndexSize() const;
+    // where a level of detail starts in ebo, in indices of getIndexType()
+    size_t getFirstIndex(size_t lod = 0) const;
+    GLint getBaseVertex() const { return m_baseVertex; }
+    // draw a level of detail (see selectMeshLod) with the bound program
+    void draw(size_t lod = 0) const;
+    // same as draw() with vao already bound, meshes sharing a vao can be
+    // drawn in a row without rebinding
+    void drawElements(size_t lod = 0) const;
+    // draw instanceCount copies with the bound program, gl_InstanceID counts
+    // from 0 and gl_BaseInstance is baseInstance
+    void drawInstanced(size_t instanceCount, GLuint baseInstance = 0,
+                       size_t lod = 0) const;
+    size_t getLodCount() const { return lods.size() + 1; }
     size_t countVertex() const;
-    size_t countTriangles() const;
+    size_t countTriangles(size_t lod = 0) const;
+    size_t countInstances() const { return instances.size() + 1; }
+    const glm::mat4& getInstanceMatrix(size_t instance) const {
+        return instance ? instances[instance - 1].objectMatrix : objectMatrix;
+    }
+    glm::mat4& getInstanceMatrix(size_t instance) {
+        return instance ? instances[instance - 1].objectMatrix : objectMatrix;
+    }
+    const glm::mat4& getInstanceMatrixPrev(size_t instance) const {
+        return instance ? instances[instance - 1].objectMatrixPrev
+                        : objectMatrixPrev;
+    }
+    uint32_t getInstanceNode(size_t instance) const {
+        return instance ? instances[instance - 1].node : node;
+    }
+    // box around every instance in the space modelMatrix maps to
+    AABB computeInstancesAABB(const glm::mat4& modelMatrix) const;
     // save current transform matrix to previous transform matrix
-    void savePreviousTransform() { objectMatrixPrev = objectMatrix; }
+    void savePreviousTransform() {
+        objectMatrixPrev = objectMatrix;
+        for (auto& instance : instances)
+            instance.objectMatrixPrev = instance.objectMatrix;
+    }
+
+   private:
+    glm::vec3 m_positionDecodeOffset{0.0f}, m_positionDecodeScale{1.0f};
+    // first index of every level in ebo
+    std::vector<size_t> m_lodIndexOffsets;
+    GLenum m_indexType{GL_UNSIGNED_INT};
+    // where the mesh lives in ebo / vbo
+    size_t m_indexByteOffset{0};
+    GLint m_baseVertex{0};
+    std::shared_ptr<GeometryRange> m_geometryRange;
+    MeshResidency m_residency{MeshResidency::Keep};
+    std::shared_ptr<MeshDataSource> m_dataSource;
+    // GPU side counts, valid once released
+    size_t m_preparedVertexCount{0}, m_preparedIndexCount{0};
 };
 class Animator;
+class ThreadPool;
+
+struct MeshImportOptions {
+    // meshes are converted concurrently on this pool, ThreadPool::global() if
+    // null; the result is identical whatever the thread count
+    ThreadPool* pool{nullptr};
+    // merge duplicated vertices of each mesh (see weldVertices)
+    bool weldVertices{false};
+    // 0 only merges identical vertices, otherwise attributes are snapped to
+    // a grid of this size before comparison
+    float weldEpsilon{0.0f};
+    // partition every mesh into meshlets (see buildMeshlets)
+    bool buildMeshlets{false};
+    // Generate a chain of simplified index buffers (see generateMeshLods).
+    // Duplicated vertices are merged for the simplification only. Vertices
+    // of one position with different normals or texture coordinates form a
+    // seam, which is kept. Flat-shaded meshes are seams everywhere and can't
+    // be simplified unless weldVertices with a weldEpsilon snaps them.
+    bool generateLods{false};
+    MeshLodOptions lodOptions{};
+    // reorder triangles and vertices (see optimizeMesh), replaces assimp's
+    // aiProcess_ImproveCacheLocality in createSceneFromFile
+    bool optimize{false};
+    MeshOptimizeOptions optimizeOptions{};
+    // Convert an assimp mesh referenced by several nodes once and give it one
+    // Mesh::instances entry per extra node instead of a copy each. Turns off
+    // aiProcess_OptimizeGraph and aiProcess_OptimizeMeshes, which would
+    // otherwise merge the shared meshes away; the import logs how many
+    // meshes and instances are left.
+    bool instanceMeshes{false};
+};
+
+struct MeshImportStats {
+    size_t meshCount{0};
+    // placements of the meshes, more than meshCount with instanceMeshes
+    size_t instanceCount{0};
+    // vertices left after welding
+    size_t vertexCount{0};
+    size_t triangleCount{0};
+    // vertices removed by welding
+    size_t weldedVertexCount{0};
+    size_t meshletCount{0};
+    // triangles of every simplified level summed up
+    size_t lodTriangleCount{0};
+    // simulated vertex cache over every mesh, filled when optimizing
+    VertexCacheStats cacheBefore, cacheAfter;
+    double milliseconds{0.0};
+};
+
+// ASSIMP_IMPORT_FLAGS adjusted to the loo side processing
+LOO_EXPORT unsigned int getAssimpImportFlags(const MeshImportOptions& options);
+
 LOO_EXPORT std::vector<std::shared_ptr<Mesh>> createMeshesFromFile(
     std::map<std::string, int>& boneIndexMap,
     std::vector<glm::mat4>& boneOffsetMatrices, Animator* animator,
     const std::string& filename, std::string& modelName);
+// graph, if not null, is replaced by the node hierarchy of the model and
+// every mesh gets its Mesh::node
 LOO_EXPORT std::vector<std::shared_ptr<Mesh>> createMeshesFromAssimp(
     const aiScene* scene, std::map<std::string, int>& boneIndexMap,
-    std::vector<glm::mat4>& boneOffsetMatrices, const std::string& basePath);
+    std::vector<glm::mat4>& boneOffsetMatrices, const std::string& basePath,
+    const MeshImportOptions& options = {}, MeshImportStats* stats = nullptr,
+    SceneGraph* graph = nullptr);
+
+using AssimpMeshCallback = std::function<void(
+    const std::shared_ptr<Mesh>& mesh, unsigned int materialIndex)>;
+// Mesh conversion alone, OpenGL is never touched so it may run on any thread.
+// Materials are left null, onMesh gets every mesh with the index of its
+// assimp material as soon as it is complete, from pool threads and in any
+// order. The bone tables, and the node hierarchy when graph isn't null, are
+// complete before the first call.
+LOO_EXPORT std::vector<std::shared_ptr<Mesh>> convertMeshesFromAssimp(
+    const aiScene* scene, std::map<std::string, int>& boneIndexMap,
+    std::vector<glm::mat4>& boneOffsetMatrices,
+    const MeshImportOptions& options = {},
+    const AssimpMeshCallback& onMesh = nullptr,
+    MeshImportStats* stats = nullptr, SceneGraph* graph = nullptr);
+
+// Read the model once, then convert its meshes with options on pools of 1 to
+// maxThreadCount threads (every hardware thread if 0), options.pool is
+// ignored. Logs the fastest of iterationCount conversions for each thread
+// count and the speedup over 1 thread, and returns the last speedup.
+LOO_EXPORT double measureMeshImport(const std::string& filename,
+                                    size_t maxThreadCount = 0,
+                                    MeshImportOptions options = {},
+                                    size_t iterationCount = 3);
 
 }  // namespace loo
 
@@ -0,0 +1,50 @@
+#ifndef LOO_INCLUDE_LOO_MESH_LOD_HPP
+#define LOO_INCLUDE_LOO_MESH_LOD_HPP
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+class PerspectiveCamera;
+
+// a simplified index buffer of a mesh, indexing the same vertices
+struct MeshLod {
+    std::vector<unsigned int> indices;
+    // object space distance the level may deviate from the full mesh by
+    float error{0.0f};
+};
+
+struct MeshLodOptions {
+    // at most this many simplified levels
+    size_t maxLevels{4};
+    // target triangle count of a level relative to the previous one
+    float reduction{0.5f};
+    // levels keeping more than this fraction of the previous triangles are
+    // dropped and end the chain
+    float minProgress{0.9f};
+    // object space error limit, unlimited if 0
+    float maxError{0.0f};
+};
+
+// Fill mesh.lods with quadric error metric simplifications of mesh.indices,
+// each level simplifying the previous one by collapsing edges onto existing
+// vertices. Vertices on attribute seams and open borders never move so the
+// levels can't crack. Identical vertices are treated as one, unwelded meshes
+// simplify as well as welded ones; a mesh which can't be simplified at all
+// gets no level and a warning.
+LOO_EXPORT void generateMeshLods(Mesh& mesh,
+                                 const MeshLodOptions& options = {});
+
+// Pick the coarsest level (0 being mesh.indices) whose error stays below
+// maxPixelError once projected, the error is scaled to pixels from the
+// projected size of mesh.aabb.
+LOO_EXPORT size_t selectMeshLod(const Mesh& mesh, const glm::mat4& modelMatrix,
+                                const PerspectiveCamera& camera,
+                                float viewportHeight,
+                                float maxPixelError = 1.0f);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_MESH_LOD_HPP */
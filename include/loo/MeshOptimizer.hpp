@@ -0,0 +1,71 @@
+#ifndef LOO_INCLUDE_LOO_MESH_OPTIMIZER_HPP
+#define LOO_INCLUDE_LOO_MESH_OPTIMIZER_HPP
+#include <cstddef>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+struct Vertex;
+
+// size of the simulated FIFO post-transform cache, a conservative value
+// close to the hardware of the last decade
+constexpr size_t VERTEX_CACHE_ANALYZE_SIZE = 16;
+
+struct VertexCacheStats {
+    // transformed vertices per triangle, 0.5 at best and 3 at worst
+    float acmr{0.0f};
+    // transformed vertices per vertex, 1 at best
+    float atvr{0.0f};
+    size_t transformedVertexCount{0};
+};
+
+// simulate a FIFO vertex cache over the triangle list
+LOO_EXPORT VertexCacheStats
+analyzeVertexCache(const std::vector<unsigned int>& indices,
+                   size_t vertexCount,
+                   size_t cacheSize = VERTEX_CACHE_ANALYZE_SIZE);
+
+// reorder the triangles for the post-transform cache, Forsyth's "Linear-Speed
+// Vertex Cache Optimisation" over a 32 entries LRU cache
+LOO_EXPORT void optimizeVertexCache(std::vector<unsigned int>& indices,
+                                    size_t vertexCount);
+
+// Reorder clusters of a cache optimized triangle list so that the outward
+// facing ones come first (Sander et al., "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw"). Clusters split where the cache is cold
+// anyway, or where the ACMR stays below threshold times the input one.
+LOO_EXPORT void optimizeOverdraw(std::vector<unsigned int>& indices,
+                                 const std::vector<Vertex>& vertices,
+                                 float threshold = 1.05f);
+
+// Reorder the vertices by first use in the index buffers and drop the unused
+// ones, every index buffer is remapped. Returns the new vertex count.
+LOO_EXPORT size_t
+optimizeVertexFetch(std::vector<Vertex>& vertices,
+                    const std::vector<std::vector<unsigned int>*>& indexBuffers,
+                    std::vector<unsigned int>* remap = nullptr);
+
+struct MeshOptimizeOptions {
+    bool vertexCache{true};
+    bool overdraw{true};
+    // ACMR the overdraw pass may give up, see optimizeOverdraw
+    float overdrawThreshold{1.05f};
+    bool vertexFetch{true};
+};
+
+struct MeshOptimizeStats {
+    // level 0 only
+    VertexCacheStats before, after;
+    size_t removedVertexCount{0};
+};
+
+// Run the passes above on a mesh, levels of detail are cache optimized too and
+// meshlets are remapped. The GPU side is left untouched, prepare() the mesh
+// again if it already was.
+LOO_EXPORT MeshOptimizeStats
+optimizeMesh(Mesh& mesh, const MeshOptimizeOptions& options = {});
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_MESH_OPTIMIZER_HPP */
@@ -0,0 +1,40 @@
+#ifndef LOO_INCLUDE_LOO_MESH_RESIDENCY_HPP
+#define LOO_INCLUDE_LOO_MESH_RESIDENCY_HPP
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+
+// CPU geometry a mesh keeps once it lives on the GPU
+enum class MeshResidency {
+    // everything, the default
+    Keep,
+    // positions and index buffers (levels of detail and meshlets included)
+    // for picking and culling
+    PositionsOnly,
+    // nothing, the mesh can still be drawn and counted
+    Drop,
+};
+
+struct MeshResidencyStats {
+    size_t meshCount{0};
+    size_t reclaimedBytes{0};
+};
+
+// Where released meshes get their CPU data back from, see
+// Mesh::restoreCpuData()
+class LOO_EXPORT MeshDataSource {
+   public:
+    virtual ~MeshDataSource() = default;
+    // load the meshes with the given Mesh::sourceIndex in the same order,
+    // empty on failure
+    virtual std::vector<std::shared_ptr<Mesh>> fetch(
+        const std::vector<size_t>& sourceIndices) = 0;
+};
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_MESH_RESIDENCY_HPP */
@@ -0,0 +1,25 @@
+#ifndef LOO_INCLUDE_LOO_MESH_WELD_HPP
+#define LOO_INCLUDE_LOO_MESH_WELD_HPP
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+struct Vertex;
+
+// hash over every attribute of the vertex, consistent with Vertex::operator==
+LOO_EXPORT uint64_t hashVertex(const Vertex& v);
+
+// Merge duplicated vertices and remap the indices, the first occurrence of a
+// vertex is kept so the order of the survivors is preserved.
+// With epsilon > 0 float attributes are snapped to a grid of that size before
+// being compared (bone ids are always compared exactly).
+// Returns the number of removed vertices.
+LOO_EXPORT size_t weldVertices(std::vector<Vertex>& vertices,
+                               std::vector<unsigned int>& indices,
+                               float epsilon = 0.0f);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_MESH_WELD_HPP */
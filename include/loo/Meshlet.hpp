@@ -0,0 +1,55 @@
+#ifndef LOO_INCLUDE_LOO_MESHLET_HPP
+#define LOO_INCLUDE_LOO_MESHLET_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <vector>
+
+#include "AABB.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+
+// default limits, 64 vertices and 124 triangles fit the usual mesh shader
+// output budgets and keep the clusters small enough for culling
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+// a cluster of triangles of a mesh, see Mesh::meshlets
+struct Meshlet {
+    // first entry in Mesh::meshletVertices
+    uint32_t vertexOffset;
+    // first entry in Mesh::meshletTriangles, 3 entries per triangle
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+};
+
+// object space culling data of a meshlet
+struct MeshletBounds {
+    // bounding sphere
+    glm::vec3 center;
+    float radius;
+    AABB aabb;
+    // every triangle normal lies in the cone of this axis whose half angle
+    // sine is coneCutoff, a cutoff of 1 means the cone is too wide to cull
+    glm::vec3 coneApex;
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+// Split mesh.indices into meshlets of at most maxVertices vertices (256 at
+// most) and maxTriangles triangles, filling the meshlet arrays of the mesh.
+// Triangles are taken in index order, run it after any index reordering.
+LOO_EXPORT void buildMeshlets(Mesh& mesh,
+                              size_t maxVertices = MESHLET_MAX_VERTICES,
+                              size_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+// true if every triangle of the meshlet faces away from the camera, both in
+// the object space of the mesh
+LOO_EXPORT bool isMeshletBackfacing(const MeshletBounds& bounds,
+                                    const glm::vec3& cameraPosition);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_MESHLET_HPP */
@@ -0,0 +1,94 @@
+#ifndef LOO_INCLUDE_LOO_OCCLUSION_CULLER_HPP
+#define LOO_INCLUDE_LOO_OCCLUSION_CULLER_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <vector>
+
+#include "AABB.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+class Scene;
+class ThreadPool;
+
+// pixels of a depth tile, its coverage mask has one bit per pixel
+constexpr uint32_t OCCLUSION_TILE_WIDTH = 8, OCCLUSION_TILE_HEIGHT = 4;
+
+struct OcclusionStats {
+    size_t occluderTriangleCount{0};
+    size_t testedCount{0};
+    size_t occludedCount{0};
+    size_t visibleCount{0};
+    double rasterizeMilliseconds{0.0};
+    double testMilliseconds{0.0};
+};
+
+// CPU occlusion culling after "Masked Software Occlusion Culling" (Hasselgren
+// et al. 2016). A few occluder meshes are rasterized into a low resolution
+// buffer of 8x4 pixel tiles, each holding a conservative reference depth plus
+// a working layer (depth and coverage mask) which replaces the reference once
+// it covers the whole tile. Depth is 1/w, larger is nearer, so the projection
+// convention (reverse Z or not) doesn't matter. Tile rows are rasterized in
+// parallel, nothing here touches OpenGL.
+class LOO_EXPORT OcclusionCuller {
+   public:
+    // rounded up to whole tiles
+    explicit OcclusionCuller(uint32_t width = 512, uint32_t height = 256);
+
+    // clear the buffer and stats, viewProjection maps world space to clip
+    // space for the whole frame, zeroToOne is its clip depth range as with
+    // Frustum::fromMatrix
+    void beginFrame(const glm::mat4& viewProjection, bool zeroToOne = false);
+    // queue the triangles of an occluder, from its vertices or its resident
+    // positions; triangles with a vertex outside the depth range, in front of
+    // the near plane or behind the far one, are skipped
+    void addOccluder(const Mesh& mesh, const glm::mat4& modelMatrix);
+    // rasterize the queued occluders, one task per tile row
+    void rasterize(ThreadPool* pool = nullptr);
+
+    // false when the world space box is hidden behind rasterized occluders
+    bool isVisible(const AABB& aabb) const;
+    // keep the meshes of visible (Scene::getMeshes() indices, e.g. from
+    // cullFrustum) which aren't occluded, returns how many are left
+    size_t cullMeshes(const Scene& scene, std::vector<uint32_t>& visible);
+
+    const OcclusionStats& getStats() const { return m_stats; }
+    uint32_t getWidth() const { return m_width; }
+    uint32_t getHeight() const { return m_height; }
+
+   private:
+    struct Tile {
+        // every pixel is at least this near
+        float zMin0;
+        // pixels in mask are at least this near
+        float zMin1;
+        uint32_t mask;
+    };
+    struct Triangle {
+        // edge functions a * x + b * y + c, >= 0 inside
+        float edgeA[3], edgeB[3], edgeC[3];
+        // depth plane and the farthest vertex depth
+        float depthA, depthB, depthC, depthMin;
+        int tileMinX, tileMaxX, tileMinY, tileMaxY;
+    };
+
+    void rasterizeTriangle(const Triangle& triangle, int tileY);
+    uint32_t computeCoverage(const Triangle& triangle, int tileX,
+                             int tileY) const;
+
+    uint32_t m_width, m_height, m_tileCountX, m_tileCountY;
+    glm::mat4 m_viewProjection{1.0f};
+    // clip z over w at the near (or reverse Z far) plane, -1 or 0
+    float m_depthRangeMin{-1.0f};
+    std::vector<Tile> m_tiles;
+    std::vector<Triangle> m_triangles;
+    // triangle indices by tile row
+    std::vector<std::vector<uint32_t>> m_rowTriangles;
+    OcclusionStats m_stats;
+};
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_OCCLUSION_CULLER_HPP */
@@ -0,0 +1,114 @@
+#ifndef LOO_INCLUDE_LOO_POSE_HPP
+#define LOO_INCLUDE_LOO_POSE_HPP
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "Bone.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+
+// poses of many bones as separate arrays, the layout batched kernels want
+struct BonePoseArrays {
+    float* translation[3];
+    // x, y, z, w
+    float* rotation[4];
+    float* scale[3];
+};
+
+// The kernels below run 8 lanes at a time with AVX2 or 4 with SSE and finish
+// with a scalar loop that agrees with them up to rounding. result may be one
+// of the inputs.
+
+// result = from + (to - from) * factor
+LOO_EXPORT void lerpArrays(const float* from, const float* to,
+                           const float* factors, size_t count, float* result);
+// normalized lerp on the shortest path
+LOO_EXPORT void nlerpQuats(const float* const from[4], const float* const to[4],
+                           const float* factors, size_t count,
+                           float* const result[4]);
+// nlerp with the factor corrected by a fitted polynomial (Kapoulkine,
+// "Approximating slerp"), within about 1e-3 radians of slerp even between
+// keys far apart, and without any acos or sin
+LOO_EXPORT void slerpQuats(const float* const from[4], const float* const to[4],
+                           const float* factors, size_t count,
+                           float* const result[4]);
+// translate * rotate * scale of every pose written as one affine matrix
+LOO_EXPORT void composeAffines(const BonePoseArrays& poses, size_t count,
+                               glm::mat4* result);
+// a[i] * b[i] with the last row of both taken as (0, 0, 0, 1), so only the
+// 3x4 part is multiplied; two matrices at a time with AVX2, one with SSE
+LOO_EXPORT void multiplyAffines(const glm::mat4* a, const glm::mat4* b,
+                                size_t count, glm::mat4* result);
+// from a toward b by weights[i]: lerp of translations and scales, nlerp of
+// rotations
+LOO_EXPORT void blendPoses(const BonePoseArrays& a, const BonePoseArrays& b,
+                           const float* weights, size_t count,
+                           const BonePoseArrays& result);
+// Additive layering: the difference between additive and the reference pose
+// it was authored against, scaled by weights[i], on top of base. Translations
+// add, rotations and scales multiply. inverseReference holds the reference
+// with negated translations, conjugated rotations and inverted scales.
+LOO_EXPORT void addPoses(const BonePoseArrays& base,
+                         const BonePoseArrays& additive,
+                         const BonePoseArrays& inverseReference,
+                         const float* weights, size_t count,
+                         const BonePoseArrays& result);
+
+// poses of count bones in the BonePoseArrays layout, owning the arrays
+class LOO_EXPORT PoseBuffer {
+   public:
+    // allocates, everything else doesn't
+    void resize(size_t boneCount);
+    size_t size() const { return m_boneCount; }
+
+    BonePoseArrays getArrays();
+    BonePose getPose(size_t i) const;
+    void setPose(size_t i, const BonePose& pose);
+
+   private:
+    size_t m_boneCount{0};
+    // translations, rotations then scales, one array per component
+    std::vector<float> m_data;
+};
+
+// Keys around the sample time of many bones side by side. The key search
+// stays per bone, which is what the cursors make cheap, then every bone is
+// interpolated and composed together by the kernels above.
+class LOO_EXPORT PoseSampler {
+   public:
+    // allocates, everything else doesn't
+    void resize(size_t boneCount);
+    size_t size() const { return m_boneCount; }
+
+    // keys of bone around time into slot i, like Bone::sample
+    void gather(size_t i, const Bone& bone, float time, BoneCursor& cursor);
+    // a pose which doesn't move into slot i
+    void gather(size_t i, const BonePose& pose);
+    // interpolate every slot, rotations by slerpQuats or nlerpQuats
+    void interpolate(bool slerp = true);
+    // as of the last interpolate()
+    BonePoseArrays getPoses();
+    BonePose getPose(size_t i) const;
+    // local matrix of every slot
+    void compose(glm::mat4* result) {
+        composeAffines(getPoses(), m_boneCount, result);
+    }
+
+   private:
+    float* getArray(size_t array) {
+        return m_data.data() + array * m_boneCount;
+    }
+    const float* getArray(size_t array) const {
+        return m_data.data() + array * m_boneCount;
+    }
+
+    size_t m_boneCount{0};
+    // one array of m_boneCount floats after the other
+    std::vector<float> m_data;
+};
+
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_POSE_HPP */
@@ -12,10 +12,19 @@
 
 #include "AABB.hpp"
 #include "Animation.hpp"
+#include "GeometryArena.hpp"
+#include "IndirectDraw.hpp"
 #include "Mesh.hpp"
+#include "SceneGraph.hpp"
 #include "predefs.hpp"
 
 namespace loo {
+class SceneStream;
+struct SceneLoadOptions;
+
+// default upload budget of a streamed scene
+constexpr size_t SCENE_STREAM_BYTES_PER_FRAME = 16 << 20;
+
 class LOO_EXPORT Scene {
     std::vector<std::shared_ptr<Mesh>> m_meshes;
     glm::vec3 m_scale{1.0f, 1.0f, 1.0f}, m_translate{0.0f, 0.0f, 0.0f},
@@ -38,7 +47,16 @@ class LOO_EXPORT Scene {
     auto& getMeshes() const { return m_meshes; }
     auto getMeshes() { return m_meshes; }
     void clear() {
+        m_stream.reset();
+        m_drawList.reset();
         m_meshes.clear();
+        graph.clear();
+        m_nodeMeshOffsets.clear();
+        m_nodeMeshes.clear();
+        m_movedMeshes.clear();
+        m_lastMovedMeshes.clear();
+        m_meshMovedEpochs.clear();
+        geometryArena.reset();
         boneMap.clear();
         boneMatrices.clear();
         aabb = AABB();
@@ -66,9 +84,98 @@ class LOO_EXPORT Scene {
     glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f},
         rotationPrev{1.0f, 0.0f, 0.0f, 0.0f};
     std::shared_ptr<Animation> animation{};
+    // prepare() sub-allocates the meshes from it when set
+    std::shared_ptr<GeometryArena> geometryArena{};
+    // node hierarchy of the model, meshes hang on their Mesh::node; move
+    // nodes with SceneGraph::setLocalMatrix and call updateTransforms()
+    SceneGraph graph;
+
+    // propagate the moved graph nodes to the Mesh::objectMatrix of their
+    // meshes, returns the node ranges which changed (see SceneGraph::update)
+    const std::vector<SceneGraphRange>& updateTransforms();
+
+    // Streamed scenes (see SceneLoadOptions::streaming) grow as meshes are
+    // loaded, call this on the GL thread every frame to upload at most
+    // byteBudget bytes of new meshes. Returns true while meshes are to come.
+    bool streamMeshes(size_t byteBudget = SCENE_STREAM_BYTES_PER_FRAME);
+    bool isStreaming() const { return m_stream != nullptr; }
+
+    // Draw every mesh with one glMultiDrawElementsIndirect per bucket instead
+    // of one draw per mesh, see IndirectDrawList. The list is rebuilt when
+    // meshes or instances were added or the options changed. Without a graph
+    // every matrix is uploaded on each call, with one only those of the
+    // meshes moved by updateTransforms() since the previous call (and the
+    // call before, for objectMatrixPrev). Vertex shaders need
+    // INDIRECT_DRAW_GLSL.
+    void drawIndirect(const IndirectDrawCallback& beforeBucket,
+                      const IndirectDrawOptions& options = {});
+    // rebuild the draw list on the next drawIndirect(), after meshes were
+    // prepared again
+    void invalidateDrawList() { m_drawList.reset(); }
+
+    // apply a residency policy to every prepared mesh (see
+    // Mesh::releaseCpuData), not while streaming since the cache may still be
+    // written from the meshes
+    MeshResidencyStats releaseCpuData(MeshResidency residency);
+    // bring back the CPU data of every released mesh, one fetch per data
+    // source; false if some mesh couldn't be restored
+    bool restoreCpuData();
+
+   private:
+    std::shared_ptr<SceneStream> m_stream;
+    std::shared_ptr<IndirectDrawList> m_drawList;
+    // (m_meshes index, instance) sorted by node, those of node n start at
+    // m_nodeMeshOffsets[n]; built for m_nodeMeshCount meshes
+    std::vector<uint32_t> m_nodeMeshOffsets;
+    std::vector<std::pair<uint32_t, uint32_t>> m_nodeMeshes;
+    size_t m_nodeMeshCount{0};
+    // moved by updateTransforms() since the last drawIndirect() and before,
+    // only tracked while there is a draw list to update
+    std::vector<const Mesh*> m_movedMeshes, m_lastMovedMeshes;
+    // by m_meshes index, m_moveEpoch once the mesh is in m_movedMeshes
+    std::vector<uint32_t> m_meshMovedEpochs;
+    // bumped by every drawIndirect()
+    uint32_t m_moveEpoch{1};
+    friend Scene createSceneFromFile(const std::string& filename,
+                                     const SceneLoadOptions& options);
+    // fills the cache snapshot without addMeshes(), see SceneStream::finish
+    friend class SceneStream;
+};
+
+struct SceneLoadOptions {
+    // load from / save to the binary scene cache, warm loads skip assimp
+    bool useCache{true};
+    // where cache files live, next to the model if empty
+    std::string cacheDirectory{};
+    // GPU vertex layout of every mesh
+    VertexFormat vertexFormat{VertexFormat::Full};
+    MeshImportOptions importOptions{};
+    // return an empty scene at once and load it in the background, see
+    // Scene::streamMeshes
+    bool streaming{false};
+    // share a few large buffers between every mesh, see GeometryArena
+    bool useGeometryArena{false};
+    // CPU geometry left once the meshes are uploaded, released meshes reload
+    // through a SceneFileDataSource
+    MeshResidency residency{MeshResidency::Keep};
+};
+
+// reloads the geometry of meshes from the scene cache (see
+// readSceneCacheGeometry), or else from the model with the same import
+// options; materials are never created
+class LOO_EXPORT SceneFileDataSource : public MeshDataSource {
+   public:
+    SceneFileDataSource(std::string filename, const SceneLoadOptions& options);
+    std::vector<std::shared_ptr<Mesh>> fetch(
+        const std::vector<size_t>& sourceIndices) override;
+
+   private:
+    std::string m_filename;
+    SceneLoadOptions m_options;
 };
 
-LOO_EXPORT Scene createSceneFromFile(const std::string& filename);
+LOO_EXPORT Scene createSceneFromFile(const std::string& filename,
+                                     const SceneLoadOptions& options = {});
 
 LOO_EXPORT glm::mat4 getLightSpaceTransform(glm::vec3 lightPosition);
 }  // namespace loo
@@ -0,0 +1,65 @@
+#ifndef LOO_INCLUDE_LOO_SCENE_CACHE_HPP
+#define LOO_INCLUDE_LOO_SCENE_CACHE_HPP
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+class Scene;
+struct Mesh;
+struct MeshImportOptions;
+
+// Binary cache of an imported scene: processed vertices/indices, mesh
+// transforms, AABBs, meshlets and levels of detail, material descriptions,
+// bone tables and the animation.
+// The file is memory mapped on load, vertex and index arrays are stored as
+// aligned blobs so a cache hit never touches assimp nor parses vertices.
+// The layout is native endian, bump the version whenever it (or the import
+// pipeline feeding it) changes.
+constexpr uint32_t SCENE_CACHE_VERSION = 6;
+
+struct SceneCacheKey {
+    // absolute path of the source model
+    std::string sourcePath;
+    // last write time of the source model
+    int64_t sourceMtime{0};
+    // assimp post-process steps
+    uint32_t importFlags{0};
+    // loo side processing applied after assimp (welding...), any value as
+    // long as it changes with the output
+    uint64_t processingKey{0};
+};
+
+// identifies the mesh processing options in the cache key, 0 when the meshes
+// are left as assimp outputs them
+LOO_EXPORT uint64_t
+getSceneCacheProcessingKey(const MeshImportOptions& options);
+LOO_EXPORT SceneCacheKey createSceneCacheKey(const std::string& filename,
+                                             uint32_t importFlags,
+                                             uint64_t processingKey = 0);
+// cache file location, next to the source model if cacheDir is empty
+LOO_EXPORT std::string getSceneCachePath(const SceneCacheKey& key,
+                                         const std::string& cacheDir = "");
+
+// Mesh placements are taken from scene.graph for meshes on a node, so the
+// scene may be a snapshot holding meshes another thread keeps moving.
+LOO_EXPORT bool writeSceneCache(const std::string& cachePath,
+                                const SceneCacheKey& key, const Scene& scene);
+// fill an empty scene from the cache, returns false when the cache is
+// missing, stale or corrupted
+LOO_EXPORT bool readSceneCache(const std::string& cachePath,
+                               const SceneCacheKey& key, Scene& scene);
+// Geometry alone (vertices, indices, meshlets and levels of detail) of the
+// meshes with the given Mesh::sourceIndex, in the same order. No material,
+// bone or animation is created, so this may run on any thread. Returns false
+// like readSceneCache or when an index is out of range.
+LOO_EXPORT bool readSceneCacheGeometry(
+    const std::string& cachePath, const SceneCacheKey& key,
+    const std::vector<size_t>& sourceIndices,
+    std::vector<std::shared_ptr<Mesh>>& meshes);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_SCENE_CACHE_HPP */
@@ -0,0 +1,95 @@
+#ifndef LOO_INCLUDE_LOO_SCENE_GRAPH_HPP
+#define LOO_INCLUDE_LOO_SCENE_GRAPH_HPP
+#include <cstddef>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <string>
+#include <vector>
+
+#include "AABB.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+
+// parent of a root, node of a mesh outside of any graph
+constexpr uint32_t SCENE_GRAPH_NO_NODE = ~0u;
+
+// nodes [begin, end) in depth first order
+struct SceneGraphRange {
+    uint32_t begin, end;
+};
+
+// Node hierarchy in flat arrays sorted depth first, so that a subtree is the
+// contiguous range [node, getSubtreeEnd(node)) and parents always come before
+// their children. Moving a node only marks it dirty; update() recomputes the
+// world matrices of the dirty subtrees in one forward pass and reports them
+// as a few ranges, which is what GPU side copies need to upload. World boxes
+// are only rebuilt when asked for.
+class LOO_EXPORT SceneGraph {
+   public:
+    // append a node, parent is SCENE_GRAPH_NO_NODE for a root or else the
+    // last node added or one of its ancestors, which keeps the depth first
+    // order; returns the new node
+    uint32_t addNode(uint32_t parent, const glm::mat4& localMatrix,
+                     std::string name = {});
+    void clear();
+    size_t size() const { return m_parents.size(); }
+    bool empty() const { return m_parents.empty(); }
+
+    uint32_t getParent(uint32_t node) const { return m_parents[node]; }
+    // one past the last node of the subtree
+    uint32_t getSubtreeEnd(uint32_t node) const { return m_subtreeEnds[node]; }
+    const std::string& getName(uint32_t node) const { return m_names[node]; }
+    // first node with that name, SCENE_GRAPH_NO_NODE if none
+    uint32_t findNode(const std::string& name) const;
+
+    const glm::mat4& getLocalMatrix(uint32_t node) const {
+        return m_localMatrices[node];
+    }
+    // the node and its subtree move on the next update()
+    void setLocalMatrix(uint32_t node, const glm::mat4& localMatrix);
+    // as of the last update()
+    const glm::mat4& getWorldMatrix(uint32_t node) const {
+        return m_worldMatrices[node];
+    }
+    const std::vector<glm::mat4>& getWorldMatrices() const {
+        return m_worldMatrices;
+    }
+
+    // Recompute the world matrices below every dirty node, each subtree once
+    // even when nested dirty nodes are in it. Returns the nodes whose world
+    // matrix changed, sorted and merged into disjoint ranges, valid until the
+    // next update().
+    const std::vector<SceneGraphRange>& update();
+    const std::vector<SceneGraphRange>& getChangedRanges() const {
+        return m_changedRanges;
+    }
+    bool isDirty() const { return !m_dirtyNodes.empty(); }
+
+    // grow the node local box by what is attached to it (a mesh)
+    void mergeLocalAABB(uint32_t node, const AABB& aabb);
+    // world box of the whole subtree as of the last update(), rebuilt on
+    // demand for the parts that moved since it was last asked for
+    const AABB& getWorldAABB(uint32_t node) const;
+
+   private:
+    void markAABBDirty(uint32_t node) const;
+
+    std::vector<uint32_t> m_parents;
+    std::vector<uint32_t> m_subtreeEnds;
+    std::vector<std::string> m_names;
+    std::vector<glm::mat4> m_localMatrices;
+    std::vector<glm::mat4> m_worldMatrices;
+    std::vector<uint8_t> m_dirty;
+    // roots of the pending updates, unsorted
+    std::vector<uint32_t> m_dirtyNodes;
+    std::vector<SceneGraphRange> m_changedRanges;
+    // empty boxes (min > max) for nodes with nothing attached
+    std::vector<AABB> m_localAABBs;
+    mutable std::vector<AABB> m_worldAABBs;
+    mutable std::vector<uint8_t> m_aabbDirty;
+};
+
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_SCENE_GRAPH_HPP */
@@ -0,0 +1,89 @@
+#ifndef LOO_INCLUDE_LOO_SCENE_STREAM_HPP
+#define LOO_INCLUDE_LOO_SCENE_STREAM_HPP
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Scene.hpp"
+#include "SceneCache.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+
+// Progressive loader behind SceneLoadOptions::streaming. Assimp parsing and
+// mesh conversion run on a loader thread (and the global pool), finished
+// meshes wait in a queue until the GL thread uploads them through update().
+// A cache hit is read at once, only the uploads are spread over frames.
+// With a residency policy, meshes release their CPU data once uploaded, or
+// once the cache is written when it has to be.
+class LOO_EXPORT SceneStream {
+   public:
+    SceneStream(std::string filename, const SceneLoadOptions& options);
+    SceneStream(const SceneStream&) = delete;
+    // waits for the loader thread, loading can't be interrupted midway
+    ~SceneStream();
+
+    // GL thread only: upload queued meshes until byteBudget bytes are spent
+    // (at least one mesh) and append them to scene, returns false once every
+    // mesh is in
+    bool update(Scene& scene, size_t byteBudget);
+    // meshes converted so far, uploaded or not
+    size_t countLoadedMeshes() const { return m_loadedMeshCount.load(); }
+
+   private:
+    struct PendingMesh {
+        std::shared_ptr<Mesh> mesh;
+        // assimp material, -1 when the mesh already has its material
+        int materialIndex;
+    };
+
+    void load();
+    std::shared_ptr<Material> getMaterial(int index);
+    void finish(Scene& scene);
+    // release the meshes held for the cache write once it is done, returns
+    // false while it isn't
+    bool releaseCachedMeshes();
+
+    std::string m_filename;
+    SceneLoadOptions m_options;
+    SceneCacheKey m_cacheKey;
+    std::string m_cachePath;
+    unsigned int m_importFlags;
+    std::shared_ptr<SceneFileDataSource> m_dataSource;
+
+    // shared with the loader thread
+    std::mutex m_mutex;
+    std::deque<PendingMesh> m_pending;
+    std::vector<BaseMaterialDesc> m_materialDescs;
+    std::map<std::string, int> m_boneMap;
+    std::vector<glm::mat4> m_boneMatrices;
+    SceneGraph m_graph;
+    std::shared_ptr<Animation> m_animation;
+    std::string m_modelName;
+    bool m_bonesReady{false};
+    bool m_loaded{false};
+    std::atomic<size_t> m_loadedMeshCount{0};
+
+    // GL thread only
+    std::vector<std::shared_ptr<BaseMaterial>> m_materials;
+    std::vector<std::shared_ptr<Mesh>> m_uploadedMeshes;
+    bool m_bonesHandedOver{false};
+    bool m_fromCache{false};
+    bool m_finished{false};
+    // set by the pool once the cache is written
+    std::shared_ptr<std::atomic<bool>> m_cacheWritten;
+    std::vector<std::shared_ptr<Mesh>> m_cachedMeshes;
+    MeshResidencyStats m_residencyStats;
+
+    std::thread m_loader;
+};
+
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_SCENE_STREAM_HPP */
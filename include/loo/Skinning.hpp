@@ -0,0 +1,62 @@
+#ifndef LOO_INCLUDE_LOO_SKINNING_HPP
+#define LOO_INCLUDE_LOO_SKINNING_HPP
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <glm/mat4x4.hpp>
+#include <vector>
+
+#include "AABB.hpp"
+#include "predefs.hpp"
+
+namespace loo {
+struct Mesh;
+struct Vertex;
+class ThreadPool;
+
+// where skinning writes, each stream gets a vec3 every stride bytes and may
+// be null
+struct SkinnedStreams {
+    void* positions{nullptr};
+    void* normals{nullptr};
+    void* tangents{nullptr};
+    // 0 for packed vec3 arrays
+    size_t stride{0};
+};
+
+// the position, normal and tangent of a Vertex array starting at base
+LOO_EXPORT SkinnedStreams getVertexStreams(void* base);
+
+// Linear blend skinning of count vertices by palette (see
+// Animator::finalBoneMatrices), which must cover every bone id. The SIMD
+// lanes are the rows of the blended matrix, AVX2 builds fuse the multiply
+// adds. Vertices without a bone stay where they are, normals and tangents go
+// through the blended 3x3 part and are normalized. Returns the bounds of the
+// skinned positions, whether they are written or not.
+LOO_EXPORT AABB skinVertices(const Vertex* vertices, size_t count,
+                             const glm::mat4* palette,
+                             const SkinnedStreams& output);
+
+// skinVertices over the CPU vertices of the mesh (see MeshResidency) in
+// chunks on pool, ThreadPool::global() if null. No OpenGL involved, so it
+// works on headless nodes as well.
+LOO_EXPORT AABB skinMesh(const Mesh& mesh, const glm::mat4* palette,
+                         const SkinnedStreams& output,
+                         ThreadPool* pool = nullptr);
+
+// skinMesh straight into buffer, which holds a Vertex array (the Full vertex
+// format) from byteOffset on and must allow write mapping. Only the
+// position, normal and tangent of each vertex are written. GL thread.
+LOO_EXPORT AABB skinMeshIntoBuffer(const Mesh& mesh, const glm::mat4* palette,
+                                   GLuint buffer, size_t byteOffset = 0,
+                                   ThreadPool* pool = nullptr);
+
+// Skin the mesh iterationCount times into arrays on 1 thread and on every
+// hardware thread, and log vertices per second for both. Returns the rate
+// with every thread.
+LOO_EXPORT double measureSkinning(const Mesh& mesh,
+                                  const std::vector<glm::mat4>& palette,
+                                  size_t iterationCount = 100);
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_SKINNING_HPP */
@@ -0,0 +1,52 @@
+#ifndef LOO_INCLUDE_LOO_THREAD_POOL_HPP
+#define LOO_INCLUDE_LOO_THREAD_POOL_HPP
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+
+// Fixed size pool of worker threads for CPU side work (asset import, mesh
+// processing...). Nothing submitted here may touch OpenGL.
+class LOO_EXPORT ThreadPool {
+   public:
+    // a pool without workers runs everything on the calling thread
+    explicit ThreadPool(size_t workerCount);
+    ThreadPool(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    size_t getWorkerCount() const { return m_workers.size(); }
+    // workers plus the calling thread, which helps in parallelFor
+    size_t getConcurrency() const { return m_workers.size() + 1; }
+
+    // run a detached task on a worker
+    void enqueue(std::function<void()> task);
+    // run task(i) for i in [0, count) and wait for all of them, the calling
+    // thread takes part so it is safe to nest calls. Each thread starts on
+    // a slice of the range and steals from the others once done, uneven
+    // items balance out without a shared counter.
+    void parallelFor(size_t count, const std::function<void(size_t)>& task,
+                     size_t grainSize = 1);
+
+    // process wide pool with one worker per extra hardware thread
+    static ThreadPool& global();
+
+   private:
+    void workerLoop();
+
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stop{false};
+};
+
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_THREAD_POOL_HPP */
@@ -0,0 +1,85 @@
+#ifndef LOO_INCLUDE_LOO_VERTEX_FORMAT_HPP
+#define LOO_INCLUDE_LOO_VERTEX_FORMAT_HPP
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <vector>
+
+#include "predefs.hpp"
+
+namespace loo {
+struct Vertex;
+
+// GPU side layout of the vertices, the CPU side always keeps loo::Vertex
+enum class VertexFormat {
+    // loo::Vertex as is, 88 bytes
+    Full,
+    // quantized attributes, 20 bytes (28 bytes with bones), see PackedVertex
+    Packed
+};
+
+// Attribute locations are the same as the full format:
+//  0: position, unorm16x4, xyz relative to the mesh bounds (see
+//     Mesh::getPositionDecodeMatrix()), w holds the bitangent sign
+//  1: normal, snorm16x2 octahedral
+//  2: texCoord, unorm16x2 when every uv is in [0, 1], half float otherwise
+//  3: tangent, snorm16x2 octahedral
+//  4: unused, rebuild the bitangent from normal, tangent and sign
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texCoord[2];
+    int16_t tangent[2];
+};
+//  5: boneIds, uint8x4
+//  6: boneWeights, unorm8x4
+// Meshes without bones drop these two streams and set the current values of
+// both attributes to zero instead (context state, which nothing else in loo
+// changes), so skinning shaders must treat a zero total weight as unskinned.
+struct PackedSkinnedVertex {
+    PackedVertex base;
+    uint8_t boneIds[4];
+    uint8_t boneWeights[4];
+};
+
+struct PackedVertexStream {
+    // PackedVertex or PackedSkinnedVertex array
+    std::vector<uint8_t> data;
+    GLsizei stride{0};
+    bool skinned{false};
+    // GL_UNSIGNED_SHORT (normalized) or GL_HALF_FLOAT
+    GLenum texCoordType{GL_HALF_FLOAT};
+    // position = positionOffset + quantized.xyz * positionScale
+    glm::vec3 positionOffset{0.0f};
+    glm::vec3 positionScale{1.0f};
+};
+
+// returns false if the vertices can't be packed (bone index above 255)
+LOO_EXPORT bool packVertices(const std::vector<Vertex>& vertices,
+                             PackedVertexStream& stream);
+// set the attribute pointers of the currently bound VAO/VBO
+LOO_EXPORT void setupFullVertexAttributes();
+LOO_EXPORT void setupPackedVertexAttributes(const PackedVertexStream& stream);
+
+// GLSL helpers to decode VertexFormat::Packed in a vertex shader:
+//   worldPos = model * Mesh::getPositionDecodeMatrix() * vec4(pos.xyz, 1)
+//   N = looOctDecode(normal), T = looOctDecode(tangent)
+//   B = looBitangentSign(pos.w) * cross(N, T)
+// the normal matrix must come from the model matrix alone
+constexpr const char* PACKED_VERTEX_GLSL = R"(
+vec3 looOctDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+float looBitangentSign(float w) {
+    return w * 2.0 - 1.0;
+}
+)";
+}  // namespace loo
+
+#endif /* LOO_INCLUDE_LOO_VERTEX_FORMAT_HPP */
@@ -0,0 +1,19 @@
+#ifndef LOO_INCLUDE_LOO_SIMD_HPP
+#define LOO_INCLUDE_LOO_SIMD_HPP
+
+// SIMD instruction sets the compiler targets, every user keeps a scalar path
+// LOO_SIMD_SSE: SSE2, always there on x86-64
+// LOO_SIMD_AVX2: AVX2 and FMA, with the avx2 build option (xmake f --avx2=y)
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LOO_SIMD_SSE 1
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
+#if defined(__AVX2__) && defined(__FMA__)
+#define LOO_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#endif /* LOO_INCLUDE_LOO_SIMD_HPP */
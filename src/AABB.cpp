@@ -1,7 +1,10 @@
 #include "loo/AABB.hpp"
+#include <cmath>
+#include <glm/common.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/vec4.hpp>
 #include <limits>
+#include "loo/simd.hpp"
 namespace loo {
 AABB::AABB()
     : min(glm::vec3(std::numeric_limits<float>::infinity())),
@@ -11,6 +14,18 @@ void AABB::merge(const AABB& aabb) {
     max = glm::max(max, aabb.max);
 }
 AABB AABB::transform(const glm::mat4& mat) const {
+    if (isEmpty())
+        return AABB();
+    glm::vec3 center = getCenter(), extent = getDiagonal() * 0.5f;
+    glm::vec3 newCenter(mat[3]), newExtent(0.0f);
+    for (int c = 0; c < 3; c++) {
+        glm::vec3 column(mat[c]);
+        newCenter += column * center[c];
+        newExtent += glm::abs(column) * extent[c];
+    }
+    return AABB(newCenter - newExtent, newCenter + newExtent);
+}
+AABB AABB::transformProjective(const glm::mat4& mat) const {
     // loop over all 8 points of the AABB
     glm::vec3 points[8] = {
         glm::vec3(min.x, min.y, min.z), glm::vec3(min.x, min.y, max.z),
@@ -37,4 +52,101 @@ float AABB::getVolume() const {
     auto d = getDiagonal();
     return d.x * d.y * d.z;
 }
-}  // namespace loo
\ No newline at end of file
+bool AABB::isEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+#if defined(LOO_SIMD_SSE)
+// lane i of columns[c][r] is matrices[i][c][r]
+static inline void loadMatrices4(const glm::mat4* matrices,
+                                 __m128 columns[4][4]) {
+    for (int c = 0; c < 4; c++) {
+        __m128 m0 = _mm_loadu_ps(&matrices[0][c][0]);
+        __m128 m1 = _mm_loadu_ps(&matrices[1][c][0]);
+        __m128 m2 = _mm_loadu_ps(&matrices[2][c][0]);
+        __m128 m3 = _mm_loadu_ps(&matrices[3][c][0]);
+        _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+        columns[c][0] = m0;
+        columns[c][1] = m1;
+        columns[c][2] = m2;
+        columns[c][3] = m3;
+    }
+}
+#endif
+
+void transformAABBs(const AABBArrays& boxes, const glm::mat4* matrices,
+                    size_t count, const AABBArrays& result) {
+    const float* center[3] = {boxes.centerX, boxes.centerY, boxes.centerZ};
+    const float* extent[3] = {boxes.extentX, boxes.extentY, boxes.extentZ};
+    float* newCenter[3] = {result.centerX, result.centerY, result.centerZ};
+    float* newExtent[3] = {result.extentX, result.extentY, result.extentZ};
+    size_t i = 0;
+#if defined(LOO_SIMD_AVX2)
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    for (; i + 8 <= count; i += 8) {
+        __m128 low[4][4], high[4][4];
+        loadMatrices4(matrices + i, low);
+        loadMatrices4(matrices + i + 4, high);
+        __m256 c[3], e[3];
+        for (int k = 0; k < 3; k++) {
+            c[k] = _mm256_loadu_ps(center[k] + i);
+            e[k] = _mm256_loadu_ps(extent[k] + i);
+        }
+        for (int r = 0; r < 3; r++) {
+            __m256 sumCenter = _mm256_set_m128(high[3][r], low[3][r]);
+            __m256 sumExtent = _mm256_setzero_ps();
+            for (int k = 0; k < 3; k++) {
+                __m256 m = _mm256_set_m128(high[k][r], low[k][r]);
+                sumCenter = _mm256_fmadd_ps(m, c[k], sumCenter);
+                sumExtent = _mm256_fmadd_ps(_mm256_and_ps(m, absMask), e[k],
+                                            sumExtent);
+            }
+            _mm256_storeu_ps(newCenter[r] + i, sumCenter);
+            _mm256_storeu_ps(newExtent[r] + i, sumExtent);
+        }
+    }
+#endif
+#if defined(LOO_SIMD_SSE)
+    const __m128 absMask4 = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (; i + 4 <= count; i += 4) {
+        __m128 columns[4][4];
+        loadMatrices4(matrices + i, columns);
+        __m128 c[3], e[3];
+        for (int k = 0; k < 3; k++) {
+            c[k] = _mm_loadu_ps(center[k] + i);
+            e[k] = _mm_loadu_ps(extent[k] + i);
+        }
+        for (int r = 0; r < 3; r++) {
+            __m128 sumCenter = columns[3][r];
+            __m128 sumExtent = _mm_setzero_ps();
+            for (int k = 0; k < 3; k++) {
+                sumCenter =
+                    _mm_add_ps(sumCenter, _mm_mul_ps(columns[k][r], c[k]));
+                sumExtent = _mm_add_ps(
+                    sumExtent,
+                    _mm_mul_ps(_mm_and_ps(columns[k][r], absMask4), e[k]));
+            }
+            _mm_storeu_ps(newCenter[r] + i, sumCenter);
+            _mm_storeu_ps(newExtent[r] + i, sumExtent);
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        const glm::mat4& mat = matrices[i];
+        float c[3], e[3];
+        for (int k = 0; k < 3; k++) {
+            c[k] = center[k][i];
+            e[k] = extent[k][i];
+        }
+        for (int r = 0; r < 3; r++) {
+            float sumCenter = mat[3][r], sumExtent = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                sumCenter += mat[k][r] * c[k];
+                sumExtent += std::abs(mat[k][r]) * e[k];
+            }
+            newCenter[r][i] = sumCenter;
+            newExtent[r][i] = sumExtent;
+        }
+    }
+}
+}  // namespace loo
@@ -1,5 +1,13 @@
 #include "loo/Animation.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <unordered_map>
+#include <utility>
+#include "loo/ThreadPool.hpp"
 #include "loo/utils.hpp"
 namespace loo {
 static void readMissingBones(const aiAnimation* animation,
@@ -36,6 +44,95 @@ static AssimpNodeData readHeirarchyData(const aiNode* src) {
     return dest;
 }
 
+void Animation::compileSkeleton() {
+    std::unordered_map<std::string, int> channels;
+    for (int i = 0; i < (int)bones.size(); i++)
+        channels.emplace(bones[i].name, i);
+    skeleton = Skeleton();
+    // preorder walk, parents always come first
+    std::vector<std::pair<const AssimpNodeData*, int>> stack{{&rootNode, -1}};
+    while (!stack.empty()) {
+        auto [node, parent] = stack.back();
+        stack.pop_back();
+        int joint = skeleton.size();
+        skeleton.parents.push_back(parent);
+        auto channel = channels.find(node->name);
+        skeleton.channels.push_back(
+            channel == channels.end() ? -1 : channel->second);
+        auto boneIndex = boneIndexMap.find(node->name);
+        skeleton.boneIndices.push_back(
+            boneIndex == boneIndexMap.end() ? -1 : boneIndex->second);
+        skeleton.bindLocalTransforms.push_back(node->transformation);
+        skeleton.names.push_back(node->name);
+        for (auto child = node->children.rbegin();
+             child != node->children.rend(); ++child) {
+            stack.emplace_back(&*child, joint);
+        }
+    }
+}
+
+void Animator::resetAnimation(std::shared_ptr<Animation> animation) {
+    m_currentAnimation = std::move(animation);
+    m_currentTime = 0.0f;
+    m_globalTransforms.resize(
+        m_currentAnimation ? m_currentAnimation->skeleton.size() : 0);
+    m_cursors.assign(m_currentAnimation ? m_currentAnimation->bones.size() : 0,
+                     BoneCursor());
+    m_sampler.resize(m_cursors.size());
+    m_localTransforms.resize(m_cursors.size());
+    m_boneGlobals.clear();
+    if (!m_currentAnimation)
+        return;
+    // a bone no joint drives ends up as the identity like before
+    for (const auto& offset : m_currentAnimation->boneMatrices)
+        m_boneGlobals.push_back(glm::inverse(offset));
+}
+
+void Animator::updateAnimation(float dt) {
+    if (m_currentAnimation) {
+        advanceTime(dt);
+        evaluate(finalBoneMatrices.data());
+    }
+}
+
+void Animator::advanceTime(float dt) {
+    if (m_currentAnimation) {
+        m_currentTime += m_currentAnimation->ticksPerSecond * dt;
+        m_currentTime = fmod(m_currentTime, m_currentAnimation->duration);
+    }
+}
+
+void Animator::evaluate(glm::mat4* palette) {
+    if (!m_currentAnimation)
+        return;
+    const auto& animation = *m_currentAnimation;
+    const auto& skeleton = animation.skeleton;
+    // keys are found bone by bone, everything else runs on all of them
+    for (size_t channel = 0; channel < animation.bones.size(); channel++) {
+        m_sampler.gather(channel, animation.bones[channel], m_currentTime,
+                         m_cursors[channel]);
+    }
+    m_sampler.interpolate();
+    m_sampler.compose(m_localTransforms.data());
+    for (size_t joint = 0; joint < skeleton.size(); joint++) {
+        int channel = skeleton.channels[joint];
+        const glm::mat4& localTransform =
+            channel >= 0 ? m_localTransforms[channel]
+                         : skeleton.bindLocalTransforms[joint];
+        int parent = skeleton.parents[joint];
+        if (parent < 0)
+            m_globalTransforms[joint] = localTransform;
+        else
+            multiplyAffines(&m_globalTransforms[parent], &localTransform, 1,
+                            &m_globalTransforms[joint]);
+        int boneIndex = skeleton.boneIndices[joint];
+        if (boneIndex >= 0)
+            m_boneGlobals[boneIndex] = m_globalTransforms[joint];
+    }
+    multiplyAffines(m_boneGlobals.data(), animation.boneMatrices.data(),
+                    m_boneGlobals.size(), palette);
+}
+
 std::shared_ptr<Animation> createAnimationFromAssimp(
     const aiScene& assimpScene, std::map<std::string, int>& boneIndexMap,
     std::vector<glm::mat4>& boneOffsetMatrices) {
@@ -52,4 +149,138 @@ std::shared_ptr<Animation> createAnimationFromAssimp(
                                        boneOffsetMatrices);
 }
 
-}  // namespace loo
\ No newline at end of file
+// scan from the first key like Bone::getPositionIndex did, clamped
+template <typename T>
+static size_t findKeyFromStart(const KeyTrack<T>& track, float time) {
+    size_t key = 0;
+    while (key + 2 < track.size() && track.times[key + 1] <= time)
+        key++;
+    return key;
+}
+
+static BonePose sampleFromStart(const Bone& bone, float time) {
+    BonePose pose;
+    const auto& positions = bone.getPositionTrack();
+    const auto& rotations = bone.getRotationTrack();
+    const auto& scales = bone.getScaleTrack();
+    if (positions.size() > 1) {
+        size_t key = findKeyFromStart(positions, time);
+        pose.translation =
+            glm::mix(positions.values[key], positions.values[key + 1],
+                     positions.getFactor(key, time));
+    } else if (positions.size() == 1) {
+        pose.translation = positions.values[0];
+    }
+    if (rotations.size() > 1) {
+        size_t key = findKeyFromStart(rotations, time);
+        pose.rotation = glm::normalize(
+            glm::slerp(rotations.values[key], rotations.values[key + 1],
+                       rotations.getFactor(key, time)));
+    } else if (rotations.size() == 1) {
+        pose.rotation = glm::normalize(rotations.values[0]);
+    }
+    if (scales.size() > 1) {
+        size_t key = findKeyFromStart(scales, time);
+        pose.scale = glm::mix(scales.values[key], scales.values[key + 1],
+                              scales.getFactor(key, time));
+    } else if (scales.size() == 1) {
+        pose.scale = scales.values[0];
+    }
+    return pose;
+}
+
+double measureKeyframeSampling(const Animation& animation,
+                               size_t frameCount) {
+    using namespace std::chrono;
+    size_t keyCount = 0;
+    for (const auto& bone : animation.bones) {
+        keyCount += bone.getPositionTrack().size() +
+                    bone.getRotationTrack().size() +
+                    bone.getScaleTrack().size();
+    }
+    // keep the results alive so that nothing is optimized out
+    glm::vec3 checksum(0.0f);
+    auto start = steady_clock::now();
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        float time = animation.duration * frame / frameCount;
+        for (const auto& bone : animation.bones)
+            checksum += sampleFromStart(bone, time).translation;
+    }
+    double linearMs =
+        duration<double, std::milli>(steady_clock::now() - start).count();
+
+    std::vector<BoneCursor> cursors(animation.bones.size());
+    start = steady_clock::now();
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        float time = animation.duration * frame / frameCount;
+        for (size_t i = 0; i < animation.bones.size(); i++)
+            checksum -= animation.bones[i].sample(time, cursors[i]).translation;
+    }
+    double cursorMs =
+        duration<double, std::milli>(steady_clock::now() - start).count();
+
+    double speedup = cursorMs > 0.0 ? linearMs / cursorMs : 0.0;
+    LOG(INFO) << "keyframe sampling of " << animation.bones.size()
+              << " bones, " << keyCount << " keys, " << frameCount
+              << " frames: linear search " << linearMs << "ms, cursor "
+              << cursorMs << "ms (" << speedup << "x), drift "
+              << glm::length(checksum);
+    return speedup;
+}
+
+void AnimatorBatch::update(const std::vector<Animator*>& animators, float dt,
+                           ThreadPool* pool) {
+    // the layout only changes with the set of animators, resizing the same
+    // palette again is free
+    m_offsets.resize(animators.size());
+    size_t matrixCount = 0;
+    for (size_t i = 0; i < animators.size(); i++) {
+        m_offsets[i] = matrixCount;
+        matrixCount += animators[i]->getBoneCount();
+    }
+    m_palette.resize(matrixCount, glm::identity<glm::mat4>());
+    if (!pool)
+        pool = &ThreadPool::global();
+    // every task writes its own animator and palette slice
+    pool->parallelFor(animators.size(), [&](size_t i) {
+        animators[i]->advanceTime(dt);
+        animators[i]->evaluate(m_palette.data() + m_offsets[i]);
+    });
+}
+
+void measureAnimatorBatch(std::shared_ptr<Animation> animation,
+                          size_t characterCount, size_t frameCount) {
+    using namespace std::chrono;
+    CHECK(animation) << "no animation to measure";
+    std::vector<Animator> crowd;
+    crowd.reserve(characterCount);
+    std::vector<Animator*> animators;
+    for (size_t i = 0; i < characterCount; i++) {
+        crowd.emplace_back(animation);
+        // spread the characters over the clip
+        crowd.back().advanceTime(float(i) / characterCount *
+                                 animation->duration /
+                                 std::max(animation->ticksPerSecond, 1));
+        animators.push_back(&crowd.back());
+    }
+    const float dt = 1.0f / 60.0f;
+    for (size_t threadCount : {1, 4, 16}) {
+        ThreadPool pool(threadCount - 1);
+        AnimatorBatch batch;
+        // first frame sizes the palette
+        batch.update(animators, dt, &pool);
+        auto start = steady_clock::now();
+        for (size_t frame = 0; frame < frameCount; frame++)
+            batch.update(animators, dt, &pool);
+        double ms =
+            duration<double, std::milli>(steady_clock::now() - start).count();
+        double perMs = ms > 0.0 ? characterCount * frameCount / ms : 0.0;
+        LOG(INFO) << "animator batch of " << characterCount << " characters, "
+                  << animation->skeleton.size() << " joints, "
+                  << threadCount << " threads: " << perMs
+                  << " characters/ms, palette of "
+                  << batch.getPalette().size() << " matrices";
+    }
+}
+
+}  // namespace loo
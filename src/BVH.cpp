@@ -0,0 +1,626 @@
+#include "loo/BVH.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+#include <glm/vec4.hpp>
+#include <numeric>
+#include <random>
+
+#include "loo/Mesh.hpp"
+#include "loo/Scene.hpp"
+#include "loo/ThreadPool.hpp"
+#include "loo/simd.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+static constexpr size_t BVH_BIN_COUNT = 16;
+// subtrees with more primitives are built in parallel
+static constexpr size_t BVH_PARALLEL_THRESHOLD = 4096;
+// deeper nodes split at the object median, which bounds the traversal stack
+static constexpr size_t BVH_MAX_SAH_DEPTH = 48;
+static constexpr size_t BVH_STACK_SIZE = 256;
+static constexpr float BVH_TRAVERSAL_COST = 1.0f, BVH_INTERSECT_COST = 1.0f;
+
+static float getHalfArea(const AABB& box) {
+    vec3 d = box.max - box.min;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+struct BVHBuildNode {
+    AABB bounds;
+    uint32_t left{BVH_INVALID_INDEX}, right{BVH_INVALID_INDEX};
+    // leaf primitives in the order array, count is 0 for inner nodes
+    uint32_t first{0}, count{0};
+};
+
+struct BVHBuilder {
+    BVHBuilder(const vector<AABB>& bounds, vector<uint32_t>& order,
+               ThreadPool& pool)
+        : bounds(bounds),
+          order(order),
+          pool(pool),
+          centroids(bounds.size()),
+          nodes(bounds.size() * 2) {
+        for (size_t i = 0; i < bounds.size(); i++)
+            centroids[i] = bounds[i].getCenter();
+    }
+
+    const vector<AABB>& bounds;
+    vector<uint32_t>& order;
+    ThreadPool& pool;
+    vector<vec3> centroids;
+    // a binary tree over n primitives has at most 2n - 1 nodes
+    vector<BVHBuildNode> nodes;
+    atomic<uint32_t> nodeCount{1};
+
+    void buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count,
+                   size_t depth);
+};
+
+void BVHBuilder::buildNode(uint32_t nodeIndex, uint32_t first, uint32_t count,
+                           size_t depth) {
+    auto& node = nodes[nodeIndex];
+    AABB box, centroidBox;
+    for (uint32_t i = first; i < first + count; i++) {
+        box.merge(bounds[order[i]]);
+        centroidBox.merge(AABB(centroids[order[i]], centroids[order[i]]));
+    }
+    node.bounds = box;
+    if (count == 1) {
+        node.first = first;
+        node.count = count;
+        return;
+    }
+
+    // binned SAH over the three axes, a split goes after bestBin
+    vec3 extent = centroidBox.max - centroidBox.min;
+    float bestCost = numeric_limits<float>::infinity();
+    int bestAxis = -1;
+    size_t bestBin = 0;
+    auto getBin = [&](const vec3& centroid, int axis) {
+        float scale = BVH_BIN_COUNT / extent[axis];
+        size_t bin = (centroid[axis] - centroidBox.min[axis]) * scale;
+        return std::min(bin, BVH_BIN_COUNT - 1);
+    };
+    for (int axis = 0; axis < 3 && depth < BVH_MAX_SAH_DEPTH; axis++) {
+        if (extent[axis] <= 0.0f)
+            continue;
+        AABB bins[BVH_BIN_COUNT];
+        uint32_t binCounts[BVH_BIN_COUNT] = {};
+        for (uint32_t i = first; i < first + count; i++) {
+            size_t bin = getBin(centroids[order[i]], axis);
+            bins[bin].merge(bounds[order[i]]);
+            binCounts[bin]++;
+        }
+        // sweep from the right for the area and count of every right side
+        float rightAreas[BVH_BIN_COUNT];
+        uint32_t rightCounts[BVH_BIN_COUNT];
+        AABB side;
+        uint32_t sideCount = 0;
+        for (size_t bin = BVH_BIN_COUNT - 1; bin > 0; bin--) {
+            side.merge(bins[bin]);
+            sideCount += binCounts[bin];
+            rightAreas[bin] = sideCount ? getHalfArea(side) : 0.0f;
+            rightCounts[bin] = sideCount;
+        }
+        side = AABB();
+        sideCount = 0;
+        for (size_t bin = 0; bin + 1 < BVH_BIN_COUNT; bin++) {
+            side.merge(bins[bin]);
+            sideCount += binCounts[bin];
+            if (sideCount == 0 || rightCounts[bin + 1] == 0)
+                continue;
+            float cost = getHalfArea(side) * sideCount +
+                         rightAreas[bin + 1] * rightCounts[bin + 1];
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    auto begin = order.begin() + first, end = begin + count;
+    uint32_t leftCount;
+    if (bestAxis >= 0) {
+        float leafCost = BVH_INTERSECT_COST * count;
+        float splitCost =
+            BVH_TRAVERSAL_COST + BVH_INTERSECT_COST * bestCost /
+                                     std::max(getHalfArea(box), 1e-30f);
+        if (count <= BVH_MAX_LEAF_SIZE && leafCost <= splitCost) {
+            node.first = first;
+            node.count = count;
+            return;
+        }
+        auto middle = std::partition(begin, end, [&](uint32_t primitive) {
+            return getBin(centroids[primitive], bestAxis) <= bestBin;
+        });
+        leftCount = middle - begin;
+    } else if (count <= BVH_MAX_LEAF_SIZE && depth < BVH_MAX_SAH_DEPTH) {
+        // every centroid at the same spot
+        node.first = first;
+        node.count = count;
+        return;
+    } else {
+        // object median along the widest axis
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0
+                   : extent.y >= extent.z                      ? 1
+                                                               : 2;
+        leftCount = count / 2;
+        nth_element(begin, begin + leftCount, end,
+                    [&](uint32_t a, uint32_t b) {
+                        return centroids[a][axis] < centroids[b][axis];
+                    });
+    }
+
+    uint32_t left = nodeCount.fetch_add(2), right = left + 1;
+    node.left = left;
+    node.right = right;
+    auto buildChild = [&](size_t child) {
+        if (child == 0)
+            buildNode(left, first, leftCount, depth + 1);
+        else
+            buildNode(right, first + leftCount, count - leftCount, depth + 1);
+    };
+    if (count > BVH_PARALLEL_THRESHOLD) {
+        pool.parallelFor(2, buildChild);
+    } else {
+        buildChild(0);
+        buildChild(1);
+    }
+}
+
+// open the largest inner children until there are four of them
+static uint32_t collapseNode(const vector<BVHBuildNode>& binary,
+                             uint32_t index, vector<BVH4Node>& nodes) {
+    uint32_t children[4];
+    int childCount = 0;
+    const auto& root = binary[index];
+    if (root.count) {
+        children[childCount++] = index;
+    } else {
+        children[childCount++] = root.left;
+        children[childCount++] = root.right;
+    }
+    while (childCount < 4) {
+        int largest = -1;
+        float largestArea = -1.0f;
+        for (int i = 0; i < childCount; i++) {
+            const auto& child = binary[children[i]];
+            if (!child.count && getHalfArea(child.bounds) > largestArea) {
+                largest = i;
+                largestArea = getHalfArea(child.bounds);
+            }
+        }
+        if (largest < 0)
+            break;
+        const auto& opened = binary[children[largest]];
+        children[largest] = opened.left;
+        children[childCount++] = opened.right;
+    }
+
+    uint32_t nodeIndex = nodes.size();
+    nodes.emplace_back();
+    for (int i = 0; i < 4; i++) {
+        auto& node = nodes[nodeIndex];
+        if (i >= childCount) {
+            // a box at infinity is missed by every ray with a finite tMax
+            float inf = numeric_limits<float>::infinity();
+            node.minX[i] = node.minY[i] = node.minZ[i] = inf;
+            node.maxX[i] = node.maxY[i] = node.maxZ[i] = inf;
+            node.child[i] = BVH_INVALID_INDEX;
+            node.count[i] = 0;
+            continue;
+        }
+        const auto& child = binary[children[i]];
+        node.minX[i] = child.bounds.min.x;
+        node.minY[i] = child.bounds.min.y;
+        node.minZ[i] = child.bounds.min.z;
+        node.maxX[i] = child.bounds.max.x;
+        node.maxY[i] = child.bounds.max.y;
+        node.maxZ[i] = child.bounds.max.z;
+        node.count[i] = child.count;
+        if (child.count) {
+            node.child[i] = child.first;
+        } else {
+            // nodes may reallocate, write through the index afterwards
+            uint32_t childIndex = collapseNode(binary, children[i], nodes);
+            nodes[nodeIndex].child[i] = childIndex;
+        }
+    }
+    return nodeIndex;
+}
+
+void BVH4::build(const vector<AABB>& bounds, ThreadPool* pool) {
+    m_nodes.clear();
+    m_order.resize(bounds.size());
+    iota(m_order.begin(), m_order.end(), 0);
+    m_bounds = AABB();
+    if (bounds.empty())
+        return;
+    BVHBuilder builder(bounds, m_order, pool ? *pool : ThreadPool::global());
+    builder.buildNode(0, 0, bounds.size(), 0);
+    m_bounds = builder.nodes[0].bounds;
+    m_nodes.reserve(builder.nodeCount.load() / 2 + 1);
+    collapseNode(builder.nodes, 0, m_nodes);
+}
+
+struct BVHRay {
+    vec3 origin, direction, invDirection;
+    float tMin;
+};
+
+static BVHRay createBVHRay(const Ray& ray) {
+    BVHRay bvhRay;
+    bvhRay.origin = ray.origin;
+    bvhRay.direction = ray.direction;
+    // keep slab distances finite for axis aligned rays
+    for (int i = 0; i < 3; i++) {
+        float d = ray.direction[i];
+        if (std::abs(d) < 1e-20f)
+            d = std::copysign(1e-20f, d);
+        bvhRay.invDirection[i] = 1.0f / d;
+    }
+    bvhRay.tMin = ray.tMin;
+    return bvhRay;
+}
+
+// slab test against the four children, returns a mask of the hit ones
+static int intersectNode(const BVH4Node& node, const BVHRay& ray, float tMax,
+                         float tNear[4]) {
+    // empty slots sit at infinity, tMax must stay finite to miss them
+    tMax = std::min(tMax, numeric_limits<float>::max());
+#ifdef LOO_SIMD_SSE
+    __m128 ox = _mm_set1_ps(ray.origin.x), oy = _mm_set1_ps(ray.origin.y),
+           oz = _mm_set1_ps(ray.origin.z);
+    __m128 ix = _mm_set1_ps(ray.invDirection.x),
+           iy = _mm_set1_ps(ray.invDirection.y),
+           iz = _mm_set1_ps(ray.invDirection.z);
+    __m128 t0x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+    __m128 t1x = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+    __m128 t0y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+    __m128 t1y = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+    __m128 t0z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+    __m128 t1z = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+    __m128 enter = _mm_max_ps(
+        _mm_max_ps(_mm_min_ps(t0x, t1x), _mm_min_ps(t0y, t1y)),
+        _mm_max_ps(_mm_min_ps(t0z, t1z), _mm_set1_ps(ray.tMin)));
+    __m128 exit = _mm_min_ps(
+        _mm_min_ps(_mm_max_ps(t0x, t1x), _mm_max_ps(t0y, t1y)),
+        _mm_min_ps(_mm_max_ps(t0z, t1z), _mm_set1_ps(tMax)));
+    _mm_storeu_ps(tNear, enter);
+    return _mm_movemask_ps(_mm_cmple_ps(enter, exit));
+#else
+    int mask = 0;
+    const float* mins[3] = {node.minX, node.minY, node.minZ};
+    const float* maxs[3] = {node.maxX, node.maxY, node.maxZ};
+    for (int i = 0; i < 4; i++) {
+        float enter = ray.tMin, exit = tMax;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (mins[axis][i] - ray.origin[axis]) *
+                       ray.invDirection[axis];
+            float t1 = (maxs[axis][i] - ray.origin[axis]) *
+                       ray.invDirection[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        tNear[i] = enter;
+        mask |= int(enter <= exit) << i;
+    }
+    return mask;
+#endif
+}
+
+// Stack traversal, leaves are visited nearest first as soon as their parent
+// is, inner children are pushed so that the nearest is popped first.
+// intersectLeaf(first, count, tMax) shrinks tMax and returns true on a hit.
+template <bool ANY_HIT, typename LeafFunction>
+static bool traverseBVH4(const vector<BVH4Node>& nodes, const BVHRay& ray,
+                         float& tMax, LeafFunction&& intersectLeaf) {
+    if (nodes.empty())
+        return false;
+    struct Entry {
+        uint32_t node;
+        float tNear;
+    };
+    Entry stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = {0, ray.tMin};
+    bool hit = false;
+    while (top > 0) {
+        Entry entry = stack[--top];
+        if (entry.tNear > tMax)
+            continue;
+        const auto& node = nodes[entry.node];
+        float tNear[4];
+        int mask = intersectNode(node, ray, tMax, tNear);
+        int order[4], hitCount = 0;
+        for (int i = 0; i < 4; i++) {
+            if (mask & (1 << i))
+                order[hitCount++] = i;
+        }
+        // nearest first
+        for (int i = 1; i < hitCount; i++) {
+            for (int j = i; j > 0 && tNear[order[j]] < tNear[order[j - 1]];
+                 j--)
+                std::swap(order[j], order[j - 1]);
+        }
+        for (int k = 0; k < hitCount; k++) {
+            int i = order[k];
+            if (!node.isLeaf(i) || tNear[i] > tMax)
+                continue;
+            if (intersectLeaf(node.child[i], node.count[i], tMax)) {
+                hit = true;
+                if (ANY_HIT)
+                    return true;
+            }
+        }
+        for (int k = hitCount - 1; k >= 0; k--) {
+            int i = order[k];
+            if (!node.isLeaf(i) && tNear[i] <= tMax)
+                stack[top++] = {node.child[i], tNear[i]};
+        }
+    }
+    return hit;
+}
+
+void MeshBVH::build(const Mesh& mesh, ThreadPool* pool) {
+    if (!mesh.vertices.empty()) {
+        vector<vec3> positions(mesh.vertices.size());
+        for (size_t i = 0; i < positions.size(); i++)
+            positions[i] = mesh.vertices[i].position;
+        build(positions, mesh.indices, pool);
+        return;
+    }
+    if (mesh.positions.empty() && !mesh.indices.empty()) {
+        LOG(WARNING) << "mesh " << mesh.name
+                     << " has no CPU positions, restore them first";
+    }
+    build(mesh.positions, mesh.indices, pool);
+}
+
+void MeshBVH::build(const vector<vec3>& positions,
+                    const vector<unsigned int>& indices, ThreadPool* pool) {
+    size_t triangleCount = positions.empty() ? 0 : indices.size() / 3;
+    vector<AABB> bounds(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        const vec3& a = positions[indices[i * 3]];
+        const vec3& b = positions[indices[i * 3 + 1]];
+        const vec3& c = positions[indices[i * 3 + 2]];
+        bounds[i] = AABB(glm::min(a, glm::min(b, c)),
+                         glm::max(a, glm::max(b, c)));
+    }
+    m_bvh.build(bounds, pool);
+    // triangles in leaf order, leaves index them directly
+    const auto& order = m_bvh.getPrimitiveOrder();
+    m_triangles.resize(triangleCount);
+    for (size_t i = 0; i < triangleCount; i++) {
+        uint32_t triangle = order[i];
+        const vec3& a = positions[indices[triangle * 3]];
+        const vec3& b = positions[indices[triangle * 3 + 1]];
+        const vec3& c = positions[indices[triangle * 3 + 2]];
+        m_triangles[i] = {a, b - a, c - a, triangle};
+    }
+}
+
+// both faces count, t within [ray.tMin, tMax)
+static bool intersectTriangle(const vec3& v0, const vec3& edge1,
+                              const vec3& edge2, const BVHRay& ray, float tMax,
+                              float& t, float& u, float& v) {
+    vec3 p = cross(ray.direction, edge2);
+    float det = dot(edge1, p);
+    if (det == 0.0f)
+        return false;
+    float invDet = 1.0f / det;
+    vec3 s = ray.origin - v0;
+    u = dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    vec3 q = cross(s, edge1);
+    v = dot(ray.direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    t = dot(edge2, q) * invDet;
+    return t >= ray.tMin && t < tMax;
+}
+
+bool MeshBVH::intersect(const Ray& ray, RayHit& hit) const {
+    BVHRay bvhRay = createBVHRay(ray);
+    float tMax = std::min(ray.tMax, hit.t);
+    return traverseBVH4<false>(
+        m_bvh.getNodes(), bvhRay, tMax,
+        [&](uint32_t first, uint32_t count, float& tMax) {
+            bool found = false;
+            for (uint32_t i = first; i < first + count; i++) {
+                const auto& triangle = m_triangles[i];
+                float t, u, v;
+                if (intersectTriangle(triangle.v0, triangle.edge1,
+                                      triangle.edge2, bvhRay, tMax, t, u, v)) {
+                    tMax = hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.triangle = triangle.index;
+                    found = true;
+                }
+            }
+            return found;
+        });
+}
+
+bool MeshBVH::occluded(const Ray& ray) const {
+    BVHRay bvhRay = createBVHRay(ray);
+    float tMax = ray.tMax;
+    return traverseBVH4<true>(
+        m_bvh.getNodes(), bvhRay, tMax,
+        [&](uint32_t first, uint32_t count, float& tMax) {
+            for (uint32_t i = first; i < first + count; i++) {
+                const auto& triangle = m_triangles[i];
+                float t, u, v;
+                if (intersectTriangle(triangle.v0, triangle.edge1,
+                                      triangle.edge2, bvhRay, tMax, t, u, v))
+                    return true;
+            }
+            return false;
+        });
+}
+
+void SceneBVH::build(const Scene& scene, ThreadPool* pool) {
+    auto start = chrono::steady_clock::now();
+    ThreadPool& threadPool = pool ? *pool : ThreadPool::global();
+    const auto& meshes = scene.getMeshes();
+    m_meshBVHs.assign(meshes.size(), nullptr);
+    // one mesh per task, large meshes split their build further
+    threadPool.parallelFor(meshes.size(), [&](size_t i) {
+        auto bvh = make_shared<MeshBVH>(*meshes[i], &threadPool);
+        if (bvh->countTriangles())
+            m_meshBVHs[i] = std::move(bvh);
+    });
+    updateTransforms(scene);
+
+    size_t triangleCount = 0, nodeCount = m_bvh.getNodes().size();
+    for (const auto& bvh : m_meshBVHs) {
+        if (bvh) {
+            triangleCount += bvh->countTriangles();
+            nodeCount += bvh->countNodes();
+        }
+    }
+    LOG(INFO) << "scene BVH: " << m_instances.size() << " instances, "
+              << triangleCount << " triangles, " << nodeCount
+              << " nodes built in "
+              << chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                                 start)
+                     .count()
+              << "ms";
+}
+
+void SceneBVH::updateTransforms(const Scene& scene) {
+    const auto& meshes = scene.getMeshes();
+    mat4 model = scene.getModelMatrix();
+    vector<Instance> instances;
+    vector<AABB> bounds;
+    // meshes added since build() are left out
+    size_t meshCount = std::min(meshes.size(), m_meshBVHs.size());
+    for (size_t i = 0; i < meshCount; i++) {
+        if (!m_meshBVHs[i])
+            continue;
+        for (size_t j = 0; j < meshes[i]->countInstances(); j++) {
+            mat4 objectToWorld = model * meshes[i]->getInstanceMatrix(j);
+            instances.push_back({m_meshBVHs[i], inverse(objectToWorld),
+                                 uint32_t(i), uint32_t(j)});
+            bounds.push_back(
+                m_meshBVHs[i]->getBounds().transform(objectToWorld));
+        }
+    }
+    m_bvh.build(bounds);
+    // instances in leaf order
+    const auto& order = m_bvh.getPrimitiveOrder();
+    m_instances.clear();
+    m_instances.reserve(instances.size());
+    for (uint32_t index : order)
+        m_instances.push_back(std::move(instances[index]));
+}
+
+// the direction isn't normalized, so distances carry over to object space
+static Ray transformRay(const Ray& ray, const mat4& worldToObject) {
+    Ray objectRay = ray;
+    objectRay.origin = vec3(worldToObject * vec4(ray.origin, 1.0f));
+    objectRay.direction = mat3(worldToObject) * ray.direction;
+    return objectRay;
+}
+
+bool SceneBVH::intersect(const Ray& ray, RayHit& hit) const {
+    BVHRay bvhRay = createBVHRay(ray);
+    float tMax = std::min(ray.tMax, hit.t);
+    return traverseBVH4<false>(
+        m_bvh.getNodes(), bvhRay, tMax,
+        [&](uint32_t first, uint32_t count, float& tMax) {
+            bool found = false;
+            for (uint32_t i = first; i < first + count; i++) {
+                const auto& instance = m_instances[i];
+                Ray objectRay = transformRay(ray, instance.worldToObject);
+                objectRay.tMax = tMax;
+                if (instance.bvh->intersect(objectRay, hit)) {
+                    tMax = hit.t;
+                    hit.mesh = instance.mesh;
+                    hit.instance = instance.instance;
+                    found = true;
+                }
+            }
+            return found;
+        });
+}
+
+bool SceneBVH::occluded(const Ray& ray) const {
+    BVHRay bvhRay = createBVHRay(ray);
+    float tMax = ray.tMax;
+    return traverseBVH4<true>(
+        m_bvh.getNodes(), bvhRay, tMax,
+        [&](uint32_t first, uint32_t count, float& tMax) {
+            for (uint32_t i = first; i < first + count; i++) {
+                const auto& instance = m_instances[i];
+                Ray objectRay = transformRay(ray, instance.worldToObject);
+                objectRay.tMax = tMax;
+                if (instance.bvh->occluded(objectRay))
+                    return true;
+            }
+            return false;
+        });
+}
+
+double measureRayThroughput(const SceneBVH& bvh, size_t rayCount,
+                            bool anyHit, ThreadPool* pool) {
+    if (bvh.countInstances() == 0 || rayCount == 0)
+        return 0.0;
+    ThreadPool& threadPool = pool ? *pool : ThreadPool::global();
+    // from a sphere around the bounds towards random points inside them
+    const AABB& bounds = bvh.getBounds();
+    vec3 center = bounds.getCenter();
+    float radius = length(bounds.getDiagonal()) * 0.5f;
+    mt19937 rng(42);
+    normal_distribution<float> gaussian;
+    uniform_real_distribution<float> uniform;
+    vector<Ray> rays(rayCount);
+    for (auto& ray : rays) {
+        vec3 onSphere =
+            normalize(vec3(gaussian(rng), gaussian(rng), gaussian(rng)));
+        vec3 target = bounds.min + bounds.getDiagonal() *
+                                       vec3(uniform(rng), uniform(rng),
+                                            uniform(rng));
+        ray.origin = center + onSphere * radius;
+        ray.direction = target - ray.origin;
+    }
+
+    vector<uint8_t> hits(rayCount);
+    auto start = chrono::steady_clock::now();
+    threadPool.parallelFor(
+        rayCount,
+        [&](size_t i) {
+            if (anyHit) {
+                hits[i] = bvh.occluded(rays[i]);
+            } else {
+                RayHit hit;
+                hits[i] = bvh.intersect(rays[i], hit);
+            }
+        },
+        1024);
+    double seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    size_t hitCount = accumulate(hits.begin(), hits.end(), size_t(0));
+    double mrays = rayCount / std::max(seconds, 1e-9) / 1e6;
+    LOG(INFO) << (anyHit ? "any hit: " : "closest hit: ") << rayCount
+              << " rays in " << seconds * 1e3 << "ms, " << mrays
+              << " Mrays/s on " << threadPool.getConcurrency()
+              << " threads, " << hitCount * 100.0 / rayCount << "% hit";
+    return mrays;
+}
+
+}  // namespace loo
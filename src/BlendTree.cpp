@@ -0,0 +1,301 @@
+#include "loo/BlendTree.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include "loo/Animation.hpp"
+#include "loo/ThreadPool.hpp"
+namespace loo {
+
+// translation, rotation and scale of an affine matrix without shear
+static BonePose decomposeAffine(const glm::mat4& m) {
+    BonePose pose;
+    glm::mat3 rotation;
+    for (int c = 0; c < 3; c++) {
+        glm::vec3 column(m[c]);
+        pose.scale[c] = glm::length(column);
+        rotation[c] =
+            pose.scale[c] > 0.0f ? column / pose.scale[c] : glm::vec3(0.0f);
+    }
+    pose.translation = glm::vec3(m[3]);
+    pose.rotation = glm::normalize(glm::quat_cast(rotation));
+    return pose;
+}
+
+BlendTree::BlendTree(std::shared_ptr<Animation> skeleton)
+    : m_skeleton(std::move(skeleton)) {
+    CHECK(m_skeleton) << "blend tree without a skeleton";
+    const Skeleton& joints = m_skeleton->skeleton;
+    m_jointCount = joints.size();
+    m_bindPoses.reserve(m_jointCount);
+    for (const auto& transform : joints.bindLocalTransforms)
+        m_bindPoses.push_back(decomposeAffine(transform));
+    m_factors.resize(m_jointCount);
+    m_localTransforms.resize(m_jointCount);
+    m_globalTransforms.resize(m_jointCount);
+    // a bone no joint drives ends up as the identity, as with Animator
+    for (const auto& offset : m_skeleton->boneMatrices)
+        m_boneGlobals.push_back(glm::inverse(offset));
+}
+
+size_t BlendTree::addNode(Node node) {
+    if (node.type != NodeType::Clip)
+        node.pose.resize(m_jointCount);
+    node.targetWeight = node.weight;
+    m_nodes.push_back(std::move(node));
+    return m_nodes.size() - 1;
+}
+
+size_t BlendTree::addClip(std::shared_ptr<Animation> clip) {
+    CHECK(clip) << "null clip";
+    std::unordered_map<std::string, int> channels;
+    for (int i = 0; i < (int)clip->bones.size(); i++)
+        channels.emplace(clip->bones[i].name, i);
+    const Skeleton& joints = m_skeleton->skeleton;
+    Node node;
+    node.type = NodeType::Clip;
+    node.clip = std::move(clip);
+    node.channels.assign(m_jointCount, -1);
+    node.cursors.resize(m_jointCount);
+    node.sampler.resize(m_jointCount);
+    size_t matched = 0;
+    for (size_t joint = 0; joint < m_jointCount; joint++) {
+        auto channel = channels.find(joints.names[joint]);
+        if (channel != channels.end()) {
+            node.channels[joint] = channel->second;
+            matched++;
+        } else {
+            // gathered once, evaluate() only visits the joints with keys
+            node.sampler.gather(joint, m_bindPoses[joint]);
+        }
+    }
+    LOG_IF(WARNING, matched < channels.size())
+        << channels.size() - matched << " bones of the clip are not in the "
+        << "skeleton of the blend tree";
+    return addNode(std::move(node));
+}
+
+size_t BlendTree::addBlend(size_t a, size_t b, float weight, size_t mask) {
+    CHECK(a < m_nodes.size() && b < m_nodes.size())
+        << "blend of nodes not added yet";
+    CHECK(mask == BLEND_NO_MASK || mask < m_masks.size()) << "unknown mask";
+    Node node;
+    node.type = NodeType::Blend;
+    node.inputs[0] = a;
+    node.inputs[1] = b;
+    node.weight = weight;
+    node.mask = mask;
+    return addNode(std::move(node));
+}
+
+size_t BlendTree::addAdditive(size_t base, size_t additive, float weight,
+                              size_t mask) {
+    CHECK(base < m_nodes.size() && additive < m_nodes.size())
+        << "additive of nodes not added yet";
+    CHECK(m_nodes[additive].type == NodeType::Clip)
+        << "additive layers are clips";
+    CHECK(mask == BLEND_NO_MASK || mask < m_masks.size()) << "unknown mask";
+    Node& layer = m_nodes[additive];
+    if (layer.inverseReference.size() == 0) {
+        // the first frame is the pose the layer was authored against
+        layer.inverseReference.resize(m_jointCount);
+        for (size_t joint = 0; joint < m_jointCount; joint++) {
+            int channel = layer.channels[joint];
+            BonePose pose = m_bindPoses[joint];
+            if (channel >= 0) {
+                BoneCursor cursor;
+                pose = layer.clip->bones[channel].sample(0.0f, cursor);
+            }
+            pose.translation = -pose.translation;
+            pose.rotation = glm::conjugate(pose.rotation);
+            pose.scale = 1.0f / pose.scale;
+            layer.inverseReference.setPose(joint, pose);
+        }
+    }
+    Node node;
+    node.type = NodeType::Additive;
+    node.inputs[0] = base;
+    node.inputs[1] = additive;
+    node.weight = weight;
+    node.mask = mask;
+    return addNode(std::move(node));
+}
+
+size_t BlendTree::addMask(std::vector<float> jointWeights) {
+    CHECK_EQ(jointWeights.size(), m_jointCount)
+        << "a mask takes one weight per joint";
+    m_masks.push_back(std::move(jointWeights));
+    return m_masks.size() - 1;
+}
+
+std::vector<float> BlendTree::makeSubtreeMask(const std::string& joint,
+                                              float weight) const {
+    const Skeleton& joints = m_skeleton->skeleton;
+    std::vector<float> mask(m_jointCount, 0.0f);
+    auto first = std::find(joints.names.begin(), joints.names.end(), joint);
+    if (first == joints.names.end()) {
+        LOG(WARNING) << "no joint " << joint << " for the mask";
+        return mask;
+    }
+    // preorder, the subtree is the run of joints whose parent is inside it
+    size_t root = first - joints.names.begin();
+    mask[root] = weight;
+    for (size_t i = root + 1;
+         i < m_jointCount && joints.parents[i] >= (int)root; i++)
+        mask[i] = weight;
+    return mask;
+}
+
+void BlendTree::setWeight(size_t node, float weight) {
+    CHECK_LT(node, m_nodes.size());
+    m_nodes[node].weight = weight;
+    m_nodes[node].targetWeight = weight;
+    m_nodes[node].fadeRate = 0.0f;
+}
+
+float BlendTree::getWeight(size_t node) const {
+    CHECK_LT(node, m_nodes.size());
+    return m_nodes[node].weight;
+}
+
+void BlendTree::fadeWeight(size_t node, float target, float seconds) {
+    if (seconds <= 0.0f) {
+        setWeight(node, target);
+        return;
+    }
+    CHECK_LT(node, m_nodes.size());
+    m_nodes[node].targetWeight = target;
+    m_nodes[node].fadeRate = (target - m_nodes[node].weight) / seconds;
+}
+
+void BlendTree::setTime(size_t node, float time) {
+    CHECK_LT(node, m_nodes.size());
+    m_nodes[node].time = time;
+}
+
+float BlendTree::getTime(size_t node) const {
+    CHECK_LT(node, m_nodes.size());
+    return m_nodes[node].time;
+}
+
+void BlendTree::advance(float dt) {
+    for (auto& node : m_nodes) {
+        if (node.clip) {
+            node.time += node.clip->ticksPerSecond * dt;
+            if (node.clip->duration > 0.0f)
+                node.time = std::fmod(node.time, node.clip->duration);
+        }
+        if (node.fadeRate != 0.0f) {
+            float step = node.fadeRate * dt;
+            if (std::abs(node.targetWeight - node.weight) <= std::abs(step)) {
+                node.weight = node.targetWeight;
+                node.fadeRate = 0.0f;
+            } else {
+                node.weight += step;
+            }
+        }
+    }
+}
+
+BonePoseArrays BlendTree::getOutput(size_t node) {
+    Node& n = m_nodes[node];
+    return n.type == NodeType::Clip ? n.sampler.getPoses() : n.pose.getArrays();
+}
+
+void BlendTree::evaluate(glm::mat4* palette) {
+    CHECK(!m_nodes.empty()) << "empty blend tree";
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        Node& node = m_nodes[i];
+        if (node.type == NodeType::Clip) {
+            const auto& bones = node.clip->bones;
+            for (size_t joint = 0; joint < m_jointCount; joint++) {
+                int channel = node.channels[joint];
+                if (channel >= 0) {
+                    node.sampler.gather(joint, bones[channel], node.time,
+                                        node.cursors[joint]);
+                }
+            }
+            node.sampler.interpolate();
+            continue;
+        }
+        if (node.mask == BLEND_NO_MASK) {
+            std::fill(m_factors.begin(), m_factors.end(), node.weight);
+        } else {
+            const float* mask = m_masks[node.mask].data();
+            for (size_t joint = 0; joint < m_jointCount; joint++)
+                m_factors[joint] = node.weight * mask[joint];
+        }
+        BonePoseArrays a = getOutput(node.inputs[0]);
+        BonePoseArrays b = getOutput(node.inputs[1]);
+        if (node.type == NodeType::Blend) {
+            blendPoses(a, b, m_factors.data(), m_jointCount,
+                       node.pose.getArrays());
+        } else {
+            addPoses(a, b, m_nodes[node.inputs[1]].inverseReference.getArrays(),
+                     m_factors.data(), m_jointCount, node.pose.getArrays());
+        }
+    }
+    composeAffines(getOutput(m_nodes.size() - 1), m_jointCount,
+                   m_localTransforms.data());
+    const Skeleton& joints = m_skeleton->skeleton;
+    for (size_t joint = 0; joint < m_jointCount; joint++) {
+        int parent = joints.parents[joint];
+        if (parent < 0)
+            m_globalTransforms[joint] = m_localTransforms[joint];
+        else
+            multiplyAffines(&m_globalTransforms[parent],
+                            &m_localTransforms[joint], 1,
+                            &m_globalTransforms[joint]);
+        int boneIndex = joints.boneIndices[joint];
+        if (boneIndex >= 0)
+            m_boneGlobals[boneIndex] = m_globalTransforms[joint];
+    }
+    multiplyAffines(m_boneGlobals.data(), m_skeleton->boneMatrices.data(),
+                    m_boneGlobals.size(), palette);
+}
+
+BonePose BlendTree::getLocalPose(size_t joint) const {
+    CHECK_LT(joint, m_jointCount);
+    if (m_nodes.empty())
+        return m_bindPoses[joint];
+    const Node& node = m_nodes.back();
+    return node.type == NodeType::Clip ? node.sampler.getPose(joint)
+                                       : node.pose.getPose(joint);
+}
+
+void measureBlendTree(const BlendTree& tree, size_t characterCount,
+                      size_t frameCount) {
+    using namespace std::chrono;
+    std::vector<BlendTree> crowd(characterCount, tree);
+    // spread the characters over a second of their clips
+    for (size_t i = 0; i < characterCount; i++)
+        crowd[i].advance(float(i) / characterCount);
+    size_t boneCount = tree.getBoneCount();
+    std::vector<glm::mat4> palette(characterCount * boneCount);
+    size_t threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    ThreadPool pool(threadCount - 1);
+    const float dt = 1.0f / 60.0f;
+    auto start = steady_clock::now();
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        pool.parallelFor(characterCount, [&](size_t i) {
+            crowd[i].advance(dt);
+            crowd[i].evaluate(palette.data() + i * boneCount);
+        });
+    }
+    double ms =
+        duration<double, std::milli>(steady_clock::now() - start).count();
+    double perMs = ms > 0.0 ? characterCount * frameCount / ms : 0.0;
+    double frameShare = frameCount ? ms / frameCount / (1000.0 * dt) : 0.0;
+    LOG(INFO) << "blend tree of " << tree.getNodeCount() << " nodes, "
+              << tree.getJointCount() << " joints, " << characterCount
+              << " characters, " << threadCount << " threads: " << perMs
+              << " characters/ms, " << frameShare * 100.0
+              << "% of a 60 Hz frame";
+}
+
+}  // namespace loo
@@ -1,5 +1,6 @@
 #include "loo/Bone.hpp"
 #include <glog/logging.h>
+#include <algorithm>
 #include <glm/gtx/quaternion.hpp>
 #include <utility>
 #include "glm/gtx/compatibility.hpp"
@@ -9,97 +10,146 @@ namespace loo {
 int BONES_MAX_INFLUENCE = 4;
 int BONES_MAX_COUNT = 200;
 
+template <typename T>
+size_t KeyTrack<T>::findKey(float time, uint32_t& cursor) const {
+    size_t count = times.size();
+    if (count < 2)
+        return 0;
+    size_t key = cursor;
+    if (key + 1 < count && times[key] <= time) {
+        // a frame rarely skips more than a few keys
+        for (int step = 0;
+             step < 4 && key + 2 < count && times[key + 1] <= time; step++) {
+            key++;
+        }
+        if (key + 2 >= count || time < times[key + 1]) {
+            cursor = key;
+            return key;
+        }
+    }
+    auto next = std::upper_bound(times.begin(), times.end(), time);
+    key = std::clamp<ptrdiff_t>(next - times.begin() - 1, 0, count - 2);
+    cursor = key;
+    return key;
+}
+
+template <typename T>
+float KeyTrack<T>::getFactor(size_t key, float time) const {
+    float length = times[key + 1] - times[key];
+    if (length <= 0.0f)
+        return 0.0f;
+    return glm::clamp((time - times[key]) / length, 0.0f, 1.0f);
+}
+
+template struct KeyTrack<glm::vec3>;
+template struct KeyTrack<glm::quat>;
+
+glm::mat4 BonePose::toMatrix() const {
+    // translate * rotate * scale without building the three matrices
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f),
+                     glm::vec4(r[1] * scale.y, 0.0f),
+                     glm::vec4(r[2] * scale.z, 0.0f),
+                     glm::vec4(translation, 1.0f));
+}
+
 Bone::Bone(const std::string& name, int id, std::vector<KeyPosition> positions,
            std::vector<KeyRotation> rotations, std::vector<KeyScale> scales)
-    : name(name),
-      id(id),
-      localTransform(1.0f),
-      m_positions(std::move(positions)),
-      m_rotations(std::move(rotations)),
-      m_scales(std::move(scales)) {}
-
-int Bone::getPositionIndex(float animationTime) {
-    for (int index = 0; index < m_positions.size() - 1; ++index) {
-        if (animationTime < m_positions[index + 1].timeStamp)
-            return index;
+    : name(name), id(id), localTransform(1.0f) {
+    for (const auto& key : positions) {
+        m_positions.times.push_back(key.timeStamp);
+        m_positions.values.push_back(key.position);
+    }
+    for (const auto& key : rotations) {
+        m_rotations.times.push_back(key.timeStamp);
+        m_rotations.values.push_back(key.orientation);
+    }
+    for (const auto& key : scales) {
+        m_scales.times.push_back(key.timeStamp);
+        m_scales.values.push_back(key.scale);
     }
-    LOG(WARNING) << "animation time not found in position keys";
-    return -1;
 }
 
-int Bone::getRotationIndex(float animationTime) {
-    for (int index = 0; index < m_rotations.size() - 1; ++index) {
-        if (animationTime < m_rotations[index + 1].timeStamp)
-            return index;
+BonePose Bone::sample(float animationTime, BoneCursor& cursor) const {
+    BonePose pose;
+    if (m_positions.size() == 1) {
+        pose.translation = m_positions.values[0];
+    } else if (m_positions.size() > 1) {
+        size_t key = m_positions.findKey(animationTime, cursor.position);
+        pose.translation = glm::mix(m_positions.values[key],
+                                    m_positions.values[key + 1],
+                                    m_positions.getFactor(key, animationTime));
     }
-    LOG(WARNING) << "animation time not found in rotation keys";
-    return -1;
+    if (m_rotations.size() == 1) {
+        pose.rotation = glm::normalize(m_rotations.values[0]);
+    } else if (m_rotations.size() > 1) {
+        size_t key = m_rotations.findKey(animationTime, cursor.rotation);
+        pose.rotation = glm::normalize(
+            glm::slerp(m_rotations.values[key], m_rotations.values[key + 1],
+                       m_rotations.getFactor(key, animationTime)));
+    }
+    if (m_scales.size() == 1) {
+        pose.scale = m_scales.values[0];
+    } else if (m_scales.size() > 1) {
+        size_t key = m_scales.findKey(animationTime, cursor.scale);
+        pose.scale =
+            glm::mix(m_scales.values[key], m_scales.values[key + 1],
+                     m_scales.getFactor(key, animationTime));
+    }
+    return pose;
 }
 
-int Bone::getScaleIndex(float animationTime) {
-    for (int index = 0; index < m_scales.size() - 1; ++index) {
-        if (animationTime < m_scales[index + 1].timeStamp)
-            return index;
-    }
-    LOG(WARNING) << "animation time not found in scaling keys";
-    return -1;
+std::vector<KeyPosition> Bone::getPositionKeys() const {
+    std::vector<KeyPosition> keys(m_positions.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = {m_positions.values[i], m_positions.times[i]};
+    return keys;
 }
 
-float Bone::getScaleFactor(float lastTimeStamp, float nextTimeStamp,
-                           float animationTime) {
-    float scaleFactor = 0.0f;
-    float midWayLength = animationTime - lastTimeStamp;
-    float framesDiff = nextTimeStamp - lastTimeStamp;
-    scaleFactor = midWayLength / framesDiff;
-    return scaleFactor;
+std::vector<KeyRotation> Bone::getRotationKeys() const {
+    std::vector<KeyRotation> keys(m_rotations.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = {m_rotations.values[i], m_rotations.times[i]};
+    return keys;
 }
 
-glm::mat4 Bone::interpolatePosition(float animationTime) {
-    if (1 == m_positions.size())
-        return glm::translate(glm::mat4(1.0f), m_positions[0].position);
-
-    int p0Index = getPositionIndex(animationTime);
-    int p1Index = p0Index + 1;
-    float scaleFactor =
-        getScaleFactor(m_positions[p0Index].timeStamp,
-                       m_positions[p1Index].timeStamp, animationTime);
-    glm::vec3 finalPosition =
-        glm::lerp(m_positions[p0Index].position, m_positions[p1Index].position,
-                  scaleFactor);
-    return glm::translate(glm::mat4(1.0f), finalPosition);
+std::vector<KeyScale> Bone::getScaleKeys() const {
+    std::vector<KeyScale> keys(m_scales.size());
+    for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = {m_scales.values[i], m_scales.times[i]};
+    return keys;
 }
 
-glm::mat4 Bone::interpolateRotation(float animationTime) {
-    if (1 == m_rotations.size()) {
-        auto rotation = glm::normalize(m_rotations[0].orientation);
-        return glm::toMat4(rotation);
+// index of the last key before animationTime, -1 past the end
+static int findKeyLinear(const std::vector<float>& times, float animationTime) {
+    for (int index = 0; index + 1 < (int)times.size(); ++index) {
+        if (animationTime < times[index + 1])
+            return index;
     }
+    return -1;
+}
+
+int Bone::getPositionIndex(float animationTime) {
+    int index = findKeyLinear(m_positions.times, animationTime);
+    if (index < 0)
+        LOG(WARNING) << "animation time not found in position keys";
+    return index;
+}
 
-    int p0Index = getRotationIndex(animationTime);
-    int p1Index = p0Index + 1;
-    float scaleFactor =
-        getScaleFactor(m_rotations[p0Index].timeStamp,
-                       m_rotations[p1Index].timeStamp, animationTime);
-    glm::quat finalRotation =
-        glm::slerp(m_rotations[p0Index].orientation,
-                   m_rotations[p1Index].orientation, scaleFactor);
-    finalRotation = glm::normalize(finalRotation);
-    return glm::toMat4(finalRotation);
+int Bone::getRotationIndex(float animationTime) {
+    int index = findKeyLinear(m_rotations.times, animationTime);
+    if (index < 0)
+        LOG(WARNING) << "animation time not found in rotation keys";
+    return index;
 }
 
-glm::mat4 Bone::interpolateScaling(float animationTime) {
-    if (1 == m_scales.size())
-        return glm::scale(glm::mat4(1.0f), m_scales[0].scale);
-
-    int p0Index = getScaleIndex(animationTime);
-    int p1Index = p0Index + 1;
-    float scaleFactor =
-        getScaleFactor(m_scales[p0Index].timeStamp, m_scales[p1Index].timeStamp,
-                       animationTime);
-    glm::vec3 finalScale = glm::lerp(m_scales[p0Index].scale,
-                                     m_scales[p1Index].scale, scaleFactor);
-    return glm::scale(glm::mat4(1.0f), finalScale);
+int Bone::getScaleIndex(float animationTime) {
+    int index = findKeyLinear(m_scales.times, animationTime);
+    if (index < 0)
+        LOG(WARNING) << "animation time not found in scaling keys";
+    return index;
 }
+
 Bone createBoneFromAssimp(const std::string& name, int id,
                           const aiNodeAnim* channel) {
     std::vector<KeyPosition> positions;
@@ -0,0 +1,449 @@
+#include "loo/ClipCompression.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "loo/Animation.hpp"
+namespace loo {
+
+// steps of a quantized time or vector component
+static constexpr float QUANTIZED_STEPS = 65535.0f;
+// steps of a smallest three component, which bounds them
+static constexpr float SMALLEST_THREE_STEPS = 32767.0f;
+static constexpr float SMALLEST_THREE_RANGE = 0.707106781f;
+
+size_t CompressedTrack::getByteSize() const {
+    // the range is counted for rotations as well, which don't use it
+    size_t header =
+        times.empty() ? sizeof(constant) : sizeof(min) + sizeof(step);
+    return header + (times.size() + values.size()) * sizeof(uint16_t);
+}
+
+static float getDistance(const glm::vec3& a, const glm::vec3& b) {
+    return glm::length(a - b);
+}
+
+static float getMaxDifference(const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 d = a - b;
+    return std::max({std::abs(d.x), std::abs(d.y), std::abs(d.z)});
+}
+
+// angle of the rotation between a and b, from the chord which stays precise
+// for the tiny angles the tolerances are about
+static float getAngle(const glm::quat& a, const glm::quat& b) {
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    float sign = dot < 0.0f ? -1.0f : 1.0f;
+    float dx = a.x - b.x * sign, dy = a.y - b.y * sign;
+    float dz = a.z - b.z * sign, dw = a.w - b.w * sign;
+    float chord = std::sqrt(dx * dx + dy * dy + dz * dz + dw * dw);
+    return 4.0f * std::asin(std::min(chord * 0.5f, 1.0f));
+}
+
+static glm::vec3 lerpVector(const glm::vec3& a, const glm::vec3& b,
+                            float factor) {
+    return a + (b - a) * factor;
+}
+
+// normalized lerp on the shortest path
+static glm::quat nlerpQuat(const glm::quat& a, const glm::quat& b,
+                           float factor) {
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    float sign = dot < 0.0f ? -1.0f : 1.0f;
+    float x = a.x + (b.x * sign - a.x) * factor;
+    float y = a.y + (b.y * sign - a.y) * factor;
+    float z = a.z + (b.z * sign - a.z) * factor;
+    float w = a.w + (b.w * sign - a.w) * factor;
+    float scale = 1.0f / std::sqrt(x * x + y * y + z * z + w * w);
+    return glm::quat(w * scale, x * scale, y * scale, z * scale);
+}
+
+static void packVector(const glm::vec3& v, const glm::vec3& min,
+                       const glm::vec3& step, uint16_t* words) {
+    for (int k = 0; k < 3; k++) {
+        float steps = step[k] > 0.0f ? (v[k] - min[k]) / step[k] : 0.0f;
+        words[k] = uint16_t(std::lround(glm::clamp(steps, 0.0f,
+                                                   QUANTIZED_STEPS)));
+    }
+}
+
+static glm::vec3 unpackVector(const uint16_t* words, const glm::vec3& min,
+                              const glm::vec3& step) {
+    return min + glm::vec3(words[0], words[1], words[2]) * step;
+}
+
+// the three smallest components of q in 15 bits each, the index of the
+// largest one in the top bits of the first two words; q is negated if
+// needed so that the largest is positive
+static void packQuat(const glm::quat& q, uint16_t* words) {
+    float c[4] = {q.x, q.y, q.z, q.w};
+    int largest = 0;
+    for (int k = 1; k < 4; k++) {
+        if (std::abs(c[k]) > std::abs(c[largest]))
+            largest = k;
+    }
+    float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    for (int k = 0, word = 0; k < 4; k++) {
+        if (k == largest)
+            continue;
+        float unit = (c[k] * sign / SMALLEST_THREE_RANGE + 1.0f) * 0.5f;
+        words[word++] = uint16_t(
+            std::lround(glm::clamp(unit, 0.0f, 1.0f) * SMALLEST_THREE_STEPS));
+    }
+    words[0] |= uint16_t((largest & 1) << 15);
+    words[1] |= uint16_t((largest >> 1) << 15);
+}
+
+static glm::quat unpackQuat(const uint16_t* words) {
+    // components stored in each word, by largest one
+    static const int smallest[4][3] = {
+        {1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}};
+    int largest = (words[0] >> 15) | ((words[1] >> 15) << 1);
+    float c[4], sum = 0.0f;
+    for (int word = 0; word < 3; word++) {
+        float v = (words[word] & 0x7fff) *
+                      (2.0f * SMALLEST_THREE_RANGE / SMALLEST_THREE_STEPS) -
+                  SMALLEST_THREE_RANGE;
+        c[smallest[largest][word]] = v;
+        sum += v * v;
+    }
+    c[largest] = std::sqrt(std::max(1.0f - sum, 0.0f));
+    return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+// KeyTrack::findKey on quantized times
+static size_t findKey(const std::vector<uint16_t>& times, float time,
+                      uint32_t& cursor) {
+    size_t count = times.size();
+    size_t key = cursor;
+    if (key + 1 < count && times[key] <= time) {
+        for (int step = 0;
+             step < 4 && key + 2 < count && times[key + 1] <= time; step++) {
+            key++;
+        }
+        if (key + 2 >= count || time < times[key + 1]) {
+            cursor = key;
+            return key;
+        }
+    }
+    auto next = std::upper_bound(times.begin(), times.end(), time);
+    key = std::clamp<ptrdiff_t>(next - times.begin() - 1, 0, count - 2);
+    cursor = key;
+    return key;
+}
+
+static float getFactor(const std::vector<uint16_t>& times, size_t key,
+                       float time) {
+    float length = float(times[key + 1]) - float(times[key]);
+    if (length <= 0.0f)
+        return 0.0f;
+    return glm::clamp((time - times[key]) / length, 0.0f, 1.0f);
+}
+
+// Greedy reduction: from a kept key, the next one kept is the farthest whose
+// interpolation with it reproduces every key in between within tolerance.
+// decoded are the keys as sampling will see them, raw the original ones.
+template <typename T, typename Lerp, typename Error>
+static std::vector<size_t> reduceKeys(const std::vector<uint16_t>& times,
+                                      const std::vector<T>& decoded,
+                                      const std::vector<T>& raw,
+                                      float tolerance, Lerp lerp,
+                                      Error error) {
+    auto fits = [&](size_t first, size_t last) {
+        float length = float(times[last]) - float(times[first]);
+        for (size_t key = first + 1; key < last; key++) {
+            float factor =
+                length > 0.0f ? (times[key] - float(times[first])) / length
+                              : 0.0f;
+            T value = lerp(decoded[first], decoded[last], factor);
+            if (error(value, raw[key]) > tolerance)
+                return false;
+        }
+        return true;
+    };
+    std::vector<size_t> kept = {0};
+    size_t last = raw.size() - 1;
+    for (size_t first = 0; first < last;) {
+        size_t next = first + 1;
+        while (next < last && fits(first, next + 1))
+            next++;
+        kept.push_back(next);
+        first = next;
+    }
+    return kept;
+}
+
+// Key times are stored in steps of the grid the keys lie on when it is at
+// most 65536 steps long, so that they stay exact; baked and motion capture
+// clips have one. Else the duration is split in 65535 steps.
+static float findTimeStep(const Animation& animation) {
+    float fallback = animation.duration > 0.0f
+                         ? animation.duration / QUANTIZED_STEPS
+                         : 1.0f;
+    std::vector<const std::vector<float>*> tracks;
+    for (const auto& bone : animation.bones) {
+        tracks.push_back(&bone.getPositionTrack().times);
+        tracks.push_back(&bone.getRotationTrack().times);
+        tracks.push_back(&bone.getScaleTrack().times);
+    }
+    // the smallest gap between two keys is the only candidate
+    float step = std::numeric_limits<float>::infinity();
+    for (const auto* times : tracks) {
+        for (size_t key = 1; key < times->size(); key++) {
+            float gap = (*times)[key] - (*times)[key - 1];
+            if (gap > 0.0f)
+                step = std::min(step, gap);
+        }
+    }
+    if (std::isinf(step))
+        return fallback;
+    for (const auto* times : tracks) {
+        for (float time : *times) {
+            float steps = time / step;
+            if (steps < 0.0f || steps > QUANTIZED_STEPS ||
+                std::abs(steps - std::round(steps)) > 1e-3f)
+                return fallback;
+        }
+    }
+    return step;
+}
+
+static std::vector<uint16_t> quantizeTimes(const std::vector<float>& times,
+                                           float timeStep) {
+    std::vector<uint16_t> result;
+    for (float time : times) {
+        result.push_back(uint16_t(std::lround(
+            glm::clamp(time / timeStep, 0.0f, QUANTIZED_STEPS))));
+    }
+    return result;
+}
+
+template <typename Error>
+static CompressedTrack compressVectorTrack(const KeyTrack<glm::vec3>& track,
+                                           const glm::vec3& rest,
+                                           float timeStep, float tolerance,
+                                           Error error) {
+    CompressedTrack result;
+    const auto& raw = track.values;
+    bool constant = std::all_of(raw.begin(), raw.end(), [&](const auto& v) {
+        return error(v, raw[0]) <= tolerance;
+    });
+    if (raw.size() < 2 || constant) {
+        result.constant = glm::vec4(raw.empty() ? rest : raw[0], 0.0f);
+        return result;
+    }
+    glm::vec3 min = raw[0], max = raw[0];
+    for (const auto& v : raw) {
+        min = glm::min(min, v);
+        max = glm::max(max, v);
+    }
+    result.min = min;
+    result.step = (max - min) / QUANTIZED_STEPS;
+    auto times = quantizeTimes(track.times, timeStep);
+    std::vector<uint16_t> words(raw.size() * 3);
+    std::vector<glm::vec3> decoded;
+    for (size_t key = 0; key < raw.size(); key++) {
+        packVector(raw[key], result.min, result.step, &words[key * 3]);
+        decoded.push_back(
+            unpackVector(&words[key * 3], result.min, result.step));
+    }
+    for (size_t key :
+         reduceKeys(times, decoded, raw, tolerance, lerpVector, error)) {
+        result.times.push_back(times[key]);
+        result.values.insert(result.values.end(), &words[key * 3],
+                             &words[key * 3] + 3);
+    }
+    return result;
+}
+
+static CompressedTrack compressRotationTrack(const KeyTrack<glm::quat>& track,
+                                             float timeStep,
+                                             float tolerance) {
+    CompressedTrack result;
+    std::vector<glm::quat> raw;
+    for (const auto& q : track.values)
+        raw.push_back(glm::normalize(q));
+    bool constant = std::all_of(raw.begin(), raw.end(), [&](const auto& q) {
+        return getAngle(q, raw[0]) <= tolerance;
+    });
+    if (raw.size() < 2 || constant) {
+        glm::quat q = raw.empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : raw[0];
+        result.constant = glm::vec4(q.x, q.y, q.z, q.w);
+        return result;
+    }
+    auto times = quantizeTimes(track.times, timeStep);
+    std::vector<uint16_t> words(raw.size() * 3);
+    std::vector<glm::quat> decoded;
+    for (size_t key = 0; key < raw.size(); key++) {
+        packQuat(raw[key], &words[key * 3]);
+        decoded.push_back(unpackQuat(&words[key * 3]));
+    }
+    for (size_t key :
+         reduceKeys(times, decoded, raw, tolerance, nlerpQuat, getAngle)) {
+        result.times.push_back(times[key]);
+        result.values.insert(result.values.end(), &words[key * 3],
+                             &words[key * 3] + 3);
+    }
+    return result;
+}
+
+CompressedClip::CompressedClip(const Animation& animation,
+                               const ClipCompressionOptions& options)
+    : duration(animation.duration),
+      ticksPerSecond(animation.ticksPerSecond),
+      timeStep(findTimeStep(animation)) {
+    BonePose rest;
+    for (const auto& bone : animation.bones) {
+        CompressedBone compressed;
+        compressed.name = bone.name;
+        compressed.id = bone.id;
+        compressed.translation = compressVectorTrack(
+            bone.getPositionTrack(), rest.translation, timeStep,
+            options.translationTolerance, getDistance);
+        compressed.rotation = compressRotationTrack(
+            bone.getRotationTrack(), timeStep, options.rotationTolerance);
+        compressed.scale =
+            compressVectorTrack(bone.getScaleTrack(), rest.scale, timeStep,
+                                options.scaleTolerance, getMaxDifference);
+        bones.push_back(std::move(compressed));
+    }
+}
+
+static glm::vec3 sampleVector(const CompressedTrack& track, float time,
+                              uint32_t& cursor) {
+    if (track.times.empty())
+        return glm::vec3(track.constant);
+    size_t key = findKey(track.times, time, cursor);
+    float factor = getFactor(track.times, key, time);
+    // interpolate the quantized values and scale once
+    const uint16_t* words = &track.values[key * 3];
+    glm::vec3 result;
+    for (int k = 0; k < 3; k++) {
+        float from = words[k], to = words[k + 3];
+        result[k] =
+            track.min[k] + (from + (to - from) * factor) * track.step[k];
+    }
+    return result;
+}
+
+static glm::quat sampleRotation(const CompressedTrack& track, float time,
+                                uint32_t& cursor) {
+    if (track.times.empty()) {
+        return glm::quat(track.constant.w, track.constant.x, track.constant.y,
+                         track.constant.z);
+    }
+    size_t key = findKey(track.times, time, cursor);
+    return nlerpQuat(unpackQuat(&track.values[key * 3]),
+                     unpackQuat(&track.values[key * 3 + 3]),
+                     getFactor(track.times, key, time));
+}
+
+BonePose CompressedClip::sample(size_t bone, float animationTime,
+                                BoneCursor& cursor) const {
+    float time =
+        glm::clamp(animationTime / timeStep, 0.0f, QUANTIZED_STEPS);
+    const auto& tracks = bones[bone];
+    BonePose pose;
+    pose.translation = sampleVector(tracks.translation, time, cursor.position);
+    pose.rotation = sampleRotation(tracks.rotation, time, cursor.rotation);
+    pose.scale = sampleVector(tracks.scale, time, cursor.scale);
+    return pose;
+}
+
+size_t CompressedClip::getByteSize() const {
+    size_t size = 0;
+    for (const auto& bone : bones) {
+        size += bone.translation.getByteSize() +
+                bone.rotation.getByteSize() + bone.scale.getByteSize();
+    }
+    return size;
+}
+
+ClipCompressionReport measureClipCompression(const Animation& animation,
+                                             const CompressedClip& clip,
+                                             size_t frameCount) {
+    using namespace std::chrono;
+    CHECK_EQ(animation.bones.size(), clip.size())
+        << "clip compressed from another animation";
+    ClipCompressionReport report;
+    for (size_t i = 0; i < clip.size(); i++) {
+        const auto& bone = animation.bones[i];
+        const auto& tracks = clip.bones[i];
+        report.rawByteSize +=
+            bone.getPositionTrack().size() * sizeof(KeyPosition) +
+            bone.getRotationTrack().size() * sizeof(KeyRotation) +
+            bone.getScaleTrack().size() * sizeof(KeyScale);
+        report.rawKeyCount += bone.getPositionTrack().size() +
+                              bone.getRotationTrack().size() +
+                              bone.getScaleTrack().size();
+        for (const auto* track :
+             {&tracks.translation, &tracks.rotation, &tracks.scale}) {
+            report.keyCount += track->size();
+            report.constantTrackCount += track->times.empty();
+        }
+    }
+    report.compressedByteSize = clip.getByteSize();
+    report.ratio = report.compressedByteSize
+                       ? float(report.rawByteSize) / report.compressedByteSize
+                       : 0.0f;
+
+    std::vector<BoneCursor> rawCursors(clip.size()), cursors(clip.size());
+    for (size_t frame = 0; frame <= frameCount; frame++) {
+        float time =
+            animation.duration * frame / std::max<size_t>(frameCount, 1);
+        for (size_t i = 0; i < clip.size(); i++) {
+            BonePose raw = animation.bones[i].sample(time, rawCursors[i]);
+            BonePose pose = clip.sample(i, time, cursors[i]);
+            report.maxTranslationError =
+                std::max(report.maxTranslationError,
+                         getDistance(raw.translation, pose.translation));
+            report.maxRotationError = std::max(
+                report.maxRotationError, getAngle(raw.rotation, pose.rotation));
+            report.maxScaleError = std::max(
+                report.maxScaleError, getMaxDifference(raw.scale, pose.scale));
+        }
+    }
+
+    // keep the results alive so that nothing is optimized out
+    float checksum = 0.0f;
+    rawCursors.assign(clip.size(), BoneCursor());
+    auto start = steady_clock::now();
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        float time = animation.duration * frame / frameCount;
+        for (size_t i = 0; i < clip.size(); i++) {
+            BonePose pose = animation.bones[i].sample(time, rawCursors[i]);
+            checksum += pose.translation.x + pose.rotation.w + pose.scale.z;
+        }
+    }
+    report.rawSampleMs =
+        duration<double, std::milli>(steady_clock::now() - start).count();
+    cursors.assign(clip.size(), BoneCursor());
+    start = steady_clock::now();
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        float time = animation.duration * frame / frameCount;
+        for (size_t i = 0; i < clip.size(); i++) {
+            BonePose pose = clip.sample(i, time, cursors[i]);
+            checksum -= pose.translation.x + pose.rotation.w + pose.scale.z;
+        }
+    }
+    report.compressedSampleMs =
+        duration<double, std::milli>(steady_clock::now() - start).count();
+
+    LOG(INFO) << "clip compression of " << clip.size() << " bones: "
+              << report.rawByteSize << " bytes to "
+              << report.compressedByteSize << " (" << report.ratio
+              << "x), keys " << report.rawKeyCount << " to "
+              << report.keyCount << ", " << report.constantTrackCount
+              << " constant tracks";
+    LOG(INFO) << "clip compression max error: translation "
+              << report.maxTranslationError << ", rotation "
+              << report.maxRotationError << " rad, scale "
+              << report.maxScaleError << "; sampling " << frameCount
+              << " frames: raw " << report.rawSampleMs << "ms, compressed "
+              << report.compressedSampleMs << "ms, drift " << checksum;
+    return report;
+}
+
+}  // namespace loo
@@ -0,0 +1,239 @@
+#include "loo/Frustum.hpp"
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+#include "loo/Camera.hpp"
+#include "loo/Scene.hpp"
+#include "loo/simd.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+static vec4 getRow(const mat4& m, int i) {
+    return vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+}
+
+Frustum Frustum::fromMatrix(const mat4& viewProjection, bool zeroToOne) {
+    vec4 r0 = getRow(viewProjection, 0), r1 = getRow(viewProjection, 1),
+         r2 = getRow(viewProjection, 2), r3 = getRow(viewProjection, 3);
+    Frustum frustum;
+    frustum.planes[FRUSTUM_PLANE_LEFT] = r3 + r0;
+    frustum.planes[FRUSTUM_PLANE_RIGHT] = r3 - r0;
+    frustum.planes[FRUSTUM_PLANE_BOTTOM] = r3 + r1;
+    frustum.planes[FRUSTUM_PLANE_TOP] = r3 - r1;
+    frustum.planes[FRUSTUM_PLANE_NEAR] = zeroToOne ? r2 : r3 + r2;
+    frustum.planes[FRUSTUM_PLANE_FAR] = r3 - r2;
+    for (auto& plane : frustum.planes) {
+        float length = glm::length(vec3(plane));
+        // the far plane of an infinite projection has no normal
+        if (length < 1e-12f)
+            plane = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        else
+            plane /= length;
+    }
+    return frustum;
+}
+
+Frustum Frustum::fromCamera(const Camera& camera, bool reverseZ01) {
+    return fromMatrix(
+        camera.getProjectionMatrix(reverseZ01) * camera.getViewMatrix());
+}
+
+bool Frustum::intersects(const AABB& aabb) const {
+    vec3 center = aabb.getCenter(), extent = aabb.getDiagonal() * 0.5f;
+    for (const auto& plane : planes) {
+        vec3 normal(plane);
+        if (dot(normal, center) + plane.w + dot(abs(normal), extent) < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void CullingBounds::resize(size_t count) {
+    m_count = count;
+    size_t padded = (count + 7) / 8 * 8;
+    for (auto* array : {&m_centerX, &m_centerY, &m_centerZ, &m_extentX,
+                        &m_extentY, &m_extentZ}) {
+        array->resize(padded, 0.0f);
+    }
+}
+
+void CullingBounds::set(size_t index, const AABB& aabb) {
+    vec3 center = aabb.getCenter(), extent = aabb.getDiagonal() * 0.5f;
+    m_centerX[index] = center.x;
+    m_centerY[index] = center.y;
+    m_centerZ[index] = center.z;
+    m_extentX[index] = extent.x;
+    m_extentY[index] = extent.y;
+    m_extentZ[index] = extent.z;
+}
+
+void CullingBounds::update(const Scene& scene) {
+    const auto& meshes = scene.getMeshes();
+    mat4 model = scene.getModelMatrix();
+    resize(meshes.size());
+    size_t instanceCount = 0;
+    for (const auto& mesh : meshes)
+        instanceCount += mesh->countInstances();
+    // without instances the boxes are transformed in place
+    AABBArrays result{m_centerX.data(), m_centerY.data(), m_centerZ.data(),
+                      m_extentX.data(), m_extentY.data(), m_extentZ.data()};
+    AABBArrays boxes = result;
+    if (instanceCount != meshes.size()) {
+        m_instanceBoxes.resize(instanceCount * 6);
+        float* data = m_instanceBoxes.data();
+        boxes = {data,
+                 data + instanceCount,
+                 data + instanceCount * 2,
+                 data + instanceCount * 3,
+                 data + instanceCount * 4,
+                 data + instanceCount * 5};
+    }
+    m_instanceMatrices.resize(instanceCount);
+    size_t index = 0;
+    for (const auto& mesh : meshes) {
+        vec3 center = mesh->aabb.getCenter(),
+             extent = mesh->aabb.getDiagonal() * 0.5f;
+        for (size_t i = 0; i < mesh->countInstances(); i++, index++) {
+            boxes.centerX[index] = center.x;
+            boxes.centerY[index] = center.y;
+            boxes.centerZ[index] = center.z;
+            boxes.extentX[index] = extent.x;
+            boxes.extentY[index] = extent.y;
+            boxes.extentZ[index] = extent.z;
+            m_instanceMatrices[index] = model * mesh->getInstanceMatrix(i);
+        }
+    }
+    if (instanceCount == meshes.size()) {
+        transformAABBs(boxes, m_instanceMatrices.data(), instanceCount,
+                       result);
+        return;
+    }
+    transformAABBs(boxes, m_instanceMatrices.data(), instanceCount, boxes);
+    // one box around the instances of each mesh
+    index = 0;
+    for (size_t m = 0; m < meshes.size(); m++) {
+        AABB aabb;
+        for (size_t i = 0; i < meshes[m]->countInstances(); i++, index++) {
+            vec3 center(boxes.centerX[index], boxes.centerY[index],
+                        boxes.centerZ[index]);
+            vec3 extent(boxes.extentX[index], boxes.extentY[index],
+                        boxes.extentZ[index]);
+            aabb.merge(AABB(center - extent, center + extent));
+        }
+        set(m, aabb);
+    }
+}
+
+// Every lane writes its index, only the visible ones move the cursor forward.
+// visible must have room for a full batch past the cursor.
+static inline size_t appendVisible(int mask, uint32_t base, int laneCount,
+                                   uint32_t* visible, size_t count) {
+    for (int lane = 0; lane < laneCount; lane++) {
+        visible[count] = base + lane;
+        count += (mask >> lane) & 1;
+    }
+    return count;
+}
+
+size_t cullFrustum(const Frustum& frustum, const CullingBounds& bounds,
+                   vector<uint32_t>& visible) {
+    size_t boxCount = bounds.m_count;
+    visible.resize(bounds.m_centerX.size());
+    uint32_t* output = visible.data();
+    size_t count = 0;
+    const float* cx = bounds.m_centerX.data();
+    const float* cy = bounds.m_centerY.data();
+    const float* cz = bounds.m_centerZ.data();
+    const float* ex = bounds.m_extentX.data();
+    const float* ey = bounds.m_extentY.data();
+    const float* ez = bounds.m_extentZ.data();
+    // a box is out once it is fully behind a plane:
+    // dot(n, center) + d + dot(|n|, extent) < 0
+    vec4 absNormals[FRUSTUM_PLANE_COUNT];
+    for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+        absNormals[p] = vec4(abs(vec3(frustum.planes[p])), 0.0f);
+    }
+    size_t i = 0;
+#if defined(LOO_SIMD_AVX2)
+    for (; i < boxCount; i += 8) {
+        __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i),
+               z = _mm256_loadu_ps(cz + i);
+        __m256 hx = _mm256_loadu_ps(ex + i), hy = _mm256_loadu_ps(ey + i),
+               hz = _mm256_loadu_ps(ez + i);
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            const vec4& plane = frustum.planes[p];
+            const vec4& absNormal = absNormals[p];
+            __m256 distance = _mm256_fmadd_ps(
+                _mm256_set1_ps(plane.x), x,
+                _mm256_fmadd_ps(
+                    _mm256_set1_ps(plane.y), y,
+                    _mm256_fmadd_ps(_mm256_set1_ps(plane.z), z,
+                                    _mm256_set1_ps(plane.w))));
+            distance = _mm256_fmadd_ps(
+                _mm256_set1_ps(absNormal.x), hx,
+                _mm256_fmadd_ps(
+                    _mm256_set1_ps(absNormal.y), hy,
+                    _mm256_fmadd_ps(_mm256_set1_ps(absNormal.z), hz,
+                                    distance)));
+            inside = _mm256_and_ps(
+                inside,
+                _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GE_OQ));
+        }
+        int mask = _mm256_movemask_ps(inside);
+        if (i + 8 > boxCount)
+            mask &= (1 << (boxCount - i)) - 1;
+        count = appendVisible(mask, i, 8, output, count);
+    }
+#elif defined(LOO_SIMD_SSE)
+    for (; i < boxCount; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i),
+               z = _mm_loadu_ps(cz + i);
+        __m128 hx = _mm_loadu_ps(ex + i), hy = _mm_loadu_ps(ey + i),
+               hz = _mm_loadu_ps(ez + i);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            const vec4& plane = frustum.planes[p];
+            const vec4& absNormal = absNormals[p];
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x),
+                           _mm_mul_ps(_mm_set1_ps(plane.y), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z),
+                           _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(absNormal.x), hx),
+                           _mm_mul_ps(_mm_set1_ps(absNormal.y), hy)),
+                _mm_mul_ps(_mm_set1_ps(absNormal.z), hz));
+            inside = _mm_and_ps(
+                inside, _mm_cmpge_ps(_mm_add_ps(distance, radius),
+                                     _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        if (i + 4 > boxCount)
+            mask &= (1 << (boxCount - i)) - 1;
+        count = appendVisible(mask, i, 4, output, count);
+    }
+#else
+    for (; i < boxCount; i++) {
+        bool inside = true;
+        for (int p = 0; p < FRUSTUM_PLANE_COUNT; p++) {
+            const vec4& plane = frustum.planes[p];
+            const vec4& absNormal = absNormals[p];
+            float distance = plane.x * cx[i] + plane.y * cy[i] +
+                             plane.z * cz[i] + plane.w +
+                             absNormal.x * ex[i] + absNormal.y * ey[i] +
+                             absNormal.z * ez[i];
+            inside &= distance >= 0.0f;
+        }
+        count = appendVisible(inside, i, 1, output, count);
+    }
+#endif
+    visible.resize(count);
+    return count;
+}
+
+}  // namespace loo
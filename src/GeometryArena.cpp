@@ -0,0 +1,204 @@
+#include "loo/GeometryArena.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+#include "loo/Mesh.hpp"
+#include "loo/glError.hpp"
+
+namespace loo {
+
+using namespace std;
+
+GLsizei GeometryLayout::getStride() const {
+    if (format == VertexFormat::Full)
+        return sizeof(Vertex);
+    return skinned ? sizeof(PackedSkinnedVertex) : sizeof(PackedVertex);
+}
+
+bool GeometryLayout::operator==(const GeometryLayout& other) const {
+    if (format != other.format)
+        return false;
+    return format == VertexFormat::Full ||
+           (skinned == other.skinned && texCoordType == other.texCoordType);
+}
+
+bool RangeAllocator::allocate(size_t size, size_t alignment, size_t& offset) {
+    for (auto iter = m_free.begin(); iter != m_free.end(); ++iter) {
+        size_t start = (iter->first + alignment - 1) / alignment * alignment;
+        size_t end = iter->first + iter->second;
+        if (start + size > end)
+            continue;
+        size_t freeOffset = iter->first;
+        m_free.erase(iter);
+        // keep what is left on both sides
+        if (start > freeOffset)
+            m_free[freeOffset] = start - freeOffset;
+        if (start + size < end)
+            m_free[start + size] = end - start - size;
+        m_used += size;
+        offset = start;
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size) {
+    if (size == 0)
+        return;
+    m_used -= size;
+    auto next = m_free.lower_bound(offset);
+    if (next != m_free.end() && offset + size == next->first) {
+        size += next->second;
+        next = m_free.erase(next);
+    }
+    if (next != m_free.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    m_free[offset] = size;
+}
+
+void RangeAllocator::grow(size_t capacity) {
+    if (capacity <= m_capacity)
+        return;
+    size_t offset = m_capacity, size = capacity - m_capacity;
+    m_capacity = capacity;
+    // hand the new tail over as a freed range so it merges with a free end
+    m_used += size;
+    free(offset, size);
+}
+
+GeometryRange::~GeometryRange() {
+    if (arena)
+        arena->release(*this);
+}
+
+GeometryArena::GeometryArena(size_t vertexBytes, size_t indexBytes)
+    : m_initialVertexBytes(vertexBytes) {
+#ifdef OGL_46
+    growIndexBuffer(indexBytes);
+#else
+    NOT_IMPLEMENTED_RUNTIME();
+#endif
+}
+
+GeometryArena::~GeometryArena() {
+    for (auto& buffer : m_layouts) {
+        glDeleteVertexArrays(1, &buffer.vao);
+        glDeleteBuffers(1, &buffer.vbo);
+    }
+    glDeleteBuffers(1, &m_indexBuffer);
+}
+
+// immutable storage, updates go through glNamedBufferSubData
+static GLuint createStorage(size_t size, GLuint previous, size_t previousSize) {
+    GLuint buffer;
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    if (previous) {
+        glCopyNamedBufferSubData(previous, buffer, 0, 0, previousSize);
+        glDeleteBuffers(1, &previous);
+    }
+    logPossibleGLError();
+    return buffer;
+}
+
+size_t GeometryArena::findLayout(const GeometryLayout& layout) {
+    for (size_t i = 0; i < m_layouts.size(); i++) {
+        if (m_layouts[i].layout == layout)
+            return i;
+    }
+    LayoutBuffer buffer;
+    buffer.layout = layout;
+    glCreateVertexArrays(1, &buffer.vao);
+    glVertexArrayElementBuffer(buffer.vao, m_indexBuffer);
+    growVertexBuffer(buffer, m_initialVertexBytes / layout.getStride());
+    m_layouts.push_back(std::move(buffer));
+    return m_layouts.size() - 1;
+}
+
+void GeometryArena::growVertexBuffer(LayoutBuffer& buffer,
+                                     size_t minVertexCount) {
+    GLsizei stride = buffer.layout.getStride();
+    size_t oldCount = buffer.vertices.getCapacity();
+    size_t newCount = std::max(oldCount * 2, minVertexCount);
+    buffer.vbo = createStorage(newCount * stride, buffer.vbo, oldCount * stride);
+    buffer.vertices.grow(newCount);
+
+    // the attribute pointers refer to the buffer, set them up again
+    glBindVertexArray(buffer.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.vbo);
+    if (buffer.layout.format == VertexFormat::Packed) {
+        PackedVertexStream stream;
+        stream.stride = stride;
+        stream.skinned = buffer.layout.skinned;
+        stream.texCoordType = buffer.layout.texCoordType;
+        setupPackedVertexAttributes(stream);
+    } else {
+        setupFullVertexAttributes();
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::growIndexBuffer(size_t minSize) {
+    size_t oldSize = m_indices.getCapacity();
+    size_t newSize = std::max(oldSize * 2, minSize);
+    m_indexBuffer = createStorage(newSize, m_indexBuffer, oldSize);
+    m_indices.grow(newSize);
+    for (auto& buffer : m_layouts)
+        glVertexArrayElementBuffer(buffer.vao, m_indexBuffer);
+}
+
+std::shared_ptr<GeometryRange> GeometryArena::allocate(
+    const GeometryLayout& layout, const void* vertexData, size_t vertexCount,
+    const void* indexData, size_t indexSize) {
+    auto range = make_shared<GeometryRange>();
+    range->layoutIndex = findLayout(layout);
+    auto& buffer = m_layouts[range->layoutIndex];
+    GLsizei stride = layout.getStride();
+    while (!buffer.vertices.allocate(vertexCount, 1, range->baseVertex)) {
+        growVertexBuffer(buffer, buffer.vertices.getCapacity() + vertexCount);
+    }
+    range->vertexCount = vertexCount;
+    // 4 bytes covers both index types
+    while (!m_indices.allocate(indexSize, 4, range->indexOffset)) {
+        growIndexBuffer(m_indices.getCapacity() + indexSize);
+    }
+    range->indexSize = indexSize;
+    range->arena = shared_from_this();
+
+    glNamedBufferSubData(buffer.vbo, range->baseVertex * stride,
+                         vertexCount * stride, vertexData);
+    glNamedBufferSubData(m_indexBuffer, range->indexOffset, indexSize,
+                         indexData);
+    logPossibleGLError();
+    return range;
+}
+
+void GeometryArena::release(const GeometryRange& range) {
+    m_layouts[range.layoutIndex].vertices.free(range.baseVertex,
+                                               range.vertexCount);
+    m_indices.free(range.indexOffset, range.indexSize);
+}
+
+size_t GeometryArena::getUsedBytes() const {
+    size_t bytes = m_indices.getUsed();
+    for (const auto& buffer : m_layouts)
+        bytes += buffer.vertices.getUsed() * buffer.layout.getStride();
+    return bytes;
+}
+
+size_t GeometryArena::getCapacityBytes() const {
+    size_t bytes = m_indices.getCapacity();
+    for (const auto& buffer : m_layouts)
+        bytes += buffer.vertices.getCapacity() * buffer.layout.getStride();
+    return bytes;
+}
+
+}  // namespace loo
@@ -0,0 +1,218 @@
+#include "loo/IndirectDraw.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+
+#include "loo/Mesh.hpp"
+#include "loo/glError.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+IndirectDrawList::~IndirectDrawList() {
+    glDeleteBuffers(1, &m_commandBuffer);
+    glDeleteBuffers(1, &m_drawDataBuffer);
+}
+
+// reallocate when the data outgrows the buffer, otherwise update in place
+static void uploadBuffer(GLuint& buffer, size_t& capacity, const void* data,
+                         size_t size) {
+    if (size == 0)
+        return;
+    if (!buffer)
+        glCreateBuffers(1, &buffer);
+    if (size > capacity) {
+        capacity = std::max(size, capacity * 2);
+        glNamedBufferData(buffer, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glNamedBufferSubData(buffer, 0, size, data);
+}
+
+// opaque first, then whatever sharing the most state
+static auto getBucketKey(const Mesh& mesh, IndirectBucketMode mode) {
+    const Material* material =
+        mode == IndirectBucketMode::Material ? mesh.material.get() : nullptr;
+    return make_tuple(mesh.needAlphaBlend(), mesh.vao, mesh.getIndexType(),
+                      mesh.isDoubleSided(), material);
+}
+
+static size_t countSourceInstances(const vector<shared_ptr<Mesh>>& meshes) {
+    size_t count = 0;
+    for (const auto& mesh : meshes)
+        count += mesh->countInstances();
+    return count;
+}
+
+bool IndirectDrawList::isBuiltFrom(const vector<shared_ptr<Mesh>>& meshes,
+                                   const IndirectDrawOptions& options) const {
+    return m_sourceMeshCount == meshes.size() &&
+           m_options.bucketMode == options.bucketMode &&
+           m_options.lod == options.lod &&
+           m_sourceInstanceCount == countSourceInstances(meshes);
+}
+
+void IndirectDrawList::build(const vector<shared_ptr<Mesh>>& meshes,
+                             const IndirectDrawOptions& options) {
+#ifdef OGL_46
+    m_options = options;
+    m_sourceMeshCount = meshes.size();
+    m_sourceInstanceCount = countSourceInstances(meshes);
+    m_meshes.clear();
+    for (const auto& mesh : meshes) {
+        if (mesh->countTriangles() > 0)
+            m_meshes.push_back(mesh);
+    }
+    stable_sort(m_meshes.begin(), m_meshes.end(),
+                [&](const shared_ptr<Mesh>& a, const shared_ptr<Mesh>& b) {
+                    return getBucketKey(*a, options.bucketMode) <
+                           getBucketKey(*b, options.bucketMode);
+                });
+
+    m_materials.clear();
+    m_materialIndices.clear();
+    map<const Material*, GLuint> materialMap;
+    for (const auto& mesh : m_meshes) {
+        auto [iter, inserted] =
+            materialMap.emplace(mesh->material.get(), m_materials.size());
+        if (inserted)
+            m_materials.push_back(mesh->material);
+        m_materialIndices.push_back(iter->second);
+    }
+
+    m_buckets.clear();
+    m_firstInstances.assign(1, 0);
+    vector<DrawElementsIndirectCommand> commands(m_meshes.size());
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        const auto& mesh = *m_meshes[i];
+        size_t lod = std::min(options.lod, mesh.getLodCount() - 1);
+        auto& command = commands[i];
+        command.count = mesh.countTriangles(lod) * 3;
+        command.instanceCount = mesh.countInstances();
+        command.firstIndex = mesh.getFirstIndex(lod);
+        command.baseVertex = mesh.getBaseVertex();
+        command.baseInstance = m_firstInstances.back();
+        m_firstInstances.push_back(command.baseInstance +
+                                   command.instanceCount);
+
+        if (i == 0 || getBucketKey(mesh, options.bucketMode) !=
+                          getBucketKey(*m_meshes[i - 1], options.bucketMode)) {
+            IndirectDrawBucket bucket;
+            bucket.vao = mesh.vao;
+            bucket.indexType = mesh.getIndexType();
+            if (options.bucketMode == IndirectBucketMode::Material)
+                bucket.material = mesh.material;
+            bucket.alphaBlend = mesh.needAlphaBlend();
+            bucket.doubleSided = mesh.isDoubleSided();
+            bucket.firstCommand = i;
+            m_buckets.push_back(std::move(bucket));
+        }
+        m_buckets.back().commandCount++;
+    }
+    uploadBuffer(m_commandBuffer, m_commandCapacity, commands.data(),
+                 commands.size() * sizeof(DrawElementsIndirectCommand));
+    m_drawIndices.clear();
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        m_drawIndices[m_meshes[i].get()] = i;
+    }
+    updateDrawData();
+    LOG(INFO) << "Indirect draw list: " << m_meshes.size() << " draws of "
+              << m_drawData.size() << " instances in " << m_buckets.size()
+              << " buckets";
+#else
+    NOT_IMPLEMENTED_RUNTIME();
+#endif
+}
+
+void IndirectDrawList::fillDrawData(size_t draw) {
+    const auto& mesh = *m_meshes[draw];
+    mat4 decode = mesh.getPositionDecodeMatrix();
+    // instances added since build() wait for the next one
+    size_t count = std::min<size_t>(
+        mesh.countInstances(),
+        m_firstInstances[draw + 1] - m_firstInstances[draw]);
+    for (size_t i = 0; i < count; i++) {
+        auto& data = m_drawData[m_firstInstances[draw] + i];
+        data.objectMatrix = mesh.getInstanceMatrix(i);
+        data.objectMatrixPrev = mesh.getInstanceMatrixPrev(i);
+        data.positionDecodeScale =
+            vec4(decode[0][0], decode[1][1], decode[2][2], 0.0f);
+        data.positionDecodeOffset = vec4(vec3(decode[3]), 0.0f);
+        data.materialIndex = m_materialIndices[draw];
+        data.lod = std::min(m_options.lod, mesh.getLodCount() - 1);
+        data.padding[0] = data.padding[1] = 0;
+    }
+}
+
+void IndirectDrawList::updateDrawData() {
+#ifdef OGL_46
+    m_drawData.resize(m_firstInstances.back());
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        fillDrawData(i);
+    }
+    uploadBuffer(m_drawDataBuffer, m_drawDataCapacity, m_drawData.data(),
+                 m_drawData.size() * sizeof(IndirectDrawData));
+    logPossibleGLError();
+#else
+    NOT_IMPLEMENTED_RUNTIME();
+#endif
+}
+
+void IndirectDrawList::updateDrawData(const vector<const Mesh*>& meshes) {
+#ifdef OGL_46
+    vector<uint32_t> draws;
+    draws.reserve(meshes.size());
+    for (const auto* mesh : meshes) {
+        auto iter = m_drawIndices.find(mesh);
+        if (iter != m_drawIndices.end())
+            draws.push_back(iter->second);
+    }
+    sort(draws.begin(), draws.end());
+    draws.erase(unique(draws.begin(), draws.end()), draws.end());
+    for (size_t i = 0; i < draws.size();) {
+        size_t first = draws[i], last = first;
+        for (; i < draws.size() && draws[i] == last; i++, last++) {
+            fillDrawData(last);
+        }
+        size_t begin = m_firstInstances[first], end = m_firstInstances[last];
+        glNamedBufferSubData(m_drawDataBuffer,
+                             begin * sizeof(IndirectDrawData),
+                             (end - begin) * sizeof(IndirectDrawData),
+                             m_drawData.data() + begin);
+    }
+    logPossibleGLError();
+#else
+    NOT_IMPLEMENTED_RUNTIME();
+#endif
+}
+
+void IndirectDrawList::draw(const IndirectDrawCallback& beforeBucket) const {
+#ifdef OGL_46
+    if (m_buckets.empty())
+        return;
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_DATA_BINDING,
+                     m_drawDataBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+    for (const auto& bucket : m_buckets) {
+        if (beforeBucket)
+            beforeBucket(bucket);
+        glBindVertexArray(bucket.vao);
+        size_t offset =
+            bucket.firstCommand * sizeof(DrawElementsIndirectCommand);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, bucket.indexType,
+                                    (const void*)offset, bucket.commandCount,
+                                    0);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    logPossibleGLError();
+#else
+    NOT_IMPLEMENTED_RUNTIME();
+#endif
+}
+
+}  // namespace loo
@@ -27,25 +27,34 @@ static inline glm::vec4 aiColor4D2Glm(const aiColor4D& aColor) {
     return {aColor.r, aColor.g, aColor.b, aColor.a};
 }
 
-static shared_ptr<Texture2D> createMaterialTextures(
+static MaterialTextureDesc readMaterialTexture(
     const aiMaterial* mat, aiTextureType type, fs::path objParent,
     unsigned int options = TEXTURE_OPTION_MIPMAP |
                            TEXTURE_OPTION_CONVERT_TO_LINEAR) {
-    vector<Texture2D> textures;
+    MaterialTextureDesc desc;
     if (mat->GetTextureCount(type)) {
         // TODO: support multilayer texture
         aiString str;
-        aiTextureMapMode mapMode;
+        aiTextureMapMode mapMode = aiTextureMapMode_Wrap;
         mat->GetTexture(type, 0, &str, nullptr, nullptr, nullptr, nullptr,
                         &mapMode);
-        auto texture = createTexture2DFromFile(
-            uniqueTexture, (objParent / str.C_Str()).string(), options);
-        texture->setWrapFilter(
-            mapMode == aiTextureMapMode_Wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
-        return texture;
-    } else {
-        return nullptr;
+        desc.filename = (objParent / str.C_Str()).string();
+        desc.options = options;
+        desc.wrap =
+            mapMode == aiTextureMapMode_Wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE;
     }
+    return desc;
+}
+
+static shared_ptr<Texture2D> createMaterialTexture(
+    const MaterialTextureDesc& desc) {
+    if (desc.filename.empty())
+        return nullptr;
+    auto texture =
+        createTexture2DFromFile(uniqueTexture, desc.filename, desc.options);
+    if (texture)
+        texture->setWrapFilter(desc.wrap);
+    return texture;
 }
 
 static BlinnPhongWorkFlow createBlinnPhongWorkFlowFromAssimp(
@@ -69,89 +78,127 @@ static BlinnPhongWorkFlow createBlinnPhongWorkFlowFromAssimp(
                               shininess);
 }
 
-static MetallicRoughnessWorkFlow createMetallicRoughnessWorkFlowFromAssimp(
-    const aiMaterial* aMaterial, fs::path objParent) {
+static void readMetallicRoughnessFromAssimp(BaseMaterialDesc& desc,
+                                            const aiMaterial* aMaterial,
+                                            fs::path objParent) {
     aiColor4D color4(0, 0, 0, 0);
     aMaterial->Get(AI_MATKEY_BASE_COLOR, color4);
-    glm::vec4 baseColor = aiColor4D2Glm(color4);
+    desc.baseColor = aiColor4D2Glm(color4);
 
     float metallic, roughness;
     aMaterial->Get(AI_MATKEY_METALLIC_FACTOR, metallic);
     aMaterial->Get(AI_MATKEY_ROUGHNESS_FACTOR, roughness);
+    desc.metallic = metallic;
+    desc.roughness = roughness;
 
     //  baseColor textures are sRGB
-    auto baseColorTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_BASE_COLOR] = readMaterialTexture(
         aMaterial, aiTextureType_BASE_COLOR, objParent,
         TEXTURE_OPTION_MIPMAP | TEXTURE_OPTION_CONVERT_TO_LINEAR);
-    auto occlusionTex =
-        createMaterialTextures(aMaterial, aiTextureType_AMBIENT_OCCLUSION,
-                               objParent, TEXTURE_OPTION_MIPMAP);
-    auto metallicTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_OCCLUSION] =
+        readMaterialTexture(aMaterial, aiTextureType_AMBIENT_OCCLUSION,
+                            objParent, TEXTURE_OPTION_MIPMAP);
+    desc.textures[BASE_MATERIAL_TEX_METALLIC] = readMaterialTexture(
         aMaterial, aiTextureType_METALNESS, objParent, TEXTURE_OPTION_MIPMAP);
-    auto roughnessTex =
-        createMaterialTextures(aMaterial, aiTextureType_DIFFUSE_ROUGHNESS,
-                               objParent, TEXTURE_OPTION_MIPMAP);
-
-    auto workflow = MetallicRoughnessWorkFlow(baseColor, metallic, roughness);
-    workflow.baseColorTex = baseColorTex;
-    workflow.occlusionTex = occlusionTex;
-    workflow.metallicTex = metallicTex;
-    workflow.roughnessTex = roughnessTex;
-    return workflow;
+    desc.textures[BASE_MATERIAL_TEX_ROUGHNESS] =
+        readMaterialTexture(aMaterial, aiTextureType_DIFFUSE_ROUGHNESS,
+                            objParent, TEXTURE_OPTION_MIPMAP);
 }
 
-static void readGLTFMaterial(BaseMaterial& baseMaterial,
+static void readGLTFMaterial(BaseMaterialDesc& desc,
                              const aiMaterial* aMaterial) {
     aiString alphaMode;
     aMaterial->Get(AI_MATKEY_GLTF_ALPHAMODE, alphaMode);
-    baseMaterial.flags |=
+    desc.flags |=
         !strcmp(alphaMode.C_Str(), "BLEND") ? LOO_MATERIAL_FLAG_ALPHA_BLEND : 0;
 }
 
-std::shared_ptr<BaseMaterial> createBaseMaterialFromAssimp(
-    const aiMaterial* aMaterial, fs::path objParent) {
-    auto blinnPhong = createBlinnPhongWorkFlowFromAssimp(aMaterial, objParent);
-    auto metallicRoughness =
-        createMetallicRoughnessWorkFlowFromAssimp(aMaterial, objParent);
-    auto material = make_shared<BaseMaterial>(blinnPhong, metallicRoughness);
+BaseMaterialDesc createBaseMaterialDescFromAssimp(const aiMaterial* aMaterial,
+                                                  fs::path objParent) {
+    BaseMaterialDesc desc;
+    desc.bpWorkFlow = createBlinnPhongWorkFlowFromAssimp(aMaterial, objParent);
+    readMetallicRoughnessFromAssimp(desc, aMaterial, objParent);
 
     // read common textures
-    material->ambientTex =
-        createMaterialTextures(aMaterial, aiTextureType_AMBIENT, objParent);
+    desc.textures[BASE_MATERIAL_TEX_AMBIENT] =
+        readMaterialTexture(aMaterial, aiTextureType_AMBIENT, objParent);
 
-    material->diffuseTex =
-        createMaterialTextures(aMaterial, aiTextureType_DIFFUSE, objParent);
+    desc.textures[BASE_MATERIAL_TEX_DIFFUSE] =
+        readMaterialTexture(aMaterial, aiTextureType_DIFFUSE, objParent);
 
-    material->specularTex =
-        createMaterialTextures(aMaterial, aiTextureType_SPECULAR, objParent);
+    desc.textures[BASE_MATERIAL_TEX_SPECULAR] =
+        readMaterialTexture(aMaterial, aiTextureType_SPECULAR, objParent);
 
-    material->displacementTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_DISPLACEMENT] = readMaterialTexture(
         aMaterial, aiTextureType_DISPLACEMENT, objParent, 0x0);
-    // material->displacementTex->setSizeFilter(GL_NEAREST, GL_NEAREST);
     // obj file saves normal map as bump maps
     // FUCK YOU, wavefront obj
-    material->normalTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_NORMAL] = readMaterialTexture(
         aMaterial, aiTextureType_NORMALS, objParent, TEXTURE_OPTION_MIPMAP);
-    material->opacityTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_OPACITY] = readMaterialTexture(
         aMaterial, aiTextureType_OPACITY, objParent, TEXTURE_OPTION_MIPMAP);
-    material->heightTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_HEIGHT] = readMaterialTexture(
         aMaterial, aiTextureType_HEIGHT, objParent, TEXTURE_OPTION_MIPMAP);
-    material->emissiveTex = createMaterialTextures(
+    desc.textures[BASE_MATERIAL_TEX_EMISSIVE] = readMaterialTexture(
         aMaterial, aiTextureType_EMISSIVE, objParent,
         TEXTURE_OPTION_MIPMAP | TEXTURE_OPTION_CONVERT_TO_LINEAR);
 
-    readGLTFMaterial(*material, aMaterial);
+    readGLTFMaterial(desc, aMaterial);
 
     int doubleSided = 0;
     aMaterial->Get(AI_MATKEY_TWOSIDED, doubleSided);
-    material->flags |= doubleSided ? LOO_MATERIAL_FLAG_DOUBLE_SIDED : 0;
+    desc.flags |= doubleSided ? LOO_MATERIAL_FLAG_DOUBLE_SIDED : 0;
 
     aiColor3D color3(0, 0, 0);
     aMaterial->Get(AI_MATKEY_COLOR_EMISSIVE, color3);
     float f(1.0);
     aMaterial->Get(AI_MATKEY_EMISSIVE_INTENSITY, f);
-    material->emissiveFactor = f * aiColor3D2Glm(color3);
+    desc.emissiveFactor = f * aiColor3D2Glm(color3);
 
+    return desc;
+}
+
+std::shared_ptr<BaseMaterial> createBaseMaterialFromDesc(
+    const BaseMaterialDesc& desc) {
+    auto metallicRoughness = MetallicRoughnessWorkFlow(
+        desc.baseColor, desc.metallic, desc.roughness);
+    metallicRoughness.baseColorTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_BASE_COLOR]);
+    metallicRoughness.occlusionTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_OCCLUSION]);
+    metallicRoughness.metallicTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_METALLIC]);
+    metallicRoughness.roughnessTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_ROUGHNESS]);
+    auto material =
+        make_shared<BaseMaterial>(desc.bpWorkFlow, metallicRoughness);
+
+    material->ambientTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_AMBIENT]);
+    material->diffuseTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_DIFFUSE]);
+    material->specularTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_SPECULAR]);
+    material->displacementTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_DISPLACEMENT]);
+    material->normalTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_NORMAL]);
+    material->opacityTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_OPACITY]);
+    material->heightTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_HEIGHT]);
+    material->emissiveTex =
+        createMaterialTexture(desc.textures[BASE_MATERIAL_TEX_EMISSIVE]);
+
+    material->flags = desc.flags;
+    material->emissiveFactor = desc.emissiveFactor;
+    material->desc = make_shared<const BaseMaterialDesc>(desc);
     return material;
 }
+
+std::shared_ptr<BaseMaterial> createBaseMaterialFromAssimp(
+    const aiMaterial* aMaterial, fs::path objParent) {
+    return createBaseMaterialFromDesc(
+        createBaseMaterialDescFromAssimp(aMaterial, objParent));
+}
 }  // namespace loo
\ No newline at end of file
@@ -4,12 +4,18 @@
 #include <glog/logging.h>
 
 #include <assimp/Importer.hpp>
+#include <chrono>
 #include <filesystem>
+#include <limits>
 #include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
 #include "loo/Animation.hpp"
+#include "loo/GeometryArena.hpp"
+#include "loo/MeshOptimizer.hpp"
+#include "loo/MeshWeld.hpp"
+#include "loo/ThreadPool.hpp"
 
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/ext.hpp>
@@ -33,7 +39,92 @@ void Vertex::orthogonalizeTangent() {
     bitangent = B;
 }
 
-void Mesh::prepare() {
+void Mesh::prepare(GeometryArena* arena) {
+    if (m_residency != MeshResidency::Keep && !restoreCpuData()) {
+        LOG(ERROR) << "mesh " << name
+                   << " can't be prepared, its CPU data was released";
+        return;
+    }
+    PackedVertexStream packed;
+    if (vertexFormat == VertexFormat::Packed &&
+        !packVertices(vertices, packed)) {
+        LOG(WARNING) << "mesh " << name
+                     << " can't be packed, fallback to full vertex format";
+        vertexFormat = VertexFormat::Full;
+    }
+    GeometryLayout layout;
+    layout.format = vertexFormat;
+    const void* vertexData = vertices.data();
+    size_t vertexSize = vertices.size() * sizeof(Vertex);
+    if (vertexFormat == VertexFormat::Packed) {
+        layout.skinned = packed.skinned;
+        layout.texCoordType = packed.texCoordType;
+        vertexData = packed.data.data();
+        vertexSize = packed.data.size();
+        m_positionDecodeOffset = packed.positionOffset;
+        m_positionDecodeScale = packed.positionScale;
+    } else {
+        m_positionDecodeOffset = glm::vec3(0.0f);
+        m_positionDecodeScale = glm::vec3(1.0f);
+    }
+
+    // every level of detail lives in the same element buffer
+    m_lodIndexOffsets.assign(1, 0);
+    size_t indexCount = indices.size();
+    for (const auto& lod : lods) {
+        m_lodIndexOffsets.push_back(indexCount);
+        indexCount += lod.indices.size();
+    }
+    m_preparedVertexCount = vertices.size();
+    m_preparedIndexCount = indexCount;
+    // the CPU side stays 32 bits for processing, only the GPU copy shrinks
+    vector<uint16_t> compactIndices;
+    vector<unsigned int> fullIndices;
+    const void* indexData;
+    if (vertices.size() <= 65536) {
+        m_indexType = GL_UNSIGNED_SHORT;
+        compactIndices.reserve(indexCount);
+        compactIndices.assign(indices.begin(), indices.end());
+        for (const auto& lod : lods)
+            compactIndices.insert(compactIndices.end(), lod.indices.begin(),
+                                  lod.indices.end());
+        indexData = compactIndices.data();
+    } else {
+        m_indexType = GL_UNSIGNED_INT;
+        if (lods.empty()) {
+            indexData = indices.data();
+        } else {
+            fullIndices.reserve(indexCount);
+            fullIndices.assign(indices.begin(), indices.end());
+            for (const auto& lod : lods)
+                fullIndices.insert(fullIndices.end(), lod.indices.begin(),
+                                   lod.indices.end());
+            indexData = fullIndices.data();
+        }
+    }
+    size_t indexSize = indexCount * getIndexSize();
+
+    // a previous arena range goes back to its arena, buffers of our own are
+    // deleted
+    m_geometryRange.reset();
+    if (vbo) {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        vao = vbo = ebo = 0;
+    }
+    if (arena) {
+        m_geometryRange = arena->allocate(layout, vertexData, vertices.size(),
+                                          indexData, indexSize);
+        vao = arena->getVertexArray(m_geometryRange->layoutIndex);
+        vbo = ebo = 0;
+        m_baseVertex = m_geometryRange->baseVertex;
+        m_indexByteOffset = m_geometryRange->indexOffset;
+        return;
+    }
+    m_baseVertex = 0;
+    m_indexByteOffset = 0;
+
     glGenVertexArrays(1, &vao);
     glGenBuffers(1, &vbo);
     glGenBuffers(1, &ebo);
@@ -41,60 +132,189 @@ void Mesh::prepare() {
     glBindVertexArray(vao);
 
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
-                 vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertexSize, vertexData, GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
-                 indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, indexData,
+                 GL_STATIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(0);
+    if (vertexFormat == VertexFormat::Packed)
+        setupPackedVertexAttributes(packed);
+    else
+        setupFullVertexAttributes();
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)(offsetof(Vertex, normal)));
-    glEnableVertexAttribArray(1);
+    glBindVertexArray(0);
+}
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, texCoord));
-    glEnableVertexAttribArray(2);
+glm::mat4 Mesh::getPositionDecodeMatrix() const {
+    return glm::scale(glm::translate(glm::identity<glm::mat4>(),
+                                     m_positionDecodeOffset),
+                      m_positionDecodeScale);
+}
 
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)(offsetof(Vertex, tangent)));
-    glEnableVertexAttribArray(3);
+size_t Mesh::getIndexSize() const {
+    return m_indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t)
+                                            : sizeof(unsigned int);
+}
+
+size_t Mesh::countVertex() const {
+    return m_residency == MeshResidency::Keep ? vertices.size()
+                                              : m_preparedVertexCount;
+}
+size_t Mesh::countTriangles(size_t lod) const {
+    if (m_residency == MeshResidency::Drop) {
+        // the level ends where the next one starts in ebo
+        lod = std::min(lod, m_lodIndexOffsets.size() - 1);
+        size_t end = lod + 1 < m_lodIndexOffsets.size()
+                         ? m_lodIndexOffsets[lod + 1]
+                         : m_preparedIndexCount;
+        return (end - m_lodIndexOffsets[lod]) / 3;
+    }
+    if (lod == 0 || lods.empty())
+        return indices.size() / 3;
+    return lods[std::min(lod, lods.size()) - 1].indices.size() / 3;
+}
+
+template <typename T>
+static size_t releaseVector(vector<T>& v) {
+    size_t bytes = v.capacity() * sizeof(T);
+    vector<T>().swap(v);
+    return bytes;
+}
+
+size_t Mesh::releaseCpuData(MeshResidency residency) {
+    // released data only comes back through restoreCpuData()
+    if (residency <= m_residency)
+        return 0;
+    if (m_lodIndexOffsets.empty()) {
+        LOG(WARNING) << "mesh " << name
+                     << " isn't prepared, its CPU data is kept";
+        return 0;
+    }
+    size_t bytes = 0;
+    if (m_residency == MeshResidency::Keep) {
+        if (residency == MeshResidency::PositionsOnly) {
+            positions.resize(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++)
+                positions[i] = vertices[i].position;
+        }
+        bytes += releaseVector(vertices) - positions.capacity() * sizeof(vec3);
+    }
+    if (residency == MeshResidency::Drop) {
+        bytes += releaseVector(positions) + releaseVector(indices);
+        bytes += releaseVector(meshlets) + releaseVector(meshletBounds);
+        bytes += releaseVector(meshletVertices);
+        bytes += releaseVector(meshletTriangles);
+        // the errors stay for selectMeshLod
+        for (auto& lod : lods)
+            bytes += releaseVector(lod.indices);
+    }
+    m_residency = residency;
+    return bytes;
+}
 
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, bitangent));
-    glEnableVertexAttribArray(4);
+bool Mesh::restoreCpuData() {
+    if (m_residency == MeshResidency::Keep)
+        return true;
+    if (!m_dataSource)
+        return false;
+    auto loaded = m_dataSource->fetch({sourceIndex});
+    if (loaded.empty())
+        return false;
+    restoreCpuData(*loaded.front());
+    return true;
+}
 
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex),
-                           (GLvoid*)offsetof(Vertex, boneIds));
-    glEnableVertexAttribArray(5);
+void Mesh::restoreCpuData(Mesh& loaded) {
+    if (loaded.vertices.size() != m_preparedVertexCount) {
+        LOG(WARNING) << "mesh " << name
+                     << " changed at its source, prepare it again";
+    }
+    vertices = std::move(loaded.vertices);
+    indices = std::move(loaded.indices);
+    meshlets = std::move(loaded.meshlets);
+    meshletBounds = std::move(loaded.meshletBounds);
+    meshletVertices = std::move(loaded.meshletVertices);
+    meshletTriangles = std::move(loaded.meshletTriangles);
+    lods = std::move(loaded.lods);
+    vector<vec3>().swap(positions);
+    m_residency = MeshResidency::Keep;
+}
 
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                          (GLvoid*)offsetof(Vertex, boneWeights));
-    glEnableVertexAttribArray(6);
+void Mesh::draw(size_t lod) const {
+    glBindVertexArray(vao);
+    drawElements(lod);
+    glBindVertexArray(0);
+}
 
+void Mesh::drawInstanced(size_t instanceCount, GLuint baseInstance,
+                         size_t lod) const {
+    size_t offset = getFirstIndex(lod) * getIndexSize();
+    glBindVertexArray(vao);
+    glDrawElementsInstancedBaseVertexBaseInstance(
+        GL_TRIANGLES, countTriangles(lod) * 3, m_indexType, (GLvoid*)offset,
+        instanceCount, m_baseVertex, baseInstance);
     glBindVertexArray(0);
 }
 
-size_t Mesh::countVertex() const {
-    return vertices.size();
+AABB Mesh::computeInstancesAABB(const mat4& modelMatrix) const {
+    AABB result;
+    for (size_t i = 0; i < countInstances(); i++) {
+        result.merge(aabb.transform(modelMatrix * getInstanceMatrix(i)));
+    }
+    return result;
+}
+
+size_t Mesh::getFirstIndex(size_t lod) const {
+    lod = std::min(lod, m_lodIndexOffsets.size() - 1);
+    // arena ranges are 4 bytes aligned, a whole number of indices
+    return m_indexByteOffset / getIndexSize() + m_lodIndexOffsets[lod];
 }
-size_t Mesh::countTriangles() const {
-    return indices.size() / 3;
+
+void Mesh::drawElements(size_t lod) const {
+    size_t offset = getFirstIndex(lod) * getIndexSize();
+    glDrawElementsBaseVertex(GL_TRIANGLES, countTriangles(lod) * 3,
+                             m_indexType, (GLvoid*)offset, m_baseVertex);
 }
 
 using namespace Assimp;
 
-static void extractAssimpMeshBones(const aiMesh* mesh,
-                                   std::vector<Vertex>& vertices,
-                                   std::map<std::string, int>& boneIndexMap,
-                                   std::vector<glm::mat4>& boneOffsetMatrices) {
+static AABB convertAABBAssimpToLoo(const aiAABB& aabb) {
+    return AABB(convertVec3AssimpToGLM(aabb.mMin),
+                convertVec3AssimpToGLM(aabb.mMax));
+}
+
+// Fill per vertex bone weights with indices local to the mesh (the position
+// in mesh->mBones), they are remapped to scene wide indices once all meshes
+// are converted so that conversion doesn't touch shared state.
+static void extractAssimpMeshBoneWeights(const aiMesh* mesh,
+                                         std::vector<Vertex>& vertices) {
+    for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+        auto weights = mesh->mBones[i]->mWeights;
+        for (unsigned int j = 0; j < mesh->mBones[i]->mNumWeights; j++) {
+            int vertexID = weights[j].mVertexId;
+            Vertex& vertex = vertices[vertexID];
+            float weight = weights[j].mWeight;
+            for (int k = 0; k < BONES_MAX_INFLUENCE; k++) {
+                if (vertex.boneIds[k] < 0) {
+                    vertex.boneIds[k] = i;
+                    vertex.boneWeights[k] = weight;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Allocate scene wide indices for the bones of a mesh, returns the mapping
+// from local bone index to scene bone index
+static std::vector<int> allocateAssimpMeshBones(
+    const aiMesh* mesh, std::map<std::string, int>& boneIndexMap,
+    std::vector<glm::mat4>& boneOffsetMatrices) {
     if (mesh->mNumBones > 0) {
         LOG(INFO) << "mesh has bones: " << mesh->mNumBones;
     }
+    std::vector<int> boneIndices(mesh->mNumBones);
     for (unsigned int i = 0; i < mesh->mNumBones; i++) {
         int boneIndex;
         string boneName(mesh->mBones[i]->mName.C_Str());
@@ -111,32 +331,33 @@ static void extractAssimpMeshBones(const aiMesh* mesh,
         } else {
             boneIndex = boneIndexMap[boneName];
         }
-        auto weights = mesh->mBones[i]->mWeights;
-        for (unsigned int j = 0; j < mesh->mBones[i]->mNumWeights; j++) {
-            int vertexID = weights[j].mVertexId;
-            Vertex& vertex = vertices[vertexID];
-            float weight = weights[j].mWeight;
-            for (int k = 0; k < BONES_MAX_INFLUENCE; k++) {
-                if (vertex.boneIds[k] < 0) {
-                    vertex.boneIds[k] = boneIndex;
-                    vertex.boneWeights[k] = weight;
-                    break;
-                }
-            }
+        boneIndices[i] = boneIndex;
+    }
+    return boneIndices;
+}
+
+static void remapMeshBones(Mesh& mesh, const std::vector<int>& boneIndices) {
+    if (boneIndices.empty())
+        return;
+    for (auto& vertex : mesh.vertices) {
+        for (int k = 0; k < BONES_MAX_INFLUENCE; k++) {
+            if (vertex.boneIds[k] >= 0)
+                vertex.boneIds[k] = boneIndices[vertex.boneIds[k]];
         }
     }
 }
+
 // https://learnopengl-cn.github.io/03%20Model%20Loading/03%20Model/
+// converts one mesh, safe to run concurrently: it only reads the assimp scene
+// and the material table
 static std::shared_ptr<Mesh> processAssimpMesh(
-    aiMesh* mesh, const aiScene* scene,
-    std::map<std::string, int>& boneIndexMap,
-    std::vector<glm::mat4>& boneOffsetMatrices, fs::path objParent,
-    const glm::mat4& parentTransform) {
+    const aiMesh* mesh,
+    const std::vector<std::shared_ptr<BaseMaterial>>& materials,
+    const glm::mat4& parentTransform, const MeshImportOptions& options,
+    MeshImportStats& meshStats) {
     // data to fill
     vector<Vertex> vertices;
     vector<unsigned int> indices;
-    vector<Texture2D> textures;
-    unordered_map<Vertex, unsigned int> uniqueVertices;
 
     // walk through each of the mesh's vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
@@ -197,46 +418,212 @@ static std::shared_ptr<Mesh> processAssimpMesh(
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
     }
-    // process materials
-    aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-    // we assume a convention for sampler names in the shaders. Each diffuse
-    // texture should be named as 'texture_diffuseN' where N is a sequential
-    // number ranging from 1 to MAX_SAMPLER_NUMBER. Same applies to other
-    // texture as the following list summarizes: diffuse: texture_diffuseN
-    // specular: texture_specularN
-    // normal: texture_normalN
-    auto mat = createBaseMaterialFromAssimp(material, objParent);
-    auto assimpAABB = mesh->mAABB;
-    AABB aabb(
-        glm::vec3(assimpAABB.mMin.x, assimpAABB.mMin.y, assimpAABB.mMin.z),
-        glm::vec3(assimpAABB.mMax.x, assimpAABB.mMax.y, assimpAABB.mMax.z));
-    extractAssimpMeshBones(mesh, vertices, boneIndexMap, boneOffsetMatrices);
+    // materials are shared by every mesh referencing them, they are set
+    // later when converting off the GL thread
+    shared_ptr<BaseMaterial> mat;
+    if (mesh->mMaterialIndex < materials.size())
+        mat = materials[mesh->mMaterialIndex];
+    AABB aabb = convertAABBAssimpToLoo(mesh->mAABB);
+    extractAssimpMeshBoneWeights(mesh, vertices);
+    // welding after the bone weights are known, vertices only differing by
+    // their weights must stay apart
+    meshStats.weldedVertexCount =
+        options.weldVertices
+            ? weldVertices(vertices, indices, options.weldEpsilon)
+            : 0;
     // return a mesh object created from the extracted mesh data
-    return make_shared<Mesh>(std::move(vertices), std::move(indices), mat,
-                             mesh->mName.C_Str(), parentTransform, aabb);
+    auto result =
+        make_shared<Mesh>(std::move(vertices), std::move(indices), mat,
+                          mesh->mName.C_Str(), parentTransform, aabb);
+    // levels are simplified from the welded indices, meshlets only cover the
+    // full level
+    if (options.generateLods)
+        generateMeshLods(*result, options.lodOptions);
+    if (options.optimize) {
+        auto optimizeStats = optimizeMesh(*result, options.optimizeOptions);
+        meshStats.cacheBefore = optimizeStats.before;
+        meshStats.cacheAfter = optimizeStats.after;
+    }
+    if (options.buildMeshlets)
+        buildMeshlets(*result);
+    return result;
 }
 
-static void processAssimpNode(aiNode* node, const aiScene* scene,
-                              vector<shared_ptr<Mesh>>& meshes,
-                              std::map<std::string, int>& boneIndexMap,
-                              std::vector<glm::mat4>& boneOffsetMatrices,
-                              fs::path objParent,
-                              const glm::mat4& parentTransform) {
-    auto nodeTransform = convertMat4AssimpToGLM(node->mTransformation);
-    nodeTransform = parentTransform * nodeTransform;
-    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+struct AssimpMeshTask {
+    const aiMesh* mesh;
+    glm::mat4 transform;
+    uint32_t node;
+};
 
-        meshes.push_back(processAssimpMesh(mesh, scene, boneIndexMap,
-                                           boneOffsetMatrices, objParent,
-                                           nodeTransform));
+// flatten the node tree into (mesh, transform) work items, in the same order
+// the meshes used to be converted; the nodes go to graph if not null, the
+// traversal is depth first just like the graph wants them
+static void collectAssimpNode(const aiNode* node, const aiScene* scene,
+                              vector<AssimpMeshTask>& tasks,
+                              const glm::mat4& parentTransform,
+                              SceneGraph* graph, uint32_t parentNode) {
+    auto localTransform = convertMat4AssimpToGLM(node->mTransformation);
+    auto nodeTransform = parentTransform * localTransform;
+    uint32_t graphNode = SCENE_GRAPH_NO_NODE;
+    if (graph)
+        graphNode = graph->addNode(parentNode, localTransform,
+                                   node->mName.C_Str());
+    for (unsigned int i = 0; i < node->mNumMeshes; i++) {
+        tasks.push_back(
+            {scene->mMeshes[node->mMeshes[i]], nodeTransform, graphNode});
     }
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processAssimpNode(node->mChildren[i], scene, meshes, boneIndexMap,
-                          boneOffsetMatrices, objParent, nodeTransform);
+        collectAssimpNode(node->mChildren[i], scene, tasks, nodeTransform,
+                          graph, graphNode);
     }
 }
 
+static vector<shared_ptr<Mesh>> processAssimpScene(
+    const aiScene* scene,
+    const std::vector<std::shared_ptr<BaseMaterial>>& materials,
+    std::map<std::string, int>& boneIndexMap,
+    std::vector<glm::mat4>& boneOffsetMatrices,
+    const MeshImportOptions& options, MeshImportStats* stats,
+    const AssimpMeshCallback& onMesh, SceneGraph* graph) {
+    auto start = chrono::steady_clock::now();
+    ThreadPool& pool = options.pool ? *options.pool : ThreadPool::global();
+    vector<AssimpMeshTask> tasks;
+    if (graph)
+        graph->clear();
+    collectAssimpNode(scene->mRootNode, scene, tasks,
+                      glm::identity<glm::mat4>(), graph, SCENE_GRAPH_NO_NODE);
+    if (graph) {
+        // the world matrices are the baked mesh transforms
+        graph->update();
+        for (const auto& task : tasks) {
+            graph->mergeLocalAABB(task.node,
+                                  convertAABBAssimpToLoo(task.mesh->mAABB));
+        }
+    }
+    // only the first reference to an assimp mesh is converted, the others
+    // become its instances
+    vector<vector<AssimpMeshTask>> extraInstances(tasks.size());
+    if (options.instanceMeshes) {
+        unordered_map<const aiMesh*, size_t> converted;
+        vector<AssimpMeshTask> uniqueTasks;
+        for (const auto& task : tasks) {
+            auto [iter, inserted] =
+                converted.emplace(task.mesh, uniqueTasks.size());
+            if (inserted)
+                uniqueTasks.push_back(task);
+            else
+                extraInstances[iter->second].push_back(task);
+        }
+        tasks = std::move(uniqueTasks);
+        extraInstances.resize(tasks.size());
+    }
+
+    // bone indices are handed out in traversal order, exactly like a serial
+    // import would do, so the result doesn't depend on the thread count
+    vector<vector<int>> meshBoneIndices(tasks.size());
+    for (size_t i = 0; i < tasks.size(); i++) {
+        meshBoneIndices[i] = allocateAssimpMeshBones(
+            tasks[i].mesh, boneIndexMap, boneOffsetMatrices);
+    }
+
+    vector<shared_ptr<Mesh>> meshes(tasks.size());
+    vector<MeshImportStats> meshStats(tasks.size());
+    pool.parallelFor(tasks.size(), [&](size_t i) {
+        meshes[i] =
+            processAssimpMesh(tasks[i].mesh, materials, tasks[i].transform,
+                              options, meshStats[i]);
+        remapMeshBones(*meshes[i], meshBoneIndices[i]);
+        meshes[i]->sourceIndex = i;
+        meshes[i]->node = tasks[i].node;
+        for (const auto& instance : extraInstances[i]) {
+            meshes[i]->instances.push_back(
+                {instance.transform, instance.transform, instance.node});
+        }
+        if (onMesh)
+            onMesh(meshes[i], tasks[i].mesh->mMaterialIndex);
+    });
+
+    MeshImportStats importStats;
+    importStats.meshCount = meshes.size();
+    for (size_t i = 0; i < meshes.size(); i++) {
+        importStats.instanceCount += meshes[i]->countInstances();
+        importStats.vertexCount += meshes[i]->countVertex();
+        importStats.triangleCount += meshes[i]->countTriangles();
+        importStats.weldedVertexCount += meshStats[i].weldedVertexCount;
+        importStats.cacheBefore.transformedVertexCount +=
+            meshStats[i].cacheBefore.transformedVertexCount;
+        importStats.cacheAfter.transformedVertexCount +=
+            meshStats[i].cacheAfter.transformedVertexCount;
+        importStats.meshletCount += meshes[i]->meshlets.size();
+        for (const auto& lod : meshes[i]->lods)
+            importStats.lodTriangleCount += lod.indices.size() / 3;
+    }
+    for (auto* cache : {&importStats.cacheBefore, &importStats.cacheAfter}) {
+        size_t transformed = cache->transformedVertexCount;
+        cache->acmr = importStats.triangleCount
+                          ? float(transformed) / importStats.triangleCount
+                          : 0.0f;
+        cache->atvr = importStats.vertexCount
+                          ? float(transformed) / importStats.vertexCount
+                          : 0.0f;
+    }
+    importStats.milliseconds =
+        chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+            .count();
+    LOG(INFO) << "converted " << importStats.meshCount << " meshes in "
+              << importStats.milliseconds << "ms with "
+              << pool.getConcurrency() << " threads";
+    if (options.instanceMeshes) {
+        LOG(INFO) << importStats.meshCount << " meshes shared by "
+                  << importStats.instanceCount << " instances, "
+                  << importStats.instanceCount - importStats.meshCount
+                  << " copies saved";
+    }
+    if (options.weldVertices) {
+        LOG(INFO) << "welding removed " << importStats.weldedVertexCount
+                  << " vertices, " << importStats.vertexCount << " left";
+    }
+    if (options.buildMeshlets) {
+        LOG(INFO) << "built " << importStats.meshletCount << " meshlets";
+    }
+    if (options.generateLods) {
+        LOG(INFO) << "generated " << importStats.lodTriangleCount
+                  << " level of detail triangles";
+    }
+    if (options.optimize) {
+        LOG(INFO) << "vertex cache ACMR " << importStats.cacheBefore.acmr
+                  << " -> " << importStats.cacheAfter.acmr << ", ATVR "
+                  << importStats.cacheBefore.atvr << " -> "
+                  << importStats.cacheAfter.atvr;
+    }
+    if (stats)
+        *stats = importStats;
+    return meshes;
+}
+
+static std::vector<std::shared_ptr<BaseMaterial>> createMaterialsFromAssimp(
+    const aiScene* scene, const fs::path& objParent) {
+    std::vector<std::shared_ptr<BaseMaterial>> materials;
+    materials.reserve(scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++) {
+        materials.push_back(
+            createBaseMaterialFromAssimp(scene->mMaterials[i], objParent));
+    }
+    return materials;
+}
+
+unsigned int getAssimpImportFlags(const MeshImportOptions& options) {
+    unsigned int flags = ASSIMP_IMPORT_FLAGS;
+    // the native optimizer supersedes assimp's
+    if (options.optimize)
+        flags &= ~aiProcess_ImproveCacheLocality;
+    // both bake node transforms into merged meshes, leaving hardly any mesh
+    // referenced by more than one node to instance
+    if (options.instanceMeshes)
+        flags &= ~(aiProcess_OptimizeGraph | aiProcess_OptimizeMeshes);
+    return flags;
+}
+
 vector<shared_ptr<Mesh>> createMeshesFromFile(
     std::map<std::string, int>& boneIndexMap,
     std::vector<glm::mat4>& boneOffsetMatrices, Animator* animator,
@@ -245,22 +632,16 @@ vector<shared_ptr<Mesh>> createMeshesFromFile(
     vector<shared_ptr<Mesh>> meshes;
     fs::path filePath(filename);
     fs::path fileParent = filePath.parent_path();
-    const auto scene = importer.ReadFile(
-        filename,
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals |
-            aiProcess_GenNormals | aiProcess_CalcTangentSpace |
-            aiProcess_GenBoundingBoxes | aiProcess_LimitBoneWeights |
-            aiProcess_ImproveCacheLocality | aiProcess_OptimizeMeshes |
-            aiProcess_OptimizeGraph | aiProcess_SplitLargeMeshes |
-            aiProcess_RemoveRedundantMaterials);
+    const auto scene = importer.ReadFile(filename, ASSIMP_IMPORT_FLAGS);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !scene->mRootNode) {
         LOG(ERROR) << "Assimp: " << importer.GetErrorString() << endl;
         return {};
     }
-    processAssimpNode(scene->mRootNode, scene, meshes, boneIndexMap,
-                      boneOffsetMatrices, fileParent,
-                      glm::identity<glm::mat4>());
+    auto materials = createMaterialsFromAssimp(scene, fileParent);
+    meshes = processAssimpScene(scene, materials, boneIndexMap,
+                                boneOffsetMatrices, {}, nullptr, nullptr,
+                                nullptr);
     if (animator != nullptr && scene->HasAnimations()) {
         animator->resetAnimation(createAnimationFromAssimp(*scene, boneIndexMap,
                                                            boneOffsetMatrices));
@@ -270,11 +651,59 @@ vector<shared_ptr<Mesh>> createMeshesFromFile(
 }
 std::vector<std::shared_ptr<Mesh>> createMeshesFromAssimp(
     const aiScene* scene, std::map<std::string, int>& boneIndexMap,
-    std::vector<glm::mat4>& boneOffsetMatrices, const std::string& basePath) {
-    vector<shared_ptr<Mesh>> meshes;
-    processAssimpNode(scene->mRootNode, scene, meshes, boneIndexMap,
-                      boneOffsetMatrices, basePath, glm::identity<glm::mat4>());
-    return std::move(meshes);
+    std::vector<glm::mat4>& boneOffsetMatrices, const std::string& basePath,
+    const MeshImportOptions& options, MeshImportStats* stats,
+    SceneGraph* graph) {
+    // materials load textures through OpenGL, keep them on this thread
+    auto materials = createMaterialsFromAssimp(scene, basePath);
+    return processAssimpScene(scene, materials, boneIndexMap,
+                              boneOffsetMatrices, options, stats, nullptr,
+                              graph);
+}
+
+std::vector<std::shared_ptr<Mesh>> convertMeshesFromAssimp(
+    const aiScene* scene, std::map<std::string, int>& boneIndexMap,
+    std::vector<glm::mat4>& boneOffsetMatrices,
+    const MeshImportOptions& options, const AssimpMeshCallback& onMesh,
+    MeshImportStats* stats, SceneGraph* graph) {
+    return processAssimpScene(scene, {}, boneIndexMap, boneOffsetMatrices,
+                              options, stats, onMesh, graph);
+}
+
+double measureMeshImport(const std::string& filename, size_t maxThreadCount,
+                         MeshImportOptions options, size_t iterationCount) {
+    Importer importer;
+    const auto scene =
+        importer.ReadFile(filename, getAssimpImportFlags(options));
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !scene->mRootNode) {
+        LOG(ERROR) << "Assimp: " << importer.GetErrorString();
+        return 0.0;
+    }
+    if (maxThreadCount == 0)
+        maxThreadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    double serialMs = 0.0, speedup = 0.0;
+    for (size_t threadCount = 1; threadCount <= maxThreadCount; threadCount++) {
+        ThreadPool pool(threadCount - 1);
+        options.pool = &pool;
+        // the fastest run, the first ones also warm up the allocator
+        double ms = numeric_limits<double>::max();
+        for (size_t iteration = 0; iteration < iterationCount; iteration++) {
+            map<string, int> boneMap;
+            vector<glm::mat4> boneMatrices;
+            MeshImportStats stats;
+            convertMeshesFromAssimp(scene, boneMap, boneMatrices, options,
+                                    nullptr, &stats);
+            ms = std::min(ms, stats.milliseconds);
+        }
+        if (threadCount == 1)
+            serialMs = ms;
+        speedup = ms > 0.0 ? serialMs / ms : 0.0;
+        LOG(INFO) << "import of " << filename << ", " << threadCount
+                  << " threads: " << ms << "ms, " << speedup
+                  << "x the serial conversion";
+    }
+    return speedup;
 }
 
 bool Vertex::operator==(const Vertex& v) const {
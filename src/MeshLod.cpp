@@ -0,0 +1,362 @@
+#include "loo/MeshLod.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+#include "loo/Camera.hpp"
+#include "loo/Mesh.hpp"
+#include "loo/MeshWeld.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+// symmetric 4x4 matrix of the plane equations, area weighted
+struct Quadric {
+    double xx{0}, xy{0}, xz{0}, xw{0}, yy{0}, yz{0}, yw{0}, zz{0}, zw{0},
+        ww{0};
+    double weight{0};
+
+    void addPlane(const dvec3& n, double d, double w) {
+        xx += w * n.x * n.x;
+        xy += w * n.x * n.y;
+        xz += w * n.x * n.z;
+        xw += w * n.x * d;
+        yy += w * n.y * n.y;
+        yz += w * n.y * n.z;
+        yw += w * n.y * d;
+        zz += w * n.z * n.z;
+        zw += w * n.z * d;
+        ww += w * d * d;
+        weight += w;
+    }
+    Quadric& operator+=(const Quadric& q) {
+        xx += q.xx, xy += q.xy, xz += q.xz, xw += q.xw, yy += q.yy;
+        yz += q.yz, yw += q.yw, zz += q.zz, zw += q.zw, ww += q.ww;
+        weight += q.weight;
+        return *this;
+    }
+    // weighted sum of the squared distances to the planes
+    double evaluate(const vec3& p) const {
+        double x = p.x, y = p.y, z = p.z;
+        return xx * x * x + yy * y * y + zz * z * z +
+               2.0 * (xy * x * y + xz * x * z + yz * y * z) +
+               2.0 * (xw * x + yw * y + zw * z) + ww;
+    }
+};
+
+struct Collapse {
+    unsigned int from, to;
+    // mean squared distance to the planes of both vertices
+    float cost;
+};
+
+static inline uint64_t edgeKey(unsigned int a, unsigned int b) {
+    if (a > b)
+        std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+}
+
+class MeshSimplifier {
+   public:
+    MeshSimplifier(const vector<Vertex>& vertices,
+                   const vector<unsigned int>& indices)
+        : m_indices(indices),
+          m_quadrics(vertices.size()),
+          m_locked(vertices.size(), 0) {
+        m_positions.reserve(vertices.size());
+        for (const auto& v : vertices)
+            m_positions.push_back(v.position);
+        lockSeamsAndBorders();
+        for (size_t t = 0; t < m_indices.size() / 3; t++) {
+            const unsigned int* tri = &m_indices[t * 3];
+            dvec3 p0(m_positions[tri[0]]), p1(m_positions[tri[1]]),
+                p2(m_positions[tri[2]]);
+            dvec3 n = cross(p1 - p0, p2 - p0);
+            double length = glm::length(n);
+            if (!(length > 0.0))
+                continue;
+            n /= length;
+            double area = length * 0.5;
+            for (int k = 0; k < 3; k++)
+                m_quadrics[tri[k]].addPlane(n, -dot(n, p0), area);
+        }
+    }
+
+    // collapse edges until at most targetIndexCount indices are left, the
+    // error bound is reached or nothing can collapse anymore
+    void simplify(size_t targetIndexCount, float maxError) {
+        double maxCost = maxError > 0.0f
+                             ? double(maxError) * maxError
+                             : numeric_limits<double>::infinity();
+        while (m_indices.size() > targetIndexCount) {
+            if (!collapsePass(targetIndexCount, maxCost))
+                break;
+        }
+    }
+    const vector<unsigned int>& getIndices() const { return m_indices; }
+    float getError() const { return std::sqrt(m_maxCost); }
+    size_t countLocked() const {
+        return count(m_locked.begin(), m_locked.end(), uint8_t(1));
+    }
+
+   private:
+    void lockSeamsAndBorders() {
+        // vertices sharing a position lie on an attribute seam, those no
+        // index refers to (merged duplicates) don't count
+        vector<uint8_t> used(m_positions.size(), 0);
+        for (auto index : m_indices)
+            used[index] = 1;
+        vector<unsigned int> order;
+        order.reserve(m_positions.size());
+        for (unsigned int i = 0; i < m_positions.size(); i++) {
+            if (used[i])
+                order.push_back(i);
+        }
+        auto less = [&](unsigned int a, unsigned int b) {
+            const vec3 &pa = m_positions[a], &pb = m_positions[b];
+            if (pa.x != pb.x)
+                return pa.x < pb.x;
+            if (pa.y != pb.y)
+                return pa.y < pb.y;
+            return pa.z < pb.z;
+        };
+        sort(order.begin(), order.end(), less);
+        for (size_t i = 1; i < order.size(); i++) {
+            if (m_positions[order[i]] == m_positions[order[i - 1]])
+                m_locked[order[i]] = m_locked[order[i - 1]] = 1;
+        }
+        // edges used by a single triangle are open borders
+        vector<uint64_t> edges;
+        edges.reserve(m_indices.size());
+        for (size_t t = 0; t < m_indices.size() / 3; t++) {
+            for (int k = 0; k < 3; k++) {
+                edges.push_back(edgeKey(m_indices[t * 3 + k],
+                                        m_indices[t * 3 + (k + 1) % 3]));
+            }
+        }
+        sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i])
+                j++;
+            if (j - i == 1) {
+                m_locked[edges[i] >> 32] = 1;
+                m_locked[edges[i] & 0xffffffffu] = 1;
+            }
+            i = j;
+        }
+    }
+
+    float collapseCost(unsigned int from, unsigned int to) const {
+        Quadric q = m_quadrics[from];
+        q += m_quadrics[to];
+        if (!(q.weight > 0.0))
+            return 0.0f;
+        return float(std::max(q.evaluate(m_positions[to]) / q.weight, 0.0));
+    }
+
+    // moving `from` onto `to` must not flip any remaining triangle
+    bool flips(unsigned int from, unsigned int to) const {
+        for (uint32_t i = m_adjacencyOffsets[from];
+             i < m_adjacencyOffsets[from + 1]; i++) {
+            const unsigned int* tri = &m_indices[m_adjacency[i] * 3];
+            if (tri[0] == to || tri[1] == to || tri[2] == to)
+                continue;
+            vec3 p[3], q[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = m_positions[tri[k]];
+                q[k] = tri[k] == from ? m_positions[to] : p[k];
+            }
+            vec3 n0 = cross(p[1] - p[0], p[2] - p[0]);
+            vec3 n1 = cross(q[1] - q[0], q[2] - q[0]);
+            if (dot(n0, n1) < 0.25f * glm::length(n0) * glm::length(n1))
+                return true;
+        }
+        return false;
+    }
+
+    void buildAdjacency() {
+        size_t triangleCount = m_indices.size() / 3;
+        m_adjacencyOffsets.assign(m_positions.size() + 1, 0);
+        for (auto index : m_indices)
+            m_adjacencyOffsets[index + 1]++;
+        partial_sum(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end(),
+                    m_adjacencyOffsets.begin());
+        m_adjacency.resize(m_indices.size());
+        vector<uint32_t> fill(m_adjacencyOffsets.begin(),
+                              m_adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++)
+                m_adjacency[fill[m_indices[t * 3 + k]]++] = t;
+        }
+    }
+
+    // one round of independent collapses in increasing cost order, returns
+    // false if nothing collapsed
+    bool collapsePass(size_t targetIndexCount, double maxCost) {
+        vector<uint64_t> edges;
+        edges.reserve(m_indices.size());
+        for (size_t t = 0; t < m_indices.size() / 3; t++) {
+            for (int k = 0; k < 3; k++) {
+                edges.push_back(edgeKey(m_indices[t * 3 + k],
+                                        m_indices[t * 3 + (k + 1) % 3]));
+            }
+        }
+        sort(edges.begin(), edges.end());
+        edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+        vector<Collapse> collapses;
+        collapses.reserve(edges.size());
+        for (auto edge : edges) {
+            unsigned int a = edge >> 32, b = edge & 0xffffffffu;
+            float costAB = m_locked[a] ? INFINITY : collapseCost(a, b);
+            float costBA = m_locked[b] ? INFINITY : collapseCost(b, a);
+            if (costAB == INFINITY && costBA == INFINITY)
+                continue;
+            collapses.push_back(costAB <= costBA ? Collapse{a, b, costAB}
+                                                 : Collapse{b, a, costBA});
+        }
+        sort(collapses.begin(), collapses.end(),
+             [](const Collapse& a, const Collapse& b) {
+                 return a.cost < b.cost;
+             });
+
+        buildAdjacency();
+        // a vertex is touched once its neighborhood changed during the pass
+        vector<uint8_t> touched(m_positions.size(), 0);
+        vector<unsigned int> remap(m_positions.size());
+        iota(remap.begin(), remap.end(), 0u);
+        size_t removeGoal = (m_indices.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        bool collapsed = false;
+        for (const auto& c : collapses) {
+            if (removed >= removeGoal || c.cost > maxCost)
+                break;
+            if (touched[c.from] || touched[c.to] || flips(c.from, c.to))
+                continue;
+            for (uint32_t i = m_adjacencyOffsets[c.from];
+                 i < m_adjacencyOffsets[c.from + 1]; i++) {
+                const unsigned int* tri = &m_indices[m_adjacency[i] * 3];
+                bool shared = false;
+                for (int k = 0; k < 3; k++) {
+                    touched[tri[k]] = 1;
+                    shared = shared || tri[k] == c.to;
+                }
+                removed += shared;
+            }
+            remap[c.from] = c.to;
+            m_quadrics[c.to] += m_quadrics[c.from];
+            m_maxCost = std::max(m_maxCost, double(c.cost));
+            collapsed = true;
+        }
+        if (!collapsed)
+            return false;
+
+        size_t write = 0;
+        for (size_t t = 0; t < m_indices.size() / 3; t++) {
+            unsigned int a = remap[m_indices[t * 3 + 0]],
+                         b = remap[m_indices[t * 3 + 1]],
+                         c = remap[m_indices[t * 3 + 2]];
+            if (a == b || b == c || c == a)
+                continue;
+            m_indices[write++] = a;
+            m_indices[write++] = b;
+            m_indices[write++] = c;
+        }
+        m_indices.resize(write);
+        return true;
+    }
+
+    vector<vec3> m_positions;
+    vector<unsigned int> m_indices;
+    vector<Quadric> m_quadrics;
+    vector<uint8_t> m_locked;
+    // triangles around each vertex
+    vector<uint32_t> m_adjacencyOffsets, m_adjacency;
+    double m_maxCost{0.0};
+};
+
+// indices with every vertex replaced by the first one equal to it, so that
+// unwelded meshes (one vertex per corner) share their edges; the vertices
+// themselves are left alone
+static vector<unsigned int> indexUniqueVertices(
+    const vector<Vertex>& vertices, const vector<unsigned int>& indices) {
+    vector<unsigned int> first(vertices.size());
+    unordered_map<uint64_t, unsigned int> byHash;
+    byHash.reserve(vertices.size());
+    for (unsigned int i = 0; i < vertices.size(); i++) {
+        auto [iter, inserted] = byHash.emplace(hashVertex(vertices[i]), i);
+        // a hash collision keeps the vertex apart, which is only less
+        // simplification
+        first[i] = !inserted && vertices[iter->second] == vertices[i]
+                       ? iter->second
+                       : i;
+    }
+    vector<unsigned int> unique(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+        unique[i] = first[indices[i]];
+    return unique;
+}
+
+void generateMeshLods(Mesh& mesh, const MeshLodOptions& options) {
+    mesh.lods.clear();
+    if (mesh.indices.size() < 3 || options.maxLevels == 0)
+        return;
+    MeshSimplifier simplifier(mesh.vertices,
+                              indexUniqueVertices(mesh.vertices, mesh.indices));
+    size_t previousCount = mesh.indices.size();
+    for (size_t level = 0; level < options.maxLevels; level++) {
+        size_t target = size_t(previousCount / 3 * options.reduction) * 3;
+        simplifier.simplify(target, options.maxError);
+        const auto& indices = simplifier.getIndices();
+        if (indices.empty() ||
+            indices.size() > previousCount * options.minProgress) {
+            LOG_IF(WARNING, level == 0 && !indices.empty())
+                << "mesh " << mesh.name << " kept " << indices.size()
+                << " of " << previousCount << " indices, "
+                << simplifier.countLocked() << " of " << mesh.vertices.size()
+                << " vertices are locked on seams and borders; no level of "
+                << "detail";
+            break;
+        }
+        mesh.lods.push_back(MeshLod{indices, simplifier.getError()});
+        previousCount = indices.size();
+    }
+}
+
+size_t selectMeshLod(const Mesh& mesh, const glm::mat4& modelMatrix,
+                     const PerspectiveCamera& camera, float viewportHeight,
+                     float maxPixelError) {
+    if (mesh.lods.empty())
+        return 0;
+    mat4 transform = modelMatrix * mesh.objectMatrix;
+    AABB worldAABB = mesh.aabb.transform(transform);
+    float radius = glm::length(worldAABB.getDiagonal()) * 0.5f;
+    float distance =
+        glm::length(worldAABB.getCenter() - camera.position) - radius;
+    // the camera is inside the bounds
+    if (distance <= camera.getZNear())
+        return 0;
+    float pixelsPerUnit =
+        viewportHeight / (2.0f * std::tan(camera.getFov() * 0.5f) * distance);
+    float scale = std::max({glm::length(vec3(transform[0])),
+                            glm::length(vec3(transform[1])),
+                            glm::length(vec3(transform[2]))});
+    size_t lod = 0;
+    while (lod < mesh.lods.size() &&
+           mesh.lods[lod].error * scale * pixelsPerUnit <= maxPixelError) {
+        lod++;
+    }
+    return lod;
+}
+
+}  // namespace loo
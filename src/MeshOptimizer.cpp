@@ -0,0 +1,297 @@
+#include "loo/MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <numeric>
+
+#include "loo/Mesh.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+static constexpr int FORSYTH_CACHE_SIZE = 32;
+static constexpr unsigned int NO_TRIANGLE = ~0u;
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices,
+                                    size_t vertexCount, size_t cacheSize) {
+    VertexCacheStats stats;
+    if (indices.empty())
+        return stats;
+    // a vertex is in the cache if it was pushed less than cacheSize misses ago
+    vector<size_t> pushTime(vertexCount, 0);
+    size_t time = cacheSize + 1;
+    for (auto index : indices) {
+        if (time - pushTime[index] > cacheSize) {
+            pushTime[index] = time++;
+            stats.transformedVertexCount++;
+        }
+    }
+    stats.acmr = float(stats.transformedVertexCount) / (indices.size() / 3);
+    stats.atvr = vertexCount ? float(stats.transformedVertexCount) / vertexCount
+                             : 0.0f;
+    return stats;
+}
+
+// triangles using each vertex
+struct TriangleAdjacency {
+    vector<uint32_t> offsets, triangles;
+
+    TriangleAdjacency(const vector<unsigned int>& indices, size_t vertexCount)
+        : offsets(vertexCount + 1, 0), triangles(indices.size()) {
+        for (auto index : indices)
+            offsets[index + 1]++;
+        partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            triangles[fill[indices[i]]++] = i / 3;
+    }
+};
+
+static float forsythVertexScore(int cachePosition, uint32_t liveTriangles) {
+    if (liveTriangles == 0)
+        return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        // the last triangle's vertices get a fixed score so that strips are
+        // not favored over fans
+        score = cachePosition < 3
+                    ? 0.75f
+                    : std::pow(1.0f - float(cachePosition - 3) /
+                                          (FORSYTH_CACHE_SIZE - 3),
+                               1.5f);
+    }
+    // boost vertices with few triangles left to avoid orphans
+    return score + 2.0f / std::sqrt(float(liveTriangles));
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices,
+                         size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    TriangleAdjacency adjacency(indices, vertexCount);
+    vector<uint32_t> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScores[v] = forsythVertexScore(-1, liveTriangles[v]);
+    vector<float> triangleScores(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[indices[t * 3]] +
+                            vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+    vector<uint8_t> emitted(triangleCount, 0);
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    // room for the 3 vertices pushed before the cache is trimmed
+    unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+    unsigned int nextCache[FORSYTH_CACHE_SIZE + 3];
+    int cacheCount = 0;
+    size_t inputCursor = 0;
+    unsigned int best = 0;
+    while (best != NO_TRIANGLE) {
+        const unsigned int* tri = &indices[best * 3];
+        result.insert(result.end(), tri, tri + 3);
+        emitted[best] = 1;
+
+        // move the triangle to the front of the LRU cache
+        int nextCount = 0;
+        for (int k = 0; k < 3; k++)
+            nextCache[nextCount++] = tri[k];
+        for (int i = 0; i < cacheCount; i++) {
+            unsigned int v = cache[i];
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache[nextCount++] = v;
+        }
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            // the triangle is no longer live, remove it from the lists
+            uint32_t* first = &adjacency.triangles[adjacency.offsets[v]];
+            uint32_t* last = first + liveTriangles[v];
+            *std::find(first, last, best) = *(last - 1);
+            liveTriangles[v]--;
+        }
+
+        // rescore the cache, evicted vertices included
+        for (int i = 0; i < nextCount; i++) {
+            unsigned int v = nextCache[i];
+            int position = i < FORSYTH_CACHE_SIZE ? i : -1;
+            float delta = forsythVertexScore(position, liveTriangles[v]) -
+                          vertexScores[v];
+            vertexScores[v] += delta;
+            uint32_t begin = adjacency.offsets[v];
+            for (uint32_t j = begin; j < begin + liveTriangles[v]; j++)
+                triangleScores[adjacency.triangles[j]] += delta;
+        }
+        // the next triangle is picked among the ones touching the cache
+        best = NO_TRIANGLE;
+        float bestScore = -1.0f;
+        for (int i = 0; i < std::min(nextCount, FORSYTH_CACHE_SIZE); i++) {
+            unsigned int v = nextCache[i];
+            uint32_t begin = adjacency.offsets[v];
+            for (uint32_t j = begin; j < begin + liveTriangles[v]; j++) {
+                uint32_t t = adjacency.triangles[j];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+        cacheCount = std::min(nextCount, FORSYTH_CACHE_SIZE);
+        std::copy(nextCache, nextCache + cacheCount, cache);
+
+        // dead end, restart from the next triangle in input order
+        if (best == NO_TRIANGLE) {
+            while (inputCursor < triangleCount && emitted[inputCursor])
+                inputCursor++;
+            if (inputCursor < triangleCount)
+                best = inputCursor;
+        }
+    }
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices,
+                      const std::vector<Vertex>& vertices, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    float targetACMR =
+        analyzeVertexCache(indices, vertices.size()).acmr * threshold;
+
+    // split the triangle list into clusters
+    vector<uint32_t> clusterStarts;
+    vector<size_t> pushTime(vertices.size(), 0);
+    size_t time = VERTEX_CACHE_ANALYZE_SIZE + 1;
+    size_t clusterMisses = 0, clusterTriangles = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - pushTime[v] > VERTEX_CACHE_ANALYZE_SIZE) {
+                pushTime[v] = time++;
+                misses++;
+            }
+        }
+        bool coldCache = misses == 3;
+        bool cheapSplit =
+            misses >= 2 && clusterTriangles > 0 &&
+            float(clusterMisses) / clusterTriangles <= targetACMR;
+        if (t == 0 || coldCache || cheapSplit) {
+            clusterStarts.push_back(t);
+            clusterMisses = 0;
+            clusterTriangles = 0;
+        }
+        clusterMisses += misses;
+        clusterTriangles++;
+    }
+    clusterStarts.push_back(triangleCount);
+
+    // area weighted centroids and normals
+    size_t clusterCount = clusterStarts.size() - 1;
+    vector<vec3> centroids(clusterCount, vec3(0.0f)),
+        normals(clusterCount, vec3(0.0f));
+    vector<float> areas(clusterCount, 0.0f);
+    vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; c++) {
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            const vec3& p0 = vertices[indices[t * 3]].position;
+            const vec3& p1 = vertices[indices[t * 3 + 1]].position;
+            const vec3& p2 = vertices[indices[t * 3 + 2]].position;
+            vec3 n = cross(p1 - p0, p2 - p0);
+            float area = glm::length(n);
+            centroids[c] += (p0 + p1 + p2) * (area / 3.0f);
+            normals[c] += n;
+            areas[c] += area;
+        }
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0f)
+            centroids[c] /= areas[c];
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+    vector<float> sortKeys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; c++) {
+        float length = glm::length(normals[c]);
+        if (length > 0.0f)
+            sortKeys[c] = dot(centroids[c] - meshCentroid, normals[c] / length);
+    }
+    vector<uint32_t> order(clusterCount);
+    iota(order.begin(), order.end(), 0u);
+    // outward facing clusters first, they occlude the rest
+    stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return sortKeys[a] > sortKeys[b];
+    });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (auto c : order) {
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3,
+                      indices.begin() + clusterStarts[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+size_t optimizeVertexFetch(
+    std::vector<Vertex>& vertices,
+    const std::vector<std::vector<unsigned int>*>& indexBuffers,
+    std::vector<unsigned int>* remap) {
+    constexpr unsigned int UNUSED = ~0u;
+    vector<unsigned int> newIndices(vertices.size(), UNUSED);
+    vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (auto* indices : indexBuffers) {
+        for (auto& index : *indices) {
+            if (newIndices[index] == UNUSED) {
+                newIndices[index] = result.size();
+                result.push_back(vertices[index]);
+            }
+            index = newIndices[index];
+        }
+    }
+    vertices.swap(result);
+    if (remap)
+        remap->swap(newIndices);
+    return vertices.size();
+}
+
+MeshOptimizeStats optimizeMesh(Mesh& mesh,
+                               const MeshOptimizeOptions& options) {
+    MeshOptimizeStats stats;
+    size_t vertexCount = mesh.vertices.size();
+    stats.before = analyzeVertexCache(mesh.indices, vertexCount);
+    if (options.vertexCache) {
+        optimizeVertexCache(mesh.indices, vertexCount);
+        for (auto& lod : mesh.lods)
+            optimizeVertexCache(lod.indices, vertexCount);
+    }
+    if (options.overdraw) {
+        optimizeOverdraw(mesh.indices, mesh.vertices,
+                         options.overdrawThreshold);
+    }
+    if (options.vertexFetch) {
+        // level 0 first, the simplified levels only use a subset of its
+        // vertices
+        vector<vector<unsigned int>*> indexBuffers{&mesh.indices};
+        for (auto& lod : mesh.lods)
+            indexBuffers.push_back(&lod.indices);
+        vector<unsigned int> remap;
+        optimizeVertexFetch(mesh.vertices, indexBuffers, &remap);
+        for (auto& index : mesh.meshletVertices)
+            index = remap[index];
+        stats.removedVertexCount = vertexCount - mesh.vertices.size();
+    }
+    stats.after = analyzeVertexCache(mesh.indices, mesh.vertices.size());
+    return stats;
+}
+
+}  // namespace loo
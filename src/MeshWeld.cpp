@@ -0,0 +1,135 @@
+#include "loo/MeshWeld.hpp"
+
+#include <cmath>
+#include <cstring>
+
+#include "loo/Mesh.hpp"
+
+namespace loo {
+
+using namespace std;
+
+static constexpr uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+static constexpr uint32_t EMPTY_SLOT = ~0u;
+// position, normal, texCoord, tangent, bitangent, boneWeights
+static constexpr int VERTEX_FLOAT_COUNT = 3 + 3 + 2 + 3 + 3 + 4;
+
+static inline uint64_t hashCombine(uint64_t h, uint32_t word) {
+    h = (h ^ word) * HASH_MULTIPLIER;
+    return h ^ (h >> 29);
+}
+
+static inline uint32_t floatBits(float f) {
+    // +0 and -0 compare equal, they must hash alike
+    if (f == 0.0f)
+        return 0;
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static void gatherFloats(const Vertex& v, float out[VERTEX_FLOAT_COUNT]) {
+    int n = 0;
+    for (int i = 0; i < 3; i++)
+        out[n++] = v.position[i];
+    for (int i = 0; i < 3; i++)
+        out[n++] = v.normal[i];
+    for (int i = 0; i < 2; i++)
+        out[n++] = v.texCoord[i];
+    for (int i = 0; i < 3; i++)
+        out[n++] = v.tangent[i];
+    for (int i = 0; i < 3; i++)
+        out[n++] = v.bitangent[i];
+    for (int i = 0; i < 4; i++)
+        out[n++] = v.boneWeights[i];
+}
+
+static inline int64_t quantize(float f, float invEpsilon) {
+    return static_cast<int64_t>(std::floor(f * invEpsilon + 0.5f));
+}
+
+uint64_t hashVertex(const Vertex& v) {
+    float floats[VERTEX_FLOAT_COUNT];
+    gatherFloats(v, floats);
+    uint64_t h = 0;
+    for (float f : floats)
+        h = hashCombine(h, floatBits(f));
+    for (int i = 0; i < 4; i++)
+        h = hashCombine(h, static_cast<uint32_t>(v.boneIds[i]));
+    return h;
+}
+
+static uint64_t hashQuantizedVertex(const Vertex& v, float invEpsilon) {
+    float floats[VERTEX_FLOAT_COUNT];
+    gatherFloats(v, floats);
+    uint64_t h = 0;
+    for (float f : floats) {
+        auto q = static_cast<uint64_t>(quantize(f, invEpsilon));
+        h = hashCombine(h, static_cast<uint32_t>(q));
+        h = hashCombine(h, static_cast<uint32_t>(q >> 32));
+    }
+    for (int i = 0; i < 4; i++)
+        h = hashCombine(h, static_cast<uint32_t>(v.boneIds[i]));
+    return h;
+}
+
+static bool equalQuantized(const Vertex& a, const Vertex& b,
+                           float invEpsilon) {
+    if (a.boneIds != b.boneIds)
+        return false;
+    float fa[VERTEX_FLOAT_COUNT], fb[VERTEX_FLOAT_COUNT];
+    gatherFloats(a, fa);
+    gatherFloats(b, fb);
+    for (int i = 0; i < VERTEX_FLOAT_COUNT; i++) {
+        if (quantize(fa[i], invEpsilon) != quantize(fb[i], invEpsilon))
+            return false;
+    }
+    return true;
+}
+
+size_t weldVertices(std::vector<Vertex>& vertices,
+                    std::vector<unsigned int>& indices, float epsilon) {
+    size_t count = vertices.size();
+    if (count == 0)
+        return 0;
+    bool quantized = epsilon > 0.0f;
+    float invEpsilon = quantized ? 1.0f / epsilon : 0.0f;
+
+    // open addressing with linear probing, kept at most half full
+    size_t capacity = 1;
+    while (capacity < count * 2)
+        capacity <<= 1;
+    vector<uint32_t> table(capacity, EMPTY_SLOT);
+    vector<unsigned int> remap(count);
+    size_t uniqueCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& v = vertices[i];
+        uint64_t h = quantized ? hashQuantizedVertex(v, invEpsilon)
+                               : hashVertex(v);
+        size_t slot = h & (capacity - 1);
+        while (true) {
+            uint32_t candidate = table[slot];
+            if (candidate == EMPTY_SLOT) {
+                // survivors are compacted in place, the table only refers to
+                // already compacted slots
+                table[slot] = uniqueCount;
+                vertices[uniqueCount] = v;
+                remap[i] = uniqueCount++;
+                break;
+            }
+            if (quantized ? equalQuantized(vertices[candidate], v, invEpsilon)
+                          : vertices[candidate] == v) {
+                remap[i] = candidate;
+                break;
+            }
+            slot = (slot + 1) & (capacity - 1);
+        }
+    }
+    vertices.resize(uniqueCount);
+    for (auto& index : indices) {
+        index = remap[index];
+    }
+    return count - uniqueCount;
+}
+
+}  // namespace loo
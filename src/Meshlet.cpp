@@ -0,0 +1,154 @@
+#include "loo/Meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+#include <limits>
+
+#include "loo/Mesh.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+static constexpr uint32_t NO_LOCAL_INDEX = ~0u;
+
+static MeshletBounds computeMeshletBounds(const Mesh& mesh,
+                                          const Meshlet& meshlet) {
+    MeshletBounds bounds{};
+    const unsigned int* meshletVertices =
+        mesh.meshletVertices.data() + meshlet.vertexOffset;
+    const uint8_t* triangles =
+        mesh.meshletTriangles.data() + meshlet.triangleOffset;
+
+    vec3 minPos(numeric_limits<float>::infinity()),
+        maxPos(-numeric_limits<float>::infinity());
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        const vec3& p = mesh.vertices[meshletVertices[i]].position;
+        minPos = glm::min(minPos, p);
+        maxPos = glm::max(maxPos, p);
+    }
+    bounds.aabb = AABB(minPos, maxPos);
+    bounds.center = (minPos + maxPos) * 0.5f;
+    float radius2 = 0.0f;
+    for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+        vec3 d = mesh.vertices[meshletVertices[i]].position - bounds.center;
+        radius2 = std::max(radius2, dot(d, d));
+    }
+    bounds.radius = std::sqrt(radius2);
+
+    // normal cone, axis is the mean of the triangle normals
+    auto trianglePosition = [&](uint32_t triangle, int corner) -> const vec3& {
+        return mesh.vertices[meshletVertices[triangles[triangle * 3 + corner]]]
+            .position;
+    };
+    // unit normal per triangle, zero for degenerate ones which are never
+    // visible
+    vector<vec3> normals(meshlet.triangleCount, vec3(0.0f));
+    vec3 axis(0.0f);
+    bool hasArea = false;
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        const vec3& p0 = trianglePosition(t, 0);
+        vec3 n = cross(trianglePosition(t, 1) - p0, trianglePosition(t, 2) - p0);
+        float length = glm::length(n);
+        if (length > 0.0f) {
+            normals[t] = n / length;
+            axis += normals[t];
+            hasArea = true;
+        }
+    }
+    bounds.coneApex = bounds.center;
+    bounds.coneAxis = vec3(0.0f, 0.0f, 1.0f);
+    bounds.coneCutoff = 1.0f;
+    float axisLength = glm::length(axis);
+    if (!hasArea || !(axisLength > 0.0f))
+        return bounds;
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (const auto& n : normals) {
+        if (n != vec3(0.0f))
+            minDot = std::min(minDot, dot(n, axis));
+    }
+    // normals spread over more than a hemisphere
+    if (minDot <= 0.0f) {
+        bounds.coneAxis = axis;
+        return bounds;
+    }
+    // pull the apex back until it lies behind every triangle plane
+    float maxT = 0.0f;
+    for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+        if (normals[t] == vec3(0.0f))
+            continue;
+        float dc = dot(bounds.center - trianglePosition(t, 0), normals[t]);
+        maxT = std::max(maxT, dc / dot(axis, normals[t]));
+    }
+    bounds.coneApex = bounds.center - axis * maxT;
+    bounds.coneAxis = axis;
+    bounds.coneCutoff = std::sqrt(std::max(1.0f - minDot * minDot, 0.0f));
+    return bounds;
+}
+
+void buildMeshlets(Mesh& mesh, size_t maxVertices, size_t maxTriangles) {
+    // local indices are stored in a byte
+    maxVertices = std::clamp<size_t>(maxVertices, 3, 256);
+    maxTriangles = std::max<size_t>(maxTriangles, 1);
+    mesh.meshlets.clear();
+    mesh.meshletBounds.clear();
+    mesh.meshletVertices.clear();
+    mesh.meshletTriangles.clear();
+    size_t triangleCount = mesh.indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    // rough upper bound, triangles usually share most of their vertices
+    mesh.meshlets.reserve(triangleCount / maxTriangles + 1);
+    mesh.meshletVertices.reserve(mesh.vertices.size() +
+                                 mesh.vertices.size() / 4);
+    mesh.meshletTriangles.reserve(triangleCount * 3);
+
+    vector<uint32_t> localIndices(mesh.vertices.size(), NO_LOCAL_INDEX);
+    Meshlet current{0, 0, 0, 0};
+    auto finishMeshlet = [&] {
+        for (uint32_t i = 0; i < current.vertexCount; i++) {
+            localIndices[mesh.meshletVertices[current.vertexOffset + i]] =
+                NO_LOCAL_INDEX;
+        }
+        mesh.meshlets.push_back(current);
+        mesh.meshletBounds.push_back(computeMeshletBounds(mesh, current));
+        current.vertexOffset = mesh.meshletVertices.size();
+        current.triangleOffset = mesh.meshletTriangles.size();
+        current.vertexCount = 0;
+        current.triangleCount = 0;
+    };
+    for (size_t t = 0; t < triangleCount; t++) {
+        unsigned int a = mesh.indices[t * 3 + 0], b = mesh.indices[t * 3 + 1],
+                     c = mesh.indices[t * 3 + 2];
+        size_t newVertices = (localIndices[a] == NO_LOCAL_INDEX) +
+                             (localIndices[b] == NO_LOCAL_INDEX && b != a) +
+                             (localIndices[c] == NO_LOCAL_INDEX && c != a &&
+                              c != b);
+        if (current.vertexCount + newVertices > maxVertices ||
+            current.triangleCount + 1 > maxTriangles) {
+            finishMeshlet();
+        }
+        for (unsigned int v : {a, b, c}) {
+            if (localIndices[v] == NO_LOCAL_INDEX) {
+                localIndices[v] = current.vertexCount++;
+                mesh.meshletVertices.push_back(v);
+            }
+            mesh.meshletTriangles.push_back(localIndices[v]);
+        }
+        current.triangleCount++;
+    }
+    finishMeshlet();
+}
+
+bool isMeshletBackfacing(const MeshletBounds& bounds,
+                         const glm::vec3& cameraPosition) {
+    vec3 view = bounds.coneApex - cameraPosition;
+    float distance = glm::length(view);
+    return distance > 0.0f &&
+           dot(view, bounds.coneAxis) >= bounds.coneCutoff * distance;
+}
+
+}  // namespace loo
@@ -0,0 +1,291 @@
+#include "loo/OcclusionCuller.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <glm/vec4.hpp>
+#include <limits>
+
+#include "loo/Mesh.hpp"
+#include "loo/Scene.hpp"
+#include "loo/ThreadPool.hpp"
+#include "loo/simd.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+static constexpr uint32_t OCCLUSION_FULL_MASK = ~0u;
+static_assert(OCCLUSION_TILE_WIDTH * OCCLUSION_TILE_HEIGHT == 32,
+              "one mask bit per pixel");
+
+// outside the clip depth range, either in front of the near plane or behind
+// the far one, whichever way round reverse Z puts them
+static bool isOutsideDepthRange(const vec4& clip, float depthRangeMin) {
+    return clip.w <= 0.0f || clip.z < depthRangeMin * clip.w || clip.z > clip.w;
+}
+
+// screen coordinate to tile index, clamped to the buffer
+static int getTileIndex(float v, uint32_t tileSize, uint32_t tileCount) {
+    v = std::min(std::max(v, 0.0f), float(tileCount * tileSize - 1));
+    return int(v) / int(tileSize);
+}
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height)
+    : m_tileCountX((width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH),
+      m_tileCountY((height + OCCLUSION_TILE_HEIGHT - 1) /
+                   OCCLUSION_TILE_HEIGHT) {
+    m_width = m_tileCountX * OCCLUSION_TILE_WIDTH;
+    m_height = m_tileCountY * OCCLUSION_TILE_HEIGHT;
+    m_tiles.resize(m_tileCountX * m_tileCountY);
+    m_rowTriangles.resize(m_tileCountY);
+    beginFrame(mat4(1.0f));
+}
+
+void OcclusionCuller::beginFrame(const mat4& viewProjection, bool zeroToOne) {
+    m_viewProjection = viewProjection;
+    m_depthRangeMin = zeroToOne ? 0.0f : -1.0f;
+    // nothing drawn: the reference layer is infinitely far
+    for (auto& tile : m_tiles) {
+        tile.zMin0 = 0.0f;
+        tile.zMin1 = numeric_limits<float>::infinity();
+        tile.mask = 0;
+    }
+    m_triangles.clear();
+    m_stats = OcclusionStats();
+}
+
+void OcclusionCuller::addOccluder(const Mesh& mesh, const mat4& modelMatrix) {
+    mat4 transform = m_viewProjection * modelMatrix;
+    bool fullVertices = !mesh.vertices.empty();
+    size_t vertexCount =
+        fullVertices ? mesh.vertices.size() : mesh.positions.size();
+    if (vertexCount == 0)
+        return;
+    // screen position and 1/w, w <= 0 marks vertices outside the depth range
+    vector<vec3> screen(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        const vec3& p =
+            fullVertices ? mesh.vertices[i].position : mesh.positions[i];
+        vec4 clip = transform * vec4(p, 1.0f);
+        if (isOutsideDepthRange(clip, m_depthRangeMin)) {
+            screen[i] = vec3(0.0f, 0.0f, -1.0f);
+            continue;
+        }
+        float invW = 1.0f / clip.w;
+        screen[i] = vec3((clip.x * invW * 0.5f + 0.5f) * m_width,
+                         (clip.y * invW * 0.5f + 0.5f) * m_height, invW);
+    }
+
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        const vec3& p0 = screen[mesh.indices[i]];
+        const vec3& p1 = screen[mesh.indices[i + 1]];
+        const vec3& p2 = screen[mesh.indices[i + 2]];
+        // dropping an occluder triangle is always conservative
+        if (p0.z <= 0.0f || p1.z <= 0.0f || p2.z <= 0.0f)
+            continue;
+        vec2 d1 = vec2(p1) - vec2(p0), d2 = vec2(p2) - vec2(p0);
+        float area = d1.x * d2.y - d1.y * d2.x;
+        if (std::abs(area) < 1e-8f)
+            continue;
+        float minX = std::min({p0.x, p1.x, p2.x});
+        float maxX = std::max({p0.x, p1.x, p2.x});
+        float minY = std::min({p0.y, p1.y, p2.y});
+        float maxY = std::max({p0.y, p1.y, p2.y});
+        if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+            continue;
+
+        Triangle triangle;
+        const vec3* points[3] = {&p0, &p1, &p2};
+        // both windings, interior on the positive side of every edge
+        float sign = area > 0.0f ? 1.0f : -1.0f;
+        for (int e = 0; e < 3; e++) {
+            const vec3& a = *points[e];
+            const vec3& b = *points[(e + 1) % 3];
+            triangle.edgeA[e] = -(b.y - a.y) * sign;
+            triangle.edgeB[e] = (b.x - a.x) * sign;
+            triangle.edgeC[e] =
+                -(triangle.edgeA[e] * a.x + triangle.edgeB[e] * a.y);
+        }
+        // 1/w is affine in screen space
+        float dz1 = p1.z - p0.z, dz2 = p2.z - p0.z;
+        triangle.depthA = (dz1 * d2.y - dz2 * d1.y) / area;
+        triangle.depthB = (dz2 * d1.x - dz1 * d2.x) / area;
+        triangle.depthC =
+            p0.z - triangle.depthA * p0.x - triangle.depthB * p0.y;
+        triangle.depthMin = std::min({p0.z, p1.z, p2.z});
+        triangle.tileMinX =
+            getTileIndex(minX, OCCLUSION_TILE_WIDTH, m_tileCountX);
+        triangle.tileMaxX =
+            getTileIndex(maxX, OCCLUSION_TILE_WIDTH, m_tileCountX);
+        triangle.tileMinY =
+            getTileIndex(minY, OCCLUSION_TILE_HEIGHT, m_tileCountY);
+        triangle.tileMaxY =
+            getTileIndex(maxY, OCCLUSION_TILE_HEIGHT, m_tileCountY);
+        m_triangles.push_back(triangle);
+    }
+}
+
+uint32_t OcclusionCuller::computeCoverage(const Triangle& triangle, int tileX,
+                                          int tileY) const {
+    // pixel centers
+    float x0 = tileX * OCCLUSION_TILE_WIDTH + 0.5f;
+    float y0 = tileY * OCCLUSION_TILE_HEIGHT + 0.5f;
+    uint32_t coverage = 0;
+#ifdef LOO_SIMD_SSE
+    __m128 columns = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    __m128 zero = _mm_setzero_ps();
+    for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++) {
+        float y = y0 + row;
+        __m128 insideLow = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        __m128 insideHigh = insideLow;
+        for (int e = 0; e < 3; e++) {
+            __m128 a = _mm_set1_ps(triangle.edgeA[e]);
+            float rowValue = triangle.edgeA[e] * x0 + triangle.edgeB[e] * y +
+                             triangle.edgeC[e];
+            __m128 low = _mm_add_ps(_mm_set1_ps(rowValue),
+                                    _mm_mul_ps(a, columns));
+            __m128 high = _mm_add_ps(low, _mm_mul_ps(a, _mm_set1_ps(4.0f)));
+            insideLow = _mm_and_ps(insideLow, _mm_cmpge_ps(low, zero));
+            insideHigh = _mm_and_ps(insideHigh, _mm_cmpge_ps(high, zero));
+        }
+        uint32_t bits = _mm_movemask_ps(insideLow) |
+                        (_mm_movemask_ps(insideHigh) << 4);
+        coverage |= bits << (row * OCCLUSION_TILE_WIDTH);
+    }
+#else
+    for (uint32_t row = 0; row < OCCLUSION_TILE_HEIGHT; row++) {
+        for (uint32_t column = 0; column < OCCLUSION_TILE_WIDTH; column++) {
+            float x = x0 + column, y = y0 + row;
+            bool inside = true;
+            for (int e = 0; e < 3; e++) {
+                inside &= triangle.edgeA[e] * x + triangle.edgeB[e] * y +
+                              triangle.edgeC[e] >=
+                          0.0f;
+            }
+            coverage |= uint32_t(inside)
+                        << (row * OCCLUSION_TILE_WIDTH + column);
+        }
+    }
+#endif
+    return coverage;
+}
+
+void OcclusionCuller::rasterizeTriangle(const Triangle& triangle, int tileY) {
+    float y0 = tileY * OCCLUSION_TILE_HEIGHT + 0.5f;
+    float y1 = y0 + OCCLUSION_TILE_HEIGHT - 1;
+    for (int tileX = triangle.tileMinX; tileX <= triangle.tileMaxX; tileX++) {
+        uint32_t coverage = computeCoverage(triangle, tileX, tileY);
+        if (!coverage)
+            continue;
+        // farthest depth of the triangle over the tile: the plane at the
+        // corners, never beyond the farthest vertex
+        float x0 = tileX * OCCLUSION_TILE_WIDTH + 0.5f;
+        float x1 = x0 + OCCLUSION_TILE_WIDTH - 1;
+        float zTriangle = std::min(
+            {triangle.depthA * x0 + triangle.depthB * y0,
+             triangle.depthA * x1 + triangle.depthB * y0,
+             triangle.depthA * x0 + triangle.depthB * y1,
+             triangle.depthA * x1 + triangle.depthB * y1});
+        zTriangle = std::max(zTriangle + triangle.depthC, triangle.depthMin);
+
+        auto& tile = m_tiles[tileY * m_tileCountX + tileX];
+        // a triangle much nearer than the working layer starts a new one
+        // rather than dragging the layer depth back
+        float nearer = zTriangle - tile.zMin1;
+        if (tile.mask && nearer > tile.zMin1 - tile.zMin0) {
+            tile.zMin1 = numeric_limits<float>::infinity();
+            tile.mask = 0;
+        }
+        tile.zMin1 = std::min(tile.zMin1, zTriangle);
+        tile.mask |= coverage;
+        if (tile.mask == OCCLUSION_FULL_MASK) {
+            tile.zMin0 = std::max(tile.zMin0, tile.zMin1);
+            tile.zMin1 = numeric_limits<float>::infinity();
+            tile.mask = 0;
+        }
+    }
+}
+
+void OcclusionCuller::rasterize(ThreadPool* pool) {
+    auto start = chrono::steady_clock::now();
+    for (auto& row : m_rowTriangles)
+        row.clear();
+    for (uint32_t i = 0; i < m_triangles.size(); i++) {
+        const auto& triangle = m_triangles[i];
+        for (int y = triangle.tileMinY; y <= triangle.tileMaxY; y++)
+            m_rowTriangles[y].push_back(i);
+    }
+    // rows own disjoint tiles, triangles go in submission order in each
+    ThreadPool& threadPool = pool ? *pool : ThreadPool::global();
+    threadPool.parallelFor(m_tileCountY, [&](size_t y) {
+        for (uint32_t i : m_rowTriangles[y])
+            rasterizeTriangle(m_triangles[i], y);
+    });
+    m_stats.occluderTriangleCount += m_triangles.size();
+    m_triangles.clear();
+    m_stats.rasterizeMilliseconds +=
+        chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+            .count();
+}
+
+bool OcclusionCuller::isVisible(const AABB& aabb) const {
+    float minX = numeric_limits<float>::infinity(), minY = minX;
+    float maxX = -minX, maxY = -minX, zMax = 0.0f;
+    for (int i = 0; i < 8; i++) {
+        vec3 corner((i & 1) ? aabb.max.x : aabb.min.x,
+                    (i & 2) ? aabb.max.y : aabb.min.y,
+                    (i & 4) ? aabb.max.z : aabb.min.z);
+        vec4 clip = m_viewProjection * vec4(corner, 1.0f);
+        // reaching in front of the near plane, can't tell
+        if (isOutsideDepthRange(clip, m_depthRangeMin))
+            return true;
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * m_width;
+        float y = (clip.y * invW * 0.5f + 0.5f) * m_height;
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        zMax = std::max(zMax, invW);
+    }
+    if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+        return false;
+    int tileMinX = getTileIndex(minX, OCCLUSION_TILE_WIDTH, m_tileCountX);
+    int tileMaxX = getTileIndex(maxX, OCCLUSION_TILE_WIDTH, m_tileCountX);
+    int tileMinY = getTileIndex(minY, OCCLUSION_TILE_HEIGHT, m_tileCountY);
+    int tileMaxY = getTileIndex(maxY, OCCLUSION_TILE_HEIGHT, m_tileCountY);
+    // visible as soon as the box may be nearer than one tile's reference
+    for (int y = tileMinY; y <= tileMaxY; y++) {
+        const Tile* row = &m_tiles[y * m_tileCountX];
+        for (int x = tileMinX; x <= tileMaxX; x++) {
+            if (zMax >= row[x].zMin0)
+                return true;
+        }
+    }
+    return false;
+}
+
+size_t OcclusionCuller::cullMeshes(const Scene& scene,
+                                   vector<uint32_t>& visible) {
+    auto start = chrono::steady_clock::now();
+    const auto& meshes = scene.getMeshes();
+    mat4 model = scene.getModelMatrix();
+    size_t kept = 0;
+    for (uint32_t index : visible) {
+        const auto& mesh = *meshes[index];
+        if (isVisible(mesh.computeInstancesAABB(model)))
+            visible[kept++] = index;
+    }
+    m_stats.testedCount += visible.size();
+    m_stats.visibleCount += kept;
+    m_stats.occludedCount += visible.size() - kept;
+    visible.resize(kept);
+    m_stats.testMilliseconds +=
+        chrono::duration<double, milli>(chrono::steady_clock::now() - start)
+            .count();
+    return kept;
+}
+
+}  // namespace loo
@@ -0,0 +1,641 @@
+#include "loo/Pose.hpp"
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+#include "loo/simd.hpp"
+namespace loo {
+
+// correction of the nlerp factor t for quaternions with |dot| = d
+static inline float correctFactor(float d, float t) {
+    float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+    float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+    float u = t - 0.5f;
+    float k = a * u * u + b;
+    return t + t * u * (t - 1.0f) * k;
+}
+
+#if defined(LOO_SIMD_AVX2)
+static inline __m256 correctFactor8(__m256 d, __m256 t) {
+    __m256 a = _mm256_fmadd_ps(d, _mm256_set1_ps(-1.43519f),
+                               _mm256_set1_ps(3.55645f));
+    a = _mm256_fmadd_ps(d, a, _mm256_set1_ps(-3.2452f));
+    a = _mm256_fmadd_ps(d, a, _mm256_set1_ps(1.0904f));
+    __m256 b = _mm256_fmadd_ps(d, _mm256_set1_ps(0.215638f),
+                               _mm256_set1_ps(-1.06021f));
+    b = _mm256_fmadd_ps(d, b, _mm256_set1_ps(0.848013f));
+    __m256 u = _mm256_sub_ps(t, _mm256_set1_ps(0.5f));
+    __m256 k = _mm256_fmadd_ps(_mm256_mul_ps(a, u), u, b);
+    __m256 v = _mm256_mul_ps(_mm256_mul_ps(t, u),
+                             _mm256_sub_ps(t, _mm256_set1_ps(1.0f)));
+    return _mm256_fmadd_ps(v, k, t);
+}
+#endif
+
+#if defined(LOO_SIMD_SSE)
+static inline __m128 correctFactor4(__m128 d, __m128 t) {
+    __m128 a = _mm_add_ps(_mm_set1_ps(3.55645f),
+                          _mm_mul_ps(d, _mm_set1_ps(-1.43519f)));
+    a = _mm_add_ps(_mm_set1_ps(-3.2452f), _mm_mul_ps(d, a));
+    a = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, a));
+    __m128 b = _mm_add_ps(_mm_set1_ps(-1.06021f),
+                          _mm_mul_ps(d, _mm_set1_ps(0.215638f)));
+    b = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, b));
+    __m128 u = _mm_sub_ps(t, _mm_set1_ps(0.5f));
+    __m128 k = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(a, u), u), b);
+    __m128 v = _mm_mul_ps(_mm_mul_ps(t, u), _mm_sub_ps(t, _mm_set1_ps(1.0f)));
+    return _mm_add_ps(t, _mm_mul_ps(v, k));
+}
+#endif
+
+void lerpArrays(const float* from, const float* to, const float* factors,
+                size_t count, float* result) {
+    size_t i = 0;
+#if defined(LOO_SIMD_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256 a = _mm256_loadu_ps(from + i);
+        __m256 b = _mm256_loadu_ps(to + i);
+        __m256 t = _mm256_loadu_ps(factors + i);
+        _mm256_storeu_ps(result + i,
+                         _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a));
+    }
+#endif
+#if defined(LOO_SIMD_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 a = _mm_loadu_ps(from + i);
+        __m128 b = _mm_loadu_ps(to + i);
+        __m128 t = _mm_loadu_ps(factors + i);
+        _mm_storeu_ps(result + i,
+                      _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t)));
+    }
+#endif
+    for (; i < count; i++)
+        result[i] = from[i] + (to[i] - from[i]) * factors[i];
+}
+
+// nlerp, with the slerp correction of the factor when asked for
+static void blendQuats(const float* const from[4], const float* const to[4],
+                       const float* factors, size_t count,
+                       float* const result[4], bool slerp) {
+    size_t i = 0;
+#if defined(LOO_SIMD_AVX2)
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    for (; i + 8 <= count; i += 8) {
+        __m256 a[4], b[4];
+        for (int k = 0; k < 4; k++) {
+            a[k] = _mm256_loadu_ps(from[k] + i);
+            b[k] = _mm256_loadu_ps(to[k] + i);
+        }
+        __m256 d = _mm256_mul_ps(a[0], b[0]);
+        for (int k = 1; k < 4; k++)
+            d = _mm256_fmadd_ps(a[k], b[k], d);
+        // negate b where the dot is negative to take the shortest path
+        __m256 flip = _mm256_and_ps(d, signMask);
+        __m256 t = _mm256_loadu_ps(factors + i);
+        if (slerp)
+            t = correctFactor8(_mm256_andnot_ps(signMask, d), t);
+        __m256 r[4], length = _mm256_setzero_ps();
+        for (int k = 0; k < 4; k++) {
+            __m256 bk = _mm256_xor_ps(b[k], flip);
+            r[k] = _mm256_fmadd_ps(_mm256_sub_ps(bk, a[k]), t, a[k]);
+            length = _mm256_fmadd_ps(r[k], r[k], length);
+        }
+        __m256 scale =
+            _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(length));
+        for (int k = 0; k < 4; k++)
+            _mm256_storeu_ps(result[k] + i, _mm256_mul_ps(r[k], scale));
+    }
+#endif
+#if defined(LOO_SIMD_SSE)
+    const __m128 signMask4 = _mm_set1_ps(-0.0f);
+    for (; i + 4 <= count; i += 4) {
+        __m128 a[4], b[4];
+        for (int k = 0; k < 4; k++) {
+            a[k] = _mm_loadu_ps(from[k] + i);
+            b[k] = _mm_loadu_ps(to[k] + i);
+        }
+        __m128 d = _mm_mul_ps(a[0], b[0]);
+        for (int k = 1; k < 4; k++)
+            d = _mm_add_ps(d, _mm_mul_ps(a[k], b[k]));
+        __m128 flip = _mm_and_ps(d, signMask4);
+        __m128 t = _mm_loadu_ps(factors + i);
+        if (slerp)
+            t = correctFactor4(_mm_andnot_ps(signMask4, d), t);
+        __m128 r[4], length = _mm_setzero_ps();
+        for (int k = 0; k < 4; k++) {
+            __m128 bk = _mm_xor_ps(b[k], flip);
+            r[k] = _mm_add_ps(a[k], _mm_mul_ps(_mm_sub_ps(bk, a[k]), t));
+            length = _mm_add_ps(length, _mm_mul_ps(r[k], r[k]));
+        }
+        __m128 scale = _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(length));
+        for (int k = 0; k < 4; k++)
+            _mm_storeu_ps(result[k] + i, _mm_mul_ps(r[k], scale));
+    }
+#endif
+    for (; i < count; i++) {
+        float a[4], b[4], d = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            a[k] = from[k][i];
+            b[k] = to[k][i];
+            d += a[k] * b[k];
+        }
+        float sign = d < 0.0f ? -1.0f : 1.0f;
+        float t = slerp ? correctFactor(std::abs(d), factors[i]) : factors[i];
+        float r[4], length = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            r[k] = a[k] + (b[k] * sign - a[k]) * t;
+            length += r[k] * r[k];
+        }
+        float scale = 1.0f / std::sqrt(length);
+        for (int k = 0; k < 4; k++)
+            result[k][i] = r[k] * scale;
+    }
+}
+
+void nlerpQuats(const float* const from[4], const float* const to[4],
+                const float* factors, size_t count, float* const result[4]) {
+    blendQuats(from, to, factors, count, result, false);
+}
+
+void slerpQuats(const float* const from[4], const float* const to[4],
+                const float* factors, size_t count, float* const result[4]) {
+    blendQuats(from, to, factors, count, result, true);
+}
+
+#if defined(LOO_SIMD_SSE)
+// rows[r] lane l is row r of column c of result[l], the last row is w
+static inline void storeColumn4(const __m128 rows[3], __m128 w,
+                                glm::mat4* result, int c) {
+    __m128 m0 = rows[0], m1 = rows[1], m2 = rows[2], m3 = w;
+    _MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+    _mm_storeu_ps(&result[0][c][0], m0);
+    _mm_storeu_ps(&result[1][c][0], m1);
+    _mm_storeu_ps(&result[2][c][0], m2);
+    _mm_storeu_ps(&result[3][c][0], m3);
+}
+#endif
+
+void composeAffines(const BonePoseArrays& poses, size_t count,
+                    glm::mat4* result) {
+    size_t i = 0;
+#if defined(LOO_SIMD_AVX2)
+    for (; i + 8 <= count; i += 8) {
+        __m256 t[3], q[4], s[3];
+        for (int k = 0; k < 3; k++) {
+            t[k] = _mm256_loadu_ps(poses.translation[k] + i);
+            s[k] = _mm256_loadu_ps(poses.scale[k] + i);
+        }
+        for (int k = 0; k < 4; k++)
+            q[k] = _mm256_loadu_ps(poses.rotation[k] + i);
+        __m256 x2 = _mm256_add_ps(q[0], q[0]);
+        __m256 y2 = _mm256_add_ps(q[1], q[1]);
+        __m256 z2 = _mm256_add_ps(q[2], q[2]);
+        __m256 xx = _mm256_mul_ps(q[0], x2), yy = _mm256_mul_ps(q[1], y2);
+        __m256 zz = _mm256_mul_ps(q[2], z2), xy = _mm256_mul_ps(q[0], y2);
+        __m256 xz = _mm256_mul_ps(q[0], z2), yz = _mm256_mul_ps(q[1], z2);
+        __m256 wx = _mm256_mul_ps(q[3], x2), wy = _mm256_mul_ps(q[3], y2);
+        __m256 wz = _mm256_mul_ps(q[3], z2);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        // columns of rotate * scale, then the translation
+        __m256 m[4][3] = {
+            {_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), _mm256_add_ps(xy, wz),
+             _mm256_sub_ps(xz, wy)},
+            {_mm256_sub_ps(xy, wz), _mm256_sub_ps(one, _mm256_add_ps(xx, zz)),
+             _mm256_add_ps(yz, wx)},
+            {_mm256_add_ps(xz, wy), _mm256_sub_ps(yz, wx),
+             _mm256_sub_ps(one, _mm256_add_ps(xx, yy))},
+            {t[0], t[1], t[2]},
+        };
+        for (int c = 0; c < 4; c++) {
+            __m128 low[3], high[3];
+            for (int r = 0; r < 3; r++) {
+                __m256 v = c < 3 ? _mm256_mul_ps(m[c][r], s[c]) : m[c][r];
+                low[r] = _mm256_castps256_ps128(v);
+                high[r] = _mm256_extractf128_ps(v, 1);
+            }
+            __m128 w = _mm_set1_ps(c < 3 ? 0.0f : 1.0f);
+            storeColumn4(low, w, result + i, c);
+            storeColumn4(high, w, result + i + 4, c);
+        }
+    }
+#endif
+#if defined(LOO_SIMD_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 t[3], q[4], s[3];
+        for (int k = 0; k < 3; k++) {
+            t[k] = _mm_loadu_ps(poses.translation[k] + i);
+            s[k] = _mm_loadu_ps(poses.scale[k] + i);
+        }
+        for (int k = 0; k < 4; k++)
+            q[k] = _mm_loadu_ps(poses.rotation[k] + i);
+        __m128 x2 = _mm_add_ps(q[0], q[0]);
+        __m128 y2 = _mm_add_ps(q[1], q[1]);
+        __m128 z2 = _mm_add_ps(q[2], q[2]);
+        __m128 xx = _mm_mul_ps(q[0], x2), yy = _mm_mul_ps(q[1], y2);
+        __m128 zz = _mm_mul_ps(q[2], z2), xy = _mm_mul_ps(q[0], y2);
+        __m128 xz = _mm_mul_ps(q[0], z2), yz = _mm_mul_ps(q[1], z2);
+        __m128 wx = _mm_mul_ps(q[3], x2), wy = _mm_mul_ps(q[3], y2);
+        __m128 wz = _mm_mul_ps(q[3], z2);
+        const __m128 one = _mm_set1_ps(1.0f);
+        __m128 m[4][3] = {
+            {_mm_sub_ps(one, _mm_add_ps(yy, zz)), _mm_add_ps(xy, wz),
+             _mm_sub_ps(xz, wy)},
+            {_mm_sub_ps(xy, wz), _mm_sub_ps(one, _mm_add_ps(xx, zz)),
+             _mm_add_ps(yz, wx)},
+            {_mm_add_ps(xz, wy), _mm_sub_ps(yz, wx),
+             _mm_sub_ps(one, _mm_add_ps(xx, yy))},
+            {t[0], t[1], t[2]},
+        };
+        for (int c = 0; c < 3; c++) {
+            for (int r = 0; r < 3; r++)
+                m[c][r] = _mm_mul_ps(m[c][r], s[c]);
+        }
+        for (int c = 0; c < 4; c++)
+            storeColumn4(m[c], _mm_set1_ps(c < 3 ? 0.0f : 1.0f), result + i,
+                         c);
+    }
+#endif
+    for (; i < count; i++) {
+        float x = poses.rotation[0][i], y = poses.rotation[1][i];
+        float z = poses.rotation[2][i], w = poses.rotation[3][i];
+        float sx = poses.scale[0][i], sy = poses.scale[1][i];
+        float sz = poses.scale[2][i];
+        glm::mat4& mat = result[i];
+        mat[0][0] = (1.0f - 2.0f * (y * y + z * z)) * sx;
+        mat[0][1] = 2.0f * (x * y + w * z) * sx;
+        mat[0][2] = 2.0f * (x * z - w * y) * sx;
+        mat[0][3] = 0.0f;
+        mat[1][0] = 2.0f * (x * y - w * z) * sy;
+        mat[1][1] = (1.0f - 2.0f * (x * x + z * z)) * sy;
+        mat[1][2] = 2.0f * (y * z + w * x) * sy;
+        mat[1][3] = 0.0f;
+        mat[2][0] = 2.0f * (x * z + w * y) * sz;
+        mat[2][1] = 2.0f * (y * z - w * x) * sz;
+        mat[2][2] = (1.0f - 2.0f * (x * x + y * y)) * sz;
+        mat[2][3] = 0.0f;
+        for (int r = 0; r < 3; r++)
+            mat[3][r] = poses.translation[r][i];
+        mat[3][3] = 1.0f;
+    }
+}
+
+void multiplyAffines(const glm::mat4* a, const glm::mat4* b, size_t count,
+                     glm::mat4* result) {
+    size_t i = 0;
+    // the lanes are the rows here, a column of the result is a sum of the
+    // columns of a
+#if defined(LOO_SIMD_AVX2)
+    // two matrices at a time, a[i] in the low half
+    const __m256 rowMask8 = _mm256_castsi256_ps(
+        _mm256_setr_epi32(-1, -1, -1, 0, -1, -1, -1, 0));
+    const __m256 lastRow8 =
+        _mm256_setr_ps(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+    for (; i + 2 <= count; i += 2) {
+        __m256 columns[4], r[4];
+        for (int c = 0; c < 4; c++) {
+            columns[c] = _mm256_set_m128(_mm_loadu_ps(&a[i + 1][c][0]),
+                                         _mm_loadu_ps(&a[i][c][0]));
+        }
+        for (int c = 0; c < 4; c++) {
+            r[c] = c < 3 ? _mm256_setzero_ps() : columns[3];
+            for (int k = 0; k < 3; k++) {
+                __m256 factor = _mm256_set_m128(_mm_set1_ps(b[i + 1][c][k]),
+                                                _mm_set1_ps(b[i][c][k]));
+                r[c] = _mm256_fmadd_ps(columns[k], factor, r[c]);
+            }
+            r[c] = _mm256_and_ps(r[c], rowMask8);
+        }
+        r[3] = _mm256_or_ps(r[3], lastRow8);
+        for (int c = 0; c < 4; c++) {
+            _mm_storeu_ps(&result[i][c][0], _mm256_castps256_ps128(r[c]));
+            _mm_storeu_ps(&result[i + 1][c][0], _mm256_extractf128_ps(r[c], 1));
+        }
+    }
+#endif
+#if defined(LOO_SIMD_SSE)
+    const __m128 rowMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    const __m128 lastRow = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    for (; i < count; i++) {
+        __m128 columns[4], r[4];
+        for (int c = 0; c < 4; c++)
+            columns[c] = _mm_loadu_ps(&a[i][c][0]);
+        for (int c = 0; c < 4; c++) {
+            r[c] = c < 3 ? _mm_setzero_ps() : columns[3];
+            for (int k = 0; k < 3; k++) {
+                r[c] = _mm_add_ps(
+                    r[c], _mm_mul_ps(columns[k], _mm_set1_ps(b[i][c][k])));
+            }
+            r[c] = _mm_and_ps(r[c], rowMask);
+        }
+        r[3] = _mm_or_ps(r[3], lastRow);
+        for (int c = 0; c < 4; c++)
+            _mm_storeu_ps(&result[i][c][0], r[c]);
+    }
+#endif
+    for (; i < count; i++) {
+        glm::mat4 mat(1.0f);
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 3; r++) {
+                float sum = c < 3 ? 0.0f : a[i][3][r];
+                for (int k = 0; k < 3; k++)
+                    sum += a[i][k][r] * b[i][c][k];
+                mat[c][r] = sum;
+            }
+        }
+        result[i] = mat;
+    }
+}
+
+void blendPoses(const BonePoseArrays& a, const BonePoseArrays& b,
+                const float* weights, size_t count,
+                const BonePoseArrays& result) {
+    for (int k = 0; k < 3; k++) {
+        lerpArrays(a.translation[k], b.translation[k], weights, count,
+                   result.translation[k]);
+        lerpArrays(a.scale[k], b.scale[k], weights, count, result.scale[k]);
+    }
+    nlerpQuats(a.rotation, b.rotation, weights, count, result.rotation);
+}
+
+// addPoses is written once over float, __m128 and __m256 lanes with these
+static inline float loadLanes(const float* p, float) { return *p; }
+static inline void storeLanes(float* p, float v) { *p = v; }
+static inline float setLanes(float v, float) { return v; }
+static inline float add(float a, float b) { return a + b; }
+static inline float sub(float a, float b) { return a - b; }
+static inline float mul(float a, float b) { return a * b; }
+static inline float getInverseSqrt(float v) { return 1.0f / std::sqrt(v); }
+// -1 where v is negative, else 1
+static inline float getSign(float v) { return v < 0.0f ? -1.0f : 1.0f; }
+
+#if defined(LOO_SIMD_SSE)
+static inline __m128 loadLanes(const float* p, __m128) {
+    return _mm_loadu_ps(p);
+}
+static inline void storeLanes(float* p, __m128 v) { _mm_storeu_ps(p, v); }
+static inline __m128 setLanes(float v, __m128) { return _mm_set1_ps(v); }
+static inline __m128 add(__m128 a, __m128 b) { return _mm_add_ps(a, b); }
+static inline __m128 sub(__m128 a, __m128 b) { return _mm_sub_ps(a, b); }
+static inline __m128 mul(__m128 a, __m128 b) { return _mm_mul_ps(a, b); }
+static inline __m128 getInverseSqrt(__m128 v) {
+    return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(v));
+}
+static inline __m128 getSign(__m128 v) {
+    return _mm_or_ps(_mm_and_ps(v, _mm_set1_ps(-0.0f)), _mm_set1_ps(1.0f));
+}
+#endif
+
+#if defined(LOO_SIMD_AVX2)
+static inline __m256 loadLanes(const float* p, __m256) {
+    return _mm256_loadu_ps(p);
+}
+static inline void storeLanes(float* p, __m256 v) { _mm256_storeu_ps(p, v); }
+static inline __m256 setLanes(float v, __m256) { return _mm256_set1_ps(v); }
+static inline __m256 add(__m256 a, __m256 b) { return _mm256_add_ps(a, b); }
+static inline __m256 sub(__m256 a, __m256 b) { return _mm256_sub_ps(a, b); }
+static inline __m256 mul(__m256 a, __m256 b) { return _mm256_mul_ps(a, b); }
+static inline __m256 getInverseSqrt(__m256 v) {
+    return _mm256_div_ps(_mm256_set1_ps(1.0f), _mm256_sqrt_ps(v));
+}
+static inline __m256 getSign(__m256 v) {
+    return _mm256_or_ps(_mm256_and_ps(v, _mm256_set1_ps(-0.0f)),
+                        _mm256_set1_ps(1.0f));
+}
+#endif
+
+// a * b of quaternions as x, y, z, w
+template <typename V>
+static inline void multiplyQuats(const V a[4], const V b[4], V r[4]) {
+    r[0] = sub(add(add(mul(a[3], b[0]), mul(a[0], b[3])), mul(a[1], b[2])),
+               mul(a[2], b[1]));
+    r[1] = add(add(sub(mul(a[3], b[1]), mul(a[0], b[2])), mul(a[1], b[3])),
+               mul(a[2], b[0]));
+    r[2] = add(sub(add(mul(a[3], b[2]), mul(a[0], b[1])), mul(a[1], b[0])),
+               mul(a[2], b[3]));
+    r[3] = sub(sub(sub(mul(a[3], b[3]), mul(a[0], b[0])), mul(a[1], b[1])),
+               mul(a[2], b[2]));
+}
+
+// addPoses for the lanes of V starting at bone i
+template <typename V>
+static inline void addPoseLanes(const BonePoseArrays& base,
+                                const BonePoseArrays& additive,
+                                const BonePoseArrays& inverseReference,
+                                const float* weights,
+                                const BonePoseArrays& result, size_t i) {
+    const V tag{}, one = setLanes(1.0f, tag);
+    V w = loadLanes(weights + i, tag);
+    for (int k = 0; k < 3; k++) {
+        V t = add(loadLanes(additive.translation[k] + i, tag),
+                  loadLanes(inverseReference.translation[k] + i, tag));
+        storeLanes(result.translation[k] + i,
+                   add(loadLanes(base.translation[k] + i, tag), mul(w, t)));
+        V s = sub(mul(loadLanes(additive.scale[k] + i, tag),
+                      loadLanes(inverseReference.scale[k] + i, tag)),
+                  one);
+        storeLanes(result.scale[k] + i,
+                   mul(loadLanes(base.scale[k] + i, tag), add(one, mul(w, s))));
+    }
+    V b[4], a[4], r[4], d[4];
+    for (int k = 0; k < 4; k++) {
+        b[k] = loadLanes(base.rotation[k] + i, tag);
+        a[k] = loadLanes(additive.rotation[k] + i, tag);
+        r[k] = loadLanes(inverseReference.rotation[k] + i, tag);
+    }
+    // the difference on the shortest path, nlerp from identity by w
+    multiplyQuats(r, a, d);
+    V sign = getSign(d[3]);
+    V length = setLanes(0.0f, tag);
+    for (int k = 0; k < 4; k++) {
+        d[k] = k < 3 ? mul(w, mul(d[k], sign))
+                     : add(sub(one, w), mul(w, mul(d[k], sign)));
+        length = add(length, mul(d[k], d[k]));
+    }
+    V scale = getInverseSqrt(length);
+    for (int k = 0; k < 4; k++)
+        d[k] = mul(d[k], scale);
+    multiplyQuats(b, d, r);
+    for (int k = 0; k < 4; k++)
+        storeLanes(result.rotation[k] + i, r[k]);
+}
+
+void addPoses(const BonePoseArrays& base, const BonePoseArrays& additive,
+              const BonePoseArrays& inverseReference, const float* weights,
+              size_t count, const BonePoseArrays& result) {
+    size_t i = 0;
+#if defined(LOO_SIMD_AVX2)
+    for (; i + 8 <= count; i += 8)
+        addPoseLanes<__m256>(base, additive, inverseReference, weights,
+                             result, i);
+#endif
+#if defined(LOO_SIMD_SSE)
+    for (; i + 4 <= count; i += 4)
+        addPoseLanes<__m128>(base, additive, inverseReference, weights,
+                             result, i);
+#endif
+    for (; i < count; i++)
+        addPoseLanes<float>(base, additive, inverseReference, weights, result,
+                            i);
+}
+
+// arrays of the sampler, vectors take one array per component
+enum : size_t {
+    TRANSLATION_FROM = 0,
+    TRANSLATION_TO = 3,
+    TRANSLATION_FACTOR = 6,
+    ROTATION_FROM = 7,
+    ROTATION_TO = 11,
+    ROTATION_FACTOR = 15,
+    SCALE_FROM = 16,
+    SCALE_TO = 19,
+    SCALE_FACTOR = 22,
+    POSE_TRANSLATION = 23,
+    POSE_ROTATION = 26,
+    POSE_SCALE = 30,
+    SAMPLER_ARRAY_COUNT = 33,
+};
+
+static inline void storeValue(float* first, size_t stride, size_t i,
+                              const glm::vec3& v) {
+    first[i] = v.x;
+    first[stride + i] = v.y;
+    first[2 * stride + i] = v.z;
+}
+
+static inline void storeValue(float* first, size_t stride, size_t i,
+                              const glm::quat& q) {
+    first[i] = q.x;
+    first[stride + i] = q.y;
+    first[2 * stride + i] = q.z;
+    first[3 * stride + i] = q.w;
+}
+
+// the two keys around time and the factor between them, a constant track
+// gives its value twice
+template <typename T>
+static void gatherKeys(const KeyTrack<T>& track, float time, uint32_t& cursor,
+                       const T& rest, float* from, float* to, float* factors,
+                       size_t stride, size_t i) {
+    if (track.size() > 1) {
+        size_t key = track.findKey(time, cursor);
+        storeValue(from, stride, i, track.values[key]);
+        storeValue(to, stride, i, track.values[key + 1]);
+        factors[i] = track.getFactor(key, time);
+    } else {
+        const T& value = track.size() == 1 ? track.values[0] : rest;
+        storeValue(from, stride, i, value);
+        storeValue(to, stride, i, value);
+        factors[i] = 0.0f;
+    }
+}
+
+void PoseBuffer::resize(size_t boneCount) {
+    m_boneCount = boneCount;
+    m_data.assign(10 * boneCount, 0.0f);
+}
+
+BonePoseArrays PoseBuffer::getArrays() {
+    BonePoseArrays arrays;
+    float* first = m_data.data();
+    for (int k = 0; k < 3; k++) {
+        arrays.translation[k] = first + k * m_boneCount;
+        arrays.scale[k] = first + (7 + k) * m_boneCount;
+    }
+    for (int k = 0; k < 4; k++)
+        arrays.rotation[k] = first + (3 + k) * m_boneCount;
+    return arrays;
+}
+
+BonePose PoseBuffer::getPose(size_t i) const {
+    const float* first = m_data.data();
+    size_t n = m_boneCount;
+    BonePose pose;
+    for (int k = 0; k < 3; k++) {
+        pose.translation[k] = first[k * n + i];
+        pose.scale[k] = first[(7 + k) * n + i];
+    }
+    pose.rotation.x = first[3 * n + i];
+    pose.rotation.y = first[4 * n + i];
+    pose.rotation.z = first[5 * n + i];
+    pose.rotation.w = first[6 * n + i];
+    return pose;
+}
+
+void PoseBuffer::setPose(size_t i, const BonePose& pose) {
+    float* first = m_data.data();
+    storeValue(first, m_boneCount, i, pose.translation);
+    storeValue(first + 3 * m_boneCount, m_boneCount, i, pose.rotation);
+    storeValue(first + 7 * m_boneCount, m_boneCount, i, pose.scale);
+}
+
+void PoseSampler::resize(size_t boneCount) {
+    m_boneCount = boneCount;
+    m_data.assign(SAMPLER_ARRAY_COUNT * boneCount, 0.0f);
+}
+
+void PoseSampler::gather(size_t i, const Bone& bone, float time,
+                         BoneCursor& cursor) {
+    BonePose rest;
+    gatherKeys(bone.getPositionTrack(), time, cursor.position,
+               rest.translation, getArray(TRANSLATION_FROM),
+               getArray(TRANSLATION_TO), getArray(TRANSLATION_FACTOR),
+               m_boneCount, i);
+    gatherKeys(bone.getRotationTrack(), time, cursor.rotation, rest.rotation,
+               getArray(ROTATION_FROM), getArray(ROTATION_TO),
+               getArray(ROTATION_FACTOR), m_boneCount, i);
+    gatherKeys(bone.getScaleTrack(), time, cursor.scale, rest.scale,
+               getArray(SCALE_FROM), getArray(SCALE_TO),
+               getArray(SCALE_FACTOR), m_boneCount, i);
+}
+
+void PoseSampler::gather(size_t i, const BonePose& pose) {
+    storeValue(getArray(TRANSLATION_FROM), m_boneCount, i, pose.translation);
+    storeValue(getArray(TRANSLATION_TO), m_boneCount, i, pose.translation);
+    storeValue(getArray(ROTATION_FROM), m_boneCount, i, pose.rotation);
+    storeValue(getArray(ROTATION_TO), m_boneCount, i, pose.rotation);
+    storeValue(getArray(SCALE_FROM), m_boneCount, i, pose.scale);
+    storeValue(getArray(SCALE_TO), m_boneCount, i, pose.scale);
+    getArray(TRANSLATION_FACTOR)[i] = 0.0f;
+    getArray(ROTATION_FACTOR)[i] = 0.0f;
+    getArray(SCALE_FACTOR)[i] = 0.0f;
+}
+
+void PoseSampler::interpolate(bool slerp) {
+    float* arrays[SAMPLER_ARRAY_COUNT];
+    for (size_t array = 0; array < SAMPLER_ARRAY_COUNT; array++)
+        arrays[array] = getArray(array);
+    for (int k = 0; k < 3; k++) {
+        lerpArrays(arrays[TRANSLATION_FROM + k], arrays[TRANSLATION_TO + k],
+                   arrays[TRANSLATION_FACTOR], m_boneCount,
+                   arrays[POSE_TRANSLATION + k]);
+        lerpArrays(arrays[SCALE_FROM + k], arrays[SCALE_TO + k],
+                   arrays[SCALE_FACTOR], m_boneCount, arrays[POSE_SCALE + k]);
+    }
+    (slerp ? slerpQuats : nlerpQuats)(
+        arrays + ROTATION_FROM, arrays + ROTATION_TO, arrays[ROTATION_FACTOR],
+        m_boneCount, arrays + POSE_ROTATION);
+}
+
+BonePoseArrays PoseSampler::getPoses() {
+    BonePoseArrays poses;
+    for (int k = 0; k < 3; k++) {
+        poses.translation[k] = getArray(POSE_TRANSLATION + k);
+        poses.scale[k] = getArray(POSE_SCALE + k);
+    }
+    for (int k = 0; k < 4; k++)
+        poses.rotation[k] = getArray(POSE_ROTATION + k);
+    return poses;
+}
+
+BonePose PoseSampler::getPose(size_t i) const {
+    BonePose pose;
+    for (int k = 0; k < 3; k++) {
+        pose.translation[k] = getArray(POSE_TRANSLATION + k)[i];
+        pose.scale[k] = getArray(POSE_SCALE + k)[i];
+    }
+    pose.rotation.x = getArray(POSE_ROTATION)[i];
+    pose.rotation.y = getArray(POSE_ROTATION + 1)[i];
+    pose.rotation.z = getArray(POSE_ROTATION + 2)[i];
+    pose.rotation.w = getArray(POSE_ROTATION + 3)[i];
+    return pose;
+}
+
+}  // namespace loo
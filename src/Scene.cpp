@@ -12,17 +12,16 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include <assimp/Importer.hpp>
-#include <glm/gtx/hash.hpp>
 #include <glm/gtx/quaternion.hpp>
 #include <iostream>
 #include "loo/Animation.hpp"
+#include "loo/MeshWeld.hpp"
+#include "loo/SceneCache.hpp"
+#include "loo/SceneStream.hpp"
 
 namespace std {
 size_t hash<loo::Vertex>::operator()(loo::Vertex const& v) const {
-    return ((hash<glm::vec3>()(v.position) ^
-             (hash<glm::vec3>()(v.normal) << 1)) >>
-            1) ^
-           (hash<glm::vec2>()(v.texCoord) << 1);
+    return loo::hashVertex(v);
 }
 }  // namespace std
 namespace loo {
@@ -72,7 +71,13 @@ size_t Scene::countTriangle() const {
 void Scene::addMeshes(vector<shared_ptr<Mesh>>&& meshes) {
     m_meshes.insert(m_meshes.end(), meshes.begin(), meshes.end());
     for (const auto& mesh : meshes) {
-        aabb.merge(mesh->aabb.transform(mesh->objectMatrix));
+        // streamed meshes may show up after their node moved
+        for (size_t i = 0; i < mesh->countInstances(); i++) {
+            if (mesh->getInstanceNode(i) < graph.size())
+                mesh->getInstanceMatrix(i) =
+                    graph.getWorldMatrix(mesh->getInstanceNode(i));
+        }
+        aabb.merge(mesh->computeInstancesAABB(glm::identity<glm::mat4>()));
     }
 }
 
@@ -83,42 +88,254 @@ AABB Scene::computeAABBWorldSpace() {
 // prepare the scene, move the mesh data into opengl side
 void Scene::prepare() const {
     for (const auto& mesh : m_meshes) {
-        mesh->prepare();
+        mesh->prepare(geometryArena.get());
     }
 }
 Scene::Scene() = default;
 
-Scene createSceneFromFile(const std::string& filename) {
+bool Scene::streamMeshes(size_t byteBudget) {
+    if (!m_stream)
+        return false;
+    if (!m_stream->update(*this, byteBudget))
+        m_stream.reset();
+    return m_stream != nullptr;
+}
+
+const std::vector<SceneGraphRange>& Scene::updateTransforms() {
+    const auto& ranges = graph.update();
+    if (ranges.empty())
+        return ranges;
+    if (m_nodeMeshOffsets.size() != graph.size() + 1 ||
+        m_nodeMeshCount != m_meshes.size()) {
+        // counting sort of the mesh instances by node, a node range is then
+        // a contiguous run of instances
+        m_nodeMeshOffsets.assign(graph.size() + 1, 0);
+        for (const auto& mesh : m_meshes) {
+            for (size_t i = 0; i < mesh->countInstances(); i++) {
+                if (mesh->getInstanceNode(i) < graph.size())
+                    m_nodeMeshOffsets[mesh->getInstanceNode(i) + 1]++;
+            }
+        }
+        for (size_t i = 1; i < m_nodeMeshOffsets.size(); i++)
+            m_nodeMeshOffsets[i] += m_nodeMeshOffsets[i - 1];
+        m_nodeMeshes.resize(m_nodeMeshOffsets.back());
+        vector<uint32_t> cursors(m_nodeMeshOffsets.begin(),
+                                 m_nodeMeshOffsets.end() - 1);
+        for (uint32_t m = 0; m < m_meshes.size(); m++) {
+            for (uint32_t i = 0; i < m_meshes[m]->countInstances(); i++) {
+                uint32_t node = m_meshes[m]->getInstanceNode(i);
+                if (node < graph.size())
+                    m_nodeMeshes[cursors[node]++] = {m, i};
+            }
+        }
+        m_nodeMeshCount = m_meshes.size();
+        m_meshMovedEpochs.assign(m_meshes.size(), 0);
+        m_movedMeshes.clear();
+    }
+    for (const auto& range : ranges) {
+        for (uint32_t i = m_nodeMeshOffsets[range.begin];
+             i < m_nodeMeshOffsets[range.end]; i++) {
+            auto [meshIndex, instance] = m_nodeMeshes[i];
+            auto& mesh = *m_meshes[meshIndex];
+            mesh.getInstanceMatrix(instance) =
+                graph.getWorldMatrix(mesh.getInstanceNode(instance));
+            // instances of a mesh are uploaded together; without a list
+            // drawIndirect() uploads everything when it builds one
+            if (m_drawList && m_meshMovedEpochs[meshIndex] != m_moveEpoch) {
+                m_meshMovedEpochs[meshIndex] = m_moveEpoch;
+                m_movedMeshes.push_back(&mesh);
+            }
+        }
+    }
+    return ranges;
+}
+
+void Scene::drawIndirect(const IndirectDrawCallback& beforeBucket,
+                         const IndirectDrawOptions& options) {
+    if (m_drawList && m_drawList->isBuiltFrom(m_meshes, options)) {
+        if (graph.empty()) {
+            m_drawList->updateDrawData();
+        } else {
+            // objectMatrixPrev of the meshes moved last time changed as well
+            m_lastMovedMeshes.insert(m_lastMovedMeshes.end(),
+                                     m_movedMeshes.begin(),
+                                     m_movedMeshes.end());
+            m_drawList->updateDrawData(m_lastMovedMeshes);
+        }
+    } else {
+        if (!m_drawList)
+            m_drawList = make_shared<IndirectDrawList>();
+        m_drawList->build(m_meshes, options);
+    }
+    m_lastMovedMeshes = std::move(m_movedMeshes);
+    m_movedMeshes.clear();
+    m_moveEpoch++;
+    m_drawList->draw(beforeBucket);
+}
+
+MeshResidencyStats Scene::releaseCpuData(MeshResidency residency) {
+    MeshResidencyStats stats;
+    for (const auto& mesh : m_meshes) {
+        size_t bytes = mesh->releaseCpuData(residency);
+        if (bytes) {
+            stats.meshCount++;
+            stats.reclaimedBytes += bytes;
+        }
+    }
+    if (stats.meshCount) {
+        LOG(INFO) << "released CPU data of " << stats.meshCount
+                  << " meshes, reclaimed "
+                  << stats.reclaimedBytes / double(1 << 20) << "MB";
+    }
+    return stats;
+}
+
+bool Scene::restoreCpuData() {
+    bool restored = true;
+    map<MeshDataSource*, vector<shared_ptr<Mesh>>> released;
+    for (const auto& mesh : m_meshes) {
+        if (mesh->getResidency() == MeshResidency::Keep)
+            continue;
+        if (mesh->getDataSource())
+            released[mesh->getDataSource().get()].push_back(mesh);
+        else
+            restored = false;
+    }
+    for (auto& [source, meshes] : released) {
+        vector<size_t> sourceIndices;
+        for (const auto& mesh : meshes)
+            sourceIndices.push_back(mesh->sourceIndex);
+        auto loaded = source->fetch(sourceIndices);
+        if (loaded.size() != meshes.size()) {
+            restored = false;
+            continue;
+        }
+        for (size_t i = 0; i < meshes.size(); i++)
+            meshes[i]->restoreCpuData(*loaded[i]);
+    }
+    return restored;
+}
+
+SceneFileDataSource::SceneFileDataSource(std::string filename,
+                                         const SceneLoadOptions& options)
+    : m_filename(std::move(filename)), m_options(options) {}
+
+vector<shared_ptr<Mesh>> SceneFileDataSource::fetch(
+    const vector<size_t>& sourceIndices) {
+    unsigned int importFlags = getAssimpImportFlags(m_options.importOptions);
+    if (m_options.useCache) {
+        auto cacheKey = createSceneCacheKey(
+            m_filename, importFlags,
+            getSceneCacheProcessingKey(m_options.importOptions));
+        vector<shared_ptr<Mesh>> fetched;
+        if (readSceneCacheGeometry(
+                getSceneCachePath(cacheKey, m_options.cacheDirectory),
+                cacheKey, sourceIndices, fetched))
+            return fetched;
+    }
+    Assimp::Importer importer;
+    const auto aiScene = importer.ReadFile(m_filename, importFlags);
+    if (!aiScene || aiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !aiScene->mRootNode) {
+        LOG(ERROR) << "Assimp: " << importer.GetErrorString();
+        return {};
+    }
+    map<string, int> boneMap;
+    vector<glm::mat4> boneMatrices;
+    // materials are left null, nothing here needs the GL thread
+    auto meshes = convertMeshesFromAssimp(aiScene, boneMap, boneMatrices,
+                                          m_options.importOptions);
+    vector<shared_ptr<Mesh>> fetched;
+    fetched.reserve(sourceIndices.size());
+    for (size_t index : sourceIndices) {
+        if (index >= meshes.size()) {
+            LOG(ERROR) << "mesh " << index << " is missing from "
+                       << m_filename;
+            return {};
+        }
+        fetched.push_back(meshes[index]);
+    }
+    return fetched;
+}
+
+// meshes can reload what the residency policy releases
+static void applyResidency(Scene& scene, const string& filename,
+                           const SceneLoadOptions& options) {
+    auto source = make_shared<SceneFileDataSource>(filename, options);
+    for (const auto& mesh : scene.getMeshes()) {
+        mesh->setDataSource(source);
+    }
+    scene.releaseCpuData(options.residency);
+}
+
+static void setVertexFormat(Scene& scene, VertexFormat format) {
+    for (const auto& mesh : scene.getMeshes()) {
+        mesh->vertexFormat = format;
+    }
+}
+
+Scene createSceneFromFile(const std::string& filename,
+                          const SceneLoadOptions& options) {
     using namespace Assimp;
+    if (options.streaming) {
+        Scene scene;
+        scene.modelName = fs::path(filename).stem().string();
+        if (options.useGeometryArena)
+            scene.geometryArena = make_shared<GeometryArena>();
+        scene.m_stream = make_shared<SceneStream>(filename, options);
+        return scene;
+    }
+    SceneCacheKey cacheKey;
+    string cachePath;
+    unsigned int importFlags = getAssimpImportFlags(options.importOptions);
+    if (options.useCache) {
+        cacheKey = createSceneCacheKey(
+            filename, importFlags,
+            getSceneCacheProcessingKey(options.importOptions));
+        cachePath = getSceneCachePath(cacheKey, options.cacheDirectory);
+        Scene scene;
+        if (readSceneCache(cachePath, cacheKey, scene)) {
+            LOG(INFO) << "Scene " << filename << " loaded from cache "
+                      << cachePath;
+            setVertexFormat(scene, options.vertexFormat);
+            if (options.useGeometryArena)
+                scene.geometryArena = make_shared<GeometryArena>();
+            scene.prepare();
+            applyResidency(scene, filename, options);
+            return scene;
+        }
+    }
     Importer importer;
-    const auto aiScene = importer.ReadFile(
-        filename,
-        aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenNormals |
-            aiProcess_GenNormals | aiProcess_CalcTangentSpace |
-            aiProcess_GenBoundingBoxes | aiProcess_LimitBoneWeights |
-            aiProcess_ImproveCacheLocality | aiProcess_OptimizeMeshes |
-            aiProcess_OptimizeGraph | aiProcess_SplitLargeMeshes |
-            aiProcess_RemoveRedundantMaterials);
-    string modelName = aiScene->mName.C_Str();
-    fs::path modelPath(filename);
-    fs::path modelDir = modelPath.parent_path();
+    const auto aiScene = importer.ReadFile(filename, importFlags);
     if (!aiScene || aiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
         !aiScene->mRootNode) {
         LOG(FATAL) << "Assimp: " << importer.GetErrorString() << endl;
     }
+    string modelName = aiScene->mName.C_Str();
+    fs::path modelPath(filename);
+    fs::path modelDir = modelPath.parent_path();
     Scene scene;
-    auto meshes = createMeshesFromAssimp(aiScene, scene.boneMap,
-                                         scene.boneMatrices, modelDir.string());
+    auto meshes =
+        createMeshesFromAssimp(aiScene, scene.boneMap, scene.boneMatrices,
+                               modelDir.string(), options.importOptions,
+                               nullptr, &scene.graph);
     scene.addMeshes(std::move(meshes));
     if (scene.modelName.empty()) {
         scene.modelName = modelPath.stem().string();
     }
-    scene.prepare();
 
     if (aiScene->HasAnimations()) {
         scene.animation = createAnimationFromAssimp(*aiScene, scene.boneMap,
                                                     scene.boneMatrices);
     }
+    if (options.useCache) {
+        writeSceneCache(cachePath, cacheKey, scene);
+    }
+    setVertexFormat(scene, options.vertexFormat);
+    if (options.useGeometryArena)
+        scene.geometryArena = make_shared<GeometryArena>();
+    scene.prepare();
+    applyResidency(scene, filename, options);
 
     return std::move(scene);
 }
@@ -0,0 +1,791 @@
+#include "loo/SceneCache.hpp"
+
+#include <glog/logging.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "loo/Animation.hpp"
+#include "loo/Scene.hpp"
+
+namespace loo {
+
+using namespace std;
+namespace fs = std::filesystem;
+
+static constexpr char SCENE_CACHE_MAGIC[8] = {'L', 'O', 'O', 'S',
+                                              'C', 'E', 'N', 'E'};
+// alignment of every array blob inside the cache file
+static constexpr size_t SCENE_CACHE_ALIGNMENT = 16;
+
+struct SceneCacheHeader {
+    char magic[8];
+    uint32_t version;
+    // sizeof(Vertex) when written, guards against layout changes
+    uint32_t vertexSize;
+    uint32_t importFlags;
+    uint32_t reserved;
+    uint64_t processingKey;
+    int64_t sourceMtime;
+    // detects truncated files
+    uint64_t fileSize;
+};
+
+// read-only memory mapping of a whole file
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    ~MappedFile();
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+   private:
+    const char* m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    HANDLE m_file{INVALID_HANDLE_VALUE};
+    HANDLE m_mapping{nullptr};
+#endif
+};
+
+MappedFile::MappedFile(const std::string& filename) {
+#ifdef _WIN32
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                         nullptr, OPEN_EXISTING,
+                         FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                         nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+        return;
+    m_mapping =
+        CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping)
+        return;
+    m_data = static_cast<const char*>(
+        MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_data)
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr != MAP_FAILED) {
+            m_data = static_cast<const char*>(ptr);
+            m_size = st.st_size;
+        }
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        CloseHandle(m_file);
+#else
+    if (m_data)
+        munmap(const_cast<char*>(m_data), m_size);
+#endif
+}
+
+class CacheWriter {
+   public:
+    explicit CacheWriter(std::ofstream& out) : m_out(out) {}
+
+    template <typename T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        writeBytes(&value, sizeof(T));
+    }
+    void writeString(const std::string& str) {
+        write<uint32_t>(str.size());
+        writeBytes(str.data(), str.size());
+    }
+    // arrays are aligned so that they can be used in place once mapped
+    template <typename T>
+    void writeArray(const std::vector<T>& arr) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        write<uint64_t>(arr.size());
+        align();
+        writeBytes(arr.data(), arr.size() * sizeof(T));
+    }
+    size_t offset() const { return m_offset; }
+
+   private:
+    void align() {
+        static const char zeros[SCENE_CACHE_ALIGNMENT]{};
+        writeBytes(zeros, (SCENE_CACHE_ALIGNMENT -
+                           m_offset % SCENE_CACHE_ALIGNMENT) %
+                              SCENE_CACHE_ALIGNMENT);
+    }
+    void writeBytes(const void* data, size_t size) {
+        m_out.write(static_cast<const char*>(data), size);
+        m_offset += size;
+    }
+    std::ofstream& m_out;
+    size_t m_offset{0};
+};
+
+// bounds checked reader over the mapped file, any out of range access marks
+// the reader as failed and returns zeroed values
+class CacheReader {
+   public:
+    CacheReader(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+    template <typename T>
+    T read() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value{};
+        if (reserve(sizeof(T))) {
+            memcpy(&value, m_data + m_offset, sizeof(T));
+            m_offset += sizeof(T);
+        }
+        return value;
+    }
+    std::string readString() {
+        auto size = read<uint32_t>();
+        if (!reserve(size))
+            return {};
+        std::string str(m_data + m_offset, size);
+        m_offset += size;
+        return str;
+    }
+    // element count of a following list whose entries take at least
+    // minEntrySize bytes
+    uint32_t readCount(size_t minEntrySize) {
+        auto count = read<uint32_t>();
+        if (!reserve(count * minEntrySize))
+            return 0;
+        return count;
+    }
+    // one bulk copy out of the mapping, no per element parsing
+    template <typename T>
+    void readArray(std::vector<T>& arr) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        auto count = read<uint64_t>();
+        m_offset += (SCENE_CACHE_ALIGNMENT - m_offset % SCENE_CACHE_ALIGNMENT) %
+                    SCENE_CACHE_ALIGNMENT;
+        if (m_offset > m_size || count > (m_size - m_offset) / sizeof(T)) {
+            m_ok = false;
+            return;
+        }
+        auto first = reinterpret_cast<const T*>(m_data + m_offset);
+        if (!m_skipArrays)
+            arr.assign(first, first + count);
+        m_offset += count * sizeof(T);
+    }
+    // readArray() then only moves past the arrays, leaving them empty
+    void setSkipArrays(bool skip) { m_skipArrays = skip; }
+    // for content that reads fine but makes no sense
+    void fail() { m_ok = false; }
+    bool ok() const { return m_ok; }
+
+   private:
+    bool reserve(size_t size) {
+        m_ok = m_ok && m_offset <= m_size && size <= m_size - m_offset;
+        return m_ok;
+    }
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset{0};
+    bool m_ok{true};
+    bool m_skipArrays{false};
+};
+
+static void writeMaterial(CacheWriter& writer, const BaseMaterialDesc& desc) {
+    writer.write(desc.bpWorkFlow);
+    writer.write(desc.baseColor);
+    writer.write(desc.metallic);
+    writer.write(desc.roughness);
+    writer.write(desc.emissiveFactor);
+    writer.write<uint32_t>(desc.flags);
+    for (const auto& texture : desc.textures) {
+        writer.writeString(texture.filename);
+        writer.write<uint32_t>(texture.options);
+        writer.write<uint32_t>(texture.wrap);
+    }
+}
+
+static BaseMaterialDesc readMaterial(CacheReader& reader) {
+    BaseMaterialDesc desc;
+    desc.bpWorkFlow = reader.read<BlinnPhongWorkFlow>();
+    desc.baseColor = reader.read<glm::vec4>();
+    desc.metallic = reader.read<float>();
+    desc.roughness = reader.read<float>();
+    desc.emissiveFactor = reader.read<glm::vec3>();
+    desc.flags = reader.read<uint32_t>();
+    for (auto& texture : desc.textures) {
+        texture.filename = reader.readString();
+        texture.options = reader.read<uint32_t>();
+        texture.wrap = reader.read<uint32_t>();
+    }
+    return desc;
+}
+
+static void writeNode(CacheWriter& writer, const AssimpNodeData& node) {
+    writer.writeString(node.name);
+    writer.write(node.transformation);
+    writer.write<uint32_t>(node.children.size());
+    for (const auto& child : node.children) {
+        writeNode(writer, child);
+    }
+}
+
+static AssimpNodeData readNode(CacheReader& reader) {
+    AssimpNodeData node;
+    node.name = reader.readString();
+    node.transformation = reader.read<glm::mat4>();
+    // a node takes at least its name length, matrix and children count
+    node.childrenCount = reader.readCount(sizeof(uint32_t) * 2 +
+                                          sizeof(glm::mat4));
+    node.children.reserve(node.childrenCount);
+    for (int i = 0; i < node.childrenCount && reader.ok(); i++) {
+        node.children.push_back(readNode(reader));
+    }
+    return node;
+}
+
+static inline uint64_t combineKey(uint64_t key, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    key = (key ^ bits) * 0x9E3779B97F4A7C15ull;
+    return key ^ (key >> 29);
+}
+
+uint64_t getSceneCacheProcessingKey(const MeshImportOptions& options) {
+    uint64_t key = 0;
+    if (options.weldVertices)
+        key = combineKey(key + 1, options.weldEpsilon);
+    if (options.generateLods) {
+        const auto& lod = options.lodOptions;
+        key = combineKey(key + 2, float(lod.maxLevels));
+        key = combineKey(key, lod.reduction);
+        key = combineKey(key, lod.minProgress);
+        key = combineKey(key, lod.maxError);
+    }
+    if (options.optimize) {
+        const auto& optimize = options.optimizeOptions;
+        key = combineKey(key + 3, float(optimize.vertexCache));
+        key = combineKey(key, float(optimize.overdraw));
+        key = combineKey(key, optimize.overdrawThreshold);
+        key = combineKey(key, float(optimize.vertexFetch));
+    }
+    if (options.buildMeshlets)
+        key = combineKey(key + 4, 0.0f);
+    if (options.instanceMeshes)
+        key = combineKey(key + 5, 0.0f);
+    return key;
+}
+
+SceneCacheKey createSceneCacheKey(const std::string& filename,
+                                  uint32_t importFlags,
+                                  uint64_t processingKey) {
+    SceneCacheKey key;
+    std::error_code ec;
+    fs::path sourcePath = fs::weakly_canonical(fs::absolute(filename), ec);
+    if (ec)
+        sourcePath = fs::absolute(filename);
+    key.sourcePath = sourcePath.string();
+    auto mtime = fs::last_write_time(sourcePath, ec);
+    key.sourceMtime = ec ? 0 : mtime.time_since_epoch().count();
+    key.importFlags = importFlags;
+    key.processingKey = processingKey;
+    return key;
+}
+
+std::string getSceneCachePath(const SceneCacheKey& key,
+                              const std::string& cacheDir) {
+    fs::path sourcePath(key.sourcePath);
+    fs::path dir =
+        cacheDir.empty() ? sourcePath.parent_path() : fs::path(cacheDir);
+    // models sharing a cache directory or loaded with different import flags
+    // get their own files
+    size_t keyHash = hash<string>()(key.sourcePath) ^
+                     (hash<uint32_t>()(key.importFlags) << 1) ^
+                     (hash<uint64_t>()(key.processingKey) << 2);
+    stringstream filename;
+    filename << sourcePath.stem().string() << "." << hex << keyHash
+             << ".looscene";
+    return (dir / filename.str()).string();
+}
+
+bool writeSceneCache(const std::string& cachePath, const SceneCacheKey& key,
+                     const Scene& scene) {
+    const auto& meshes = scene.getMeshes();
+    for (const auto& mesh : meshes) {
+        if (mesh->getResidency() != MeshResidency::Keep) {
+            LOG(WARNING) << "Scene cache: " << cachePath
+                         << " not written, mesh " << mesh->name
+                         << " released its CPU data";
+            return false;
+        }
+    }
+    // meshes share their materials, only write each description once
+    vector<shared_ptr<const BaseMaterialDesc>> materials;
+    unordered_map<const Material*, int32_t> materialIndices;
+    vector<int32_t> meshMaterials;
+    meshMaterials.reserve(meshes.size());
+    for (const auto& mesh : meshes) {
+        int32_t index = -1;
+        if (mesh->material) {
+            auto iter = materialIndices.find(mesh->material.get());
+            if (iter != materialIndices.end()) {
+                index = iter->second;
+            } else {
+                auto baseMaterial =
+                    dynamic_pointer_cast<BaseMaterial>(mesh->material);
+                if (!baseMaterial || !baseMaterial->desc) {
+                    LOG(WARNING) << "Scene cache: material of mesh "
+                                 << mesh->name
+                                 << " can't be serialized, skip caching";
+                    return false;
+                }
+                index = materials.size();
+                materials.push_back(baseMaterial->desc);
+                materialIndices[mesh->material.get()] = index;
+            }
+        }
+        meshMaterials.push_back(index);
+    }
+
+    std::error_code ec;
+    fs::create_directories(fs::path(cachePath).parent_path(), ec);
+    // write to a temporary file first so that an interrupted write never
+    // leaves a truncated cache behind
+    string tmpPath = cachePath + ".tmp";
+    {
+        ofstream out(tmpPath, ios::binary | ios::trunc);
+        if (!out) {
+            LOG(WARNING) << "Scene cache: can't open " << tmpPath;
+            return false;
+        }
+        SceneCacheHeader header{};
+        memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+        header.version = SCENE_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.importFlags = key.importFlags;
+        header.processingKey = key.processingKey;
+        header.sourceMtime = key.sourceMtime;
+
+        CacheWriter writer(out);
+        writer.write(header);
+        writer.writeString(key.sourcePath);
+        writer.writeString(scene.modelName);
+
+        writer.write<uint32_t>(materials.size());
+        for (const auto& desc : materials) {
+            writeMaterial(writer, *desc);
+        }
+
+        writer.write<uint32_t>(scene.boneMap.size());
+        for (const auto& [name, index] : scene.boneMap) {
+            writer.writeString(name);
+            writer.write<int32_t>(index);
+        }
+        writer.writeArray(scene.boneMatrices);
+
+        const auto& graph = scene.graph;
+        writer.write<uint32_t>(graph.size());
+        for (uint32_t node = 0; node < graph.size(); node++) {
+            writer.write<uint32_t>(graph.getParent(node));
+            writer.writeString(graph.getName(node));
+            writer.write(graph.getLocalMatrix(node));
+        }
+
+        writer.write<uint32_t>(meshes.size());
+        vector<MeshInstance> instances;
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const auto& mesh = *meshes[i];
+            writer.writeString(mesh.name);
+            writer.write<int32_t>(meshMaterials[i]);
+            // placements come from the graph, the matrices of meshes on a
+            // node may be moving on the GL thread meanwhile
+            writer.write(mesh.node < graph.size()
+                             ? graph.getWorldMatrix(mesh.node)
+                             : mesh.objectMatrix);
+            writer.write<uint32_t>(mesh.node);
+            instances.resize(mesh.instances.size());
+            for (size_t k = 0; k < instances.size(); k++) {
+                uint32_t node = mesh.instances[k].node;
+                instances[k].node = node;
+                instances[k].objectMatrix =
+                    node < graph.size() ? graph.getWorldMatrix(node)
+                                        : mesh.instances[k].objectMatrix;
+                instances[k].objectMatrixPrev = instances[k].objectMatrix;
+            }
+            writer.writeArray(instances);
+            writer.write(mesh.aabb.min);
+            writer.write(mesh.aabb.max);
+            writer.writeArray(mesh.vertices);
+            writer.writeArray(mesh.indices);
+            writer.writeArray(mesh.meshlets);
+            writer.writeArray(mesh.meshletBounds);
+            writer.writeArray(mesh.meshletVertices);
+            writer.writeArray(mesh.meshletTriangles);
+            writer.write<uint32_t>(mesh.lods.size());
+            for (const auto& lod : mesh.lods) {
+                writer.write(lod.error);
+                writer.writeArray(lod.indices);
+            }
+        }
+
+        writer.write<uint8_t>(scene.animation != nullptr);
+        if (scene.animation) {
+            const auto& animation = *scene.animation;
+            writer.write(animation.duration);
+            writer.write<int32_t>(animation.ticksPerSecond);
+            writeNode(writer, animation.rootNode);
+            writer.write<uint32_t>(animation.bones.size());
+            for (const auto& bone : animation.bones) {
+                writer.writeString(bone.name);
+                writer.write<int32_t>(bone.id);
+                writer.writeArray(bone.getPositionKeys());
+                writer.writeArray(bone.getRotationKeys());
+                writer.writeArray(bone.getScaleKeys());
+            }
+        }
+
+        header.fileSize = writer.offset();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!out) {
+            LOG(WARNING) << "Scene cache: failed writing " << tmpPath;
+            out.close();
+            fs::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    fs::rename(tmpPath, cachePath, ec);
+    if (ec) {
+        LOG(WARNING) << "Scene cache: can't move " << tmpPath << " to "
+                     << cachePath << ": " << ec.message();
+        fs::remove(tmpPath, ec);
+        return false;
+    }
+    LOG(INFO) << "Scene cache written to " << cachePath;
+    return true;
+}
+
+// the header and source path of the file behind reader match key
+static bool checkCacheHeader(CacheReader& reader, size_t fileSize,
+                             const std::string& cachePath,
+                             const SceneCacheKey& key) {
+    auto header = reader.read<SceneCacheHeader>();
+    if (!reader.ok() ||
+        memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SCENE_CACHE_VERSION ||
+        header.vertexSize != sizeof(Vertex) || header.fileSize != fileSize) {
+        LOG(INFO) << "Scene cache: " << cachePath << " is incompatible";
+        return false;
+    }
+    if (header.importFlags != key.importFlags ||
+        header.processingKey != key.processingKey ||
+        header.sourceMtime != key.sourceMtime ||
+        reader.readString() != key.sourcePath) {
+        LOG(INFO) << "Scene cache: " << cachePath << " is stale";
+        return false;
+    }
+    return true;
+}
+
+static bool areIndicesBelow(const vector<unsigned int>& indices,
+                            size_t count) {
+    for (unsigned int index : indices) {
+        if (index >= count)
+            return false;
+    }
+    return true;
+}
+
+// every index the mesh may be drawn or skinned with is in range, a cache
+// failing this would crash the upload or the shaders
+static bool isMeshValid(const Mesh& mesh, size_t boneCount) {
+    size_t vertexCount = mesh.vertices.size();
+    if (!areIndicesBelow(mesh.indices, vertexCount) ||
+        !areIndicesBelow(mesh.meshletVertices, vertexCount))
+        return false;
+    for (const auto& lod : mesh.lods) {
+        if (!areIndicesBelow(lod.indices, vertexCount))
+            return false;
+    }
+    if (mesh.meshletBounds.size() != mesh.meshlets.size())
+        return false;
+    for (const auto& meshlet : mesh.meshlets) {
+        if (uint64_t(meshlet.vertexOffset) + meshlet.vertexCount >
+                mesh.meshletVertices.size() ||
+            uint64_t(meshlet.triangleOffset) + meshlet.triangleCount * 3ull >
+                mesh.meshletTriangles.size())
+            return false;
+        const uint8_t* triangles =
+            mesh.meshletTriangles.data() + meshlet.triangleOffset;
+        for (size_t i = 0; i < meshlet.triangleCount * 3ull; i++) {
+            if (triangles[i] >= meshlet.vertexCount)
+                return false;
+        }
+    }
+    for (const auto& vertex : mesh.vertices) {
+        for (int k = 0; k < BONES_MAX_INFLUENCE; k++) {
+            if (vertex.boneIds[k] < -1 || vertex.boneIds[k] >= (int)boneCount)
+                return false;
+        }
+    }
+    return true;
+}
+
+// One mesh as written by writeSceneCache, without material; its arrays stay
+// empty when the reader skips them. Fails the reader when the mesh isn't
+// valid against boneCount bones.
+static shared_ptr<Mesh> readMesh(CacheReader& reader, size_t boneCount,
+                                 int32_t& materialIndex) {
+    auto name = reader.readString();
+    materialIndex = reader.read<int32_t>();
+    auto objectMatrix = reader.read<glm::mat4>();
+    auto node = reader.read<uint32_t>();
+    vector<MeshInstance> instances;
+    reader.readArray(instances);
+    auto aabbMin = reader.read<glm::vec3>();
+    auto aabbMax = reader.read<glm::vec3>();
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    reader.readArray(vertices);
+    reader.readArray(indices);
+    auto mesh = make_shared<Mesh>(std::move(vertices), std::move(indices),
+                                  nullptr, std::move(name), objectMatrix,
+                                  AABB(aabbMin, aabbMax));
+    mesh->node = node;
+    mesh->instances = std::move(instances);
+    reader.readArray(mesh->meshlets);
+    reader.readArray(mesh->meshletBounds);
+    reader.readArray(mesh->meshletVertices);
+    reader.readArray(mesh->meshletTriangles);
+    auto lodCount = reader.readCount(sizeof(float) + sizeof(uint64_t));
+    mesh->lods.resize(lodCount);
+    for (auto& lod : mesh->lods) {
+        lod.error = reader.read<float>();
+        reader.readArray(lod.indices);
+    }
+    if (reader.ok() && !isMeshValid(*mesh, boneCount))
+        reader.fail();
+    return mesh;
+}
+
+bool readSceneCache(const std::string& cachePath, const SceneCacheKey& key,
+                    Scene& scene) {
+    std::error_code ec;
+    if (!fs::exists(cachePath, ec))
+        return false;
+    MappedFile file(cachePath);
+    if (!file.data()) {
+        LOG(WARNING) << "Scene cache: can't map " << cachePath;
+        return false;
+    }
+    CacheReader reader(file.data(), file.size());
+    if (!checkCacheHeader(reader, file.size(), cachePath, key))
+        return false;
+    string modelName = reader.readString();
+
+    vector<BaseMaterialDesc> materialDescs(
+        reader.readCount(sizeof(BlinnPhongWorkFlow)));
+    for (auto& desc : materialDescs) {
+        desc = readMaterial(reader);
+    }
+
+    map<string, int> boneMap;
+    auto boneCount = reader.readCount(sizeof(uint32_t) + sizeof(int32_t));
+    for (uint32_t i = 0; i < boneCount; i++) {
+        auto name = reader.readString();
+        boneMap[name] = reader.read<int32_t>();
+    }
+    vector<glm::mat4> boneMatrices;
+    reader.readArray(boneMatrices);
+
+    SceneGraph graph;
+    auto nodeCount = reader.readCount(sizeof(uint32_t) * 2 + sizeof(glm::mat4));
+    for (uint32_t i = 0; i < nodeCount && reader.ok(); i++) {
+        auto parent = reader.read<uint32_t>();
+        auto name = reader.readString();
+        auto localMatrix = reader.read<glm::mat4>();
+        // addNode refuses anything out of depth first order
+        if (parent != SCENE_GRAPH_NO_NODE &&
+            (parent >= i || graph.getSubtreeEnd(parent) != i)) {
+            LOG(WARNING) << "Scene cache: " << cachePath << " is corrupted";
+            return false;
+        }
+        graph.addNode(parent, localMatrix, std::move(name));
+    }
+
+    auto meshCount = reader.readCount(sizeof(glm::mat4));
+    vector<shared_ptr<Mesh>> meshes;
+    vector<int32_t> meshMaterials;
+    meshes.reserve(meshCount);
+    meshMaterials.reserve(meshCount);
+    for (uint32_t i = 0; i < meshCount && reader.ok(); i++) {
+        int32_t materialIndex;
+        auto mesh = readMesh(reader, boneMatrices.size(), materialIndex);
+        if (materialIndex >= (int32_t)materialDescs.size())
+            materialIndex = -1;
+        meshMaterials.push_back(materialIndex);
+        // meshes are written in import order
+        mesh->sourceIndex = i;
+        if (mesh->node < graph.size())
+            graph.mergeLocalAABB(mesh->node, mesh->aabb);
+        else
+            mesh->node = SCENE_GRAPH_NO_NODE;
+        for (auto& instance : mesh->instances) {
+            if (instance.node < graph.size())
+                graph.mergeLocalAABB(instance.node, mesh->aabb);
+            else
+                instance.node = SCENE_GRAPH_NO_NODE;
+        }
+        meshes.push_back(std::move(mesh));
+    }
+
+    shared_ptr<Animation> animation;
+    if (reader.read<uint8_t>()) {
+        float duration = reader.read<float>();
+        int ticksPerSecond = reader.read<int32_t>();
+        auto rootNode = readNode(reader);
+        vector<Bone> bones;
+        auto animBoneCount = reader.readCount(sizeof(uint32_t) * 2);
+        bones.reserve(animBoneCount);
+        for (uint32_t i = 0; i < animBoneCount && reader.ok(); i++) {
+            auto name = reader.readString();
+            int id = reader.read<int32_t>();
+            vector<KeyPosition> positions;
+            vector<KeyRotation> rotations;
+            vector<KeyScale> scales;
+            reader.readArray(positions);
+            reader.readArray(rotations);
+            reader.readArray(scales);
+            bones.emplace_back(name, id, std::move(positions),
+                               std::move(rotations), std::move(scales));
+        }
+        animation = make_shared<Animation>(duration, ticksPerSecond,
+                                           std::move(bones),
+                                           std::move(rootNode), boneMap,
+                                           boneMatrices);
+    }
+    if (!reader.ok()) {
+        LOG(WARNING) << "Scene cache: " << cachePath << " is corrupted";
+        return false;
+    }
+
+    // textures are only loaded once the whole file has been validated
+    vector<shared_ptr<BaseMaterial>> materials;
+    materials.reserve(materialDescs.size());
+    for (const auto& desc : materialDescs) {
+        materials.push_back(createBaseMaterialFromDesc(desc));
+    }
+    for (size_t i = 0; i < meshes.size(); i++) {
+        if (meshMaterials[i] >= 0)
+            meshes[i]->material = materials[meshMaterials[i]];
+    }
+
+    scene.modelName = std::move(modelName);
+    scene.boneMap = std::move(boneMap);
+    scene.boneMatrices = std::move(boneMatrices);
+    scene.animation = std::move(animation);
+    graph.update();
+    scene.graph = std::move(graph);
+    scene.addMeshes(std::move(meshes));
+    return true;
+}
+
+bool readSceneCacheGeometry(const std::string& cachePath,
+                            const SceneCacheKey& key,
+                            const std::vector<size_t>& sourceIndices,
+                            std::vector<std::shared_ptr<Mesh>>& meshes) {
+    std::error_code ec;
+    if (!fs::exists(cachePath, ec))
+        return false;
+    MappedFile file(cachePath);
+    if (!file.data()) {
+        LOG(WARNING) << "Scene cache: can't map " << cachePath;
+        return false;
+    }
+    CacheReader reader(file.data(), file.size());
+    if (!checkCacheHeader(reader, file.size(), cachePath, key))
+        return false;
+    // everything before the meshes is parsed and dropped, the arrays of
+    // meshes not asked for are skipped over
+    reader.readString();
+    auto materialCount = reader.readCount(sizeof(BlinnPhongWorkFlow));
+    for (uint32_t i = 0; i < materialCount && reader.ok(); i++)
+        readMaterial(reader);
+    auto boneCount = reader.readCount(sizeof(uint32_t) + sizeof(int32_t));
+    for (uint32_t i = 0; i < boneCount && reader.ok(); i++) {
+        reader.readString();
+        reader.read<int32_t>();
+    }
+    // bone ids are checked against their count
+    vector<glm::mat4> boneMatrices;
+    reader.readArray(boneMatrices);
+    auto nodeCount = reader.readCount(sizeof(uint32_t) * 2 + sizeof(glm::mat4));
+    for (uint32_t i = 0; i < nodeCount && reader.ok(); i++) {
+        reader.read<uint32_t>();
+        reader.readString();
+        reader.read<glm::mat4>();
+    }
+
+    auto meshCount = reader.readCount(sizeof(glm::mat4));
+    // slot of every requested mesh in the result, -1 for the others
+    vector<int> slots(meshCount, -1);
+    uint32_t lastMesh = 0;
+    for (size_t k = 0; k < sourceIndices.size(); k++) {
+        if (sourceIndices[k] >= meshCount) {
+            LOG(WARNING) << "Scene cache: " << cachePath << " has no mesh "
+                         << sourceIndices[k];
+            return false;
+        }
+        slots[sourceIndices[k]] = k;
+        lastMesh = max(lastMesh, uint32_t(sourceIndices[k]));
+    }
+    vector<shared_ptr<Mesh>> loaded(sourceIndices.size());
+    for (uint32_t i = 0; i <= lastMesh && i < meshCount && reader.ok(); i++) {
+        int32_t materialIndex;
+        reader.setSkipArrays(slots[i] < 0);
+        auto mesh = readMesh(reader, boneMatrices.size(), materialIndex);
+        if (slots[i] >= 0) {
+            mesh->sourceIndex = i;
+            loaded[slots[i]] = std::move(mesh);
+        }
+    }
+    if (!reader.ok()) {
+        LOG(WARNING) << "Scene cache: " << cachePath << " is corrupted";
+        return false;
+    }
+    // an index asked for twice gets the same mesh
+    for (size_t k = 0; k < sourceIndices.size(); k++)
+        loaded[k] = loaded[slots[sourceIndices[k]]];
+    meshes = std::move(loaded);
+    return true;
+}
+
+}  // namespace loo
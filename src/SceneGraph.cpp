@@ -0,0 +1,129 @@
+#include "loo/SceneGraph.hpp"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+uint32_t SceneGraph::addNode(uint32_t parent, const mat4& localMatrix,
+                             std::string name) {
+    uint32_t node = m_parents.size();
+    CHECK(parent == SCENE_GRAPH_NO_NODE ||
+          (parent < node && m_subtreeEnds[parent] == node))
+        << "scene graph nodes must be added depth first";
+    m_parents.push_back(parent);
+    m_subtreeEnds.push_back(node + 1);
+    m_names.push_back(std::move(name));
+    m_localMatrices.push_back(localMatrix);
+    m_worldMatrices.push_back(localMatrix);
+    m_dirty.push_back(1);
+    m_dirtyNodes.push_back(node);
+    m_localAABBs.emplace_back();
+    m_worldAABBs.emplace_back();
+    m_aabbDirty.push_back(1);
+    // the ancestors ended right before the new node
+    for (uint32_t p = parent; p != SCENE_GRAPH_NO_NODE; p = m_parents[p]) {
+        m_subtreeEnds[p] = node + 1;
+        m_aabbDirty[p] = 1;
+    }
+    return node;
+}
+
+void SceneGraph::clear() {
+    m_parents.clear();
+    m_subtreeEnds.clear();
+    m_names.clear();
+    m_localMatrices.clear();
+    m_worldMatrices.clear();
+    m_dirty.clear();
+    m_dirtyNodes.clear();
+    m_changedRanges.clear();
+    m_localAABBs.clear();
+    m_worldAABBs.clear();
+    m_aabbDirty.clear();
+}
+
+uint32_t SceneGraph::findNode(const std::string& name) const {
+    auto iter = find(m_names.begin(), m_names.end(), name);
+    return iter == m_names.end() ? SCENE_GRAPH_NO_NODE
+                                 : uint32_t(iter - m_names.begin());
+}
+
+void SceneGraph::setLocalMatrix(uint32_t node, const mat4& localMatrix) {
+    m_localMatrices[node] = localMatrix;
+    if (!m_dirty[node]) {
+        m_dirty[node] = 1;
+        m_dirtyNodes.push_back(node);
+    }
+}
+
+const std::vector<SceneGraphRange>& SceneGraph::update() {
+    m_changedRanges.clear();
+    if (m_dirtyNodes.empty())
+        return m_changedRanges;
+    sort(m_dirtyNodes.begin(), m_dirtyNodes.end());
+    // end of the last recomputed subtree, dirty nodes inside it are done
+    uint32_t done = 0;
+    for (uint32_t root : m_dirtyNodes) {
+        if (root < done)
+            continue;
+        uint32_t end = m_subtreeEnds[root];
+        // parents come first, their world matrix is always final here
+        for (uint32_t node = root; node < end; node++) {
+            uint32_t parent = m_parents[node];
+            m_worldMatrices[node] =
+                parent == SCENE_GRAPH_NO_NODE
+                    ? m_localMatrices[node]
+                    : m_worldMatrices[parent] * m_localMatrices[node];
+            m_dirty[node] = 0;
+            m_aabbDirty[node] = 1;
+        }
+        markAABBDirty(m_parents[root]);
+        if (!m_changedRanges.empty() && m_changedRanges.back().end == root)
+            m_changedRanges.back().end = end;
+        else
+            m_changedRanges.push_back({root, end});
+        done = end;
+    }
+    m_dirtyNodes.clear();
+    return m_changedRanges;
+}
+
+// an ancestor of a dirty box is dirty as well, stop at the first one
+void SceneGraph::markAABBDirty(uint32_t node) const {
+    for (; node != SCENE_GRAPH_NO_NODE && !m_aabbDirty[node];
+         node = m_parents[node]) {
+        m_aabbDirty[node] = 1;
+    }
+}
+
+void SceneGraph::mergeLocalAABB(uint32_t node, const AABB& aabb) {
+    m_localAABBs[node].merge(aabb);
+    m_aabbDirty[node] = 1;
+    markAABBDirty(m_parents[node]);
+}
+
+const AABB& SceneGraph::getWorldAABB(uint32_t node) const {
+    if (!m_aabbDirty[node])
+        return m_worldAABBs[node];
+    // children come after their parent, walk the subtree backwards so they
+    // are up to date when their parent gathers them
+    for (uint32_t n = m_subtreeEnds[node]; n-- > node;) {
+        if (!m_aabbDirty[n])
+            continue;
+        AABB aabb = m_localAABBs[n].transform(m_worldMatrices[n]);
+        for (uint32_t child = n + 1; child < m_subtreeEnds[n];
+             child = m_subtreeEnds[child]) {
+            aabb.merge(m_worldAABBs[child]);
+        }
+        m_worldAABBs[n] = aabb;
+        m_aabbDirty[n] = 0;
+    }
+    return m_worldAABBs[node];
+}
+
+}  // namespace loo
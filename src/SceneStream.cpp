@@ -0,0 +1,249 @@
+#include "loo/SceneStream.hpp"
+
+#include <glog/logging.h>
+
+#include <assimp/scene.h>
+#include <algorithm>
+#include <assimp/Importer.hpp>
+#include <chrono>
+#include <filesystem>
+
+#include "loo/Animation.hpp"
+#include "loo/ThreadPool.hpp"
+
+namespace loo {
+
+using namespace std;
+namespace fs = std::filesystem;
+
+// bytes prepare() sends to the GPU for a mesh, roughly
+static size_t countUploadBytes(const Mesh& mesh) {
+    size_t indexCount = mesh.indices.size();
+    for (const auto& lod : mesh.lods)
+        indexCount += lod.indices.size();
+    return mesh.vertices.size() * sizeof(Vertex) +
+           indexCount * sizeof(unsigned int);
+}
+
+SceneStream::SceneStream(std::string filename, const SceneLoadOptions& options)
+    : m_filename(std::move(filename)),
+      m_options(options),
+      m_importFlags(getAssimpImportFlags(options.importOptions)),
+      m_dataSource(make_shared<SceneFileDataSource>(m_filename, options)) {
+    if (m_options.useCache) {
+        m_cacheKey = createSceneCacheKey(
+            m_filename, m_importFlags,
+            getSceneCacheProcessingKey(m_options.importOptions));
+        m_cachePath = getSceneCachePath(m_cacheKey, m_options.cacheDirectory);
+        // a cache hit is cheap, only the uploads are worth spreading
+        Scene cached;
+        if (readSceneCache(m_cachePath, m_cacheKey, cached)) {
+            LOG(INFO) << "Scene " << m_filename << " streamed from cache "
+                      << m_cachePath;
+            for (const auto& mesh : cached.getMeshes())
+                m_pending.push_back({mesh, -1});
+            m_boneMap = std::move(cached.boneMap);
+            m_boneMatrices = std::move(cached.boneMatrices);
+            m_graph = std::move(cached.graph);
+            m_animation = cached.animation;
+            m_modelName = cached.modelName;
+            m_loadedMeshCount = m_pending.size();
+            m_bonesReady = m_loaded = m_fromCache = true;
+            return;
+        }
+    }
+    m_loader = thread([this] { load(); });
+}
+
+SceneStream::~SceneStream() {
+    if (m_loader.joinable())
+        m_loader.join();
+}
+
+void SceneStream::load() {
+    auto start = chrono::steady_clock::now();
+    Assimp::Importer importer;
+    const auto aiScene = importer.ReadFile(m_filename, m_importFlags);
+    if (!aiScene || aiScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
+        !aiScene->mRootNode) {
+        LOG(ERROR) << "Assimp: " << importer.GetErrorString();
+        lock_guard<mutex> lock(m_mutex);
+        m_loaded = true;
+        return;
+    }
+    LOG(INFO) << "Scene " << m_filename << " parsed in "
+              << chrono::duration<double, milli>(chrono::steady_clock::now() -
+                                                 start)
+                     .count()
+              << "ms, streaming meshes";
+
+    // textures are loaded by the GL thread, only describe the materials here
+    fs::path modelDir = fs::path(m_filename).parent_path();
+    vector<BaseMaterialDesc> materialDescs;
+    materialDescs.reserve(aiScene->mNumMaterials);
+    for (unsigned int i = 0; i < aiScene->mNumMaterials; i++) {
+        materialDescs.push_back(
+            createBaseMaterialDescFromAssimp(aiScene->mMaterials[i], modelDir));
+    }
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_materialDescs = std::move(materialDescs);
+    }
+
+    map<string, int> boneMap;
+    vector<glm::mat4> boneMatrices;
+    SceneGraph graph;
+    bool bonesPublished = false;
+    convertMeshesFromAssimp(
+        aiScene, boneMap, boneMatrices, m_options.importOptions,
+        [&](const shared_ptr<Mesh>& mesh, unsigned int materialIndex) {
+            lock_guard<mutex> lock(m_mutex);
+            // the bone tables and the graph are final before the first mesh
+            if (!bonesPublished) {
+                m_boneMap = boneMap;
+                m_boneMatrices = boneMatrices;
+                m_graph = graph;
+                m_bonesReady = bonesPublished = true;
+            }
+            m_pending.push_back({mesh, int(materialIndex)});
+            m_loadedMeshCount++;
+        },
+        nullptr, &graph);
+
+    shared_ptr<Animation> animation;
+    if (aiScene->HasAnimations()) {
+        animation = createAnimationFromAssimp(*aiScene, boneMap, boneMatrices);
+    }
+    lock_guard<mutex> lock(m_mutex);
+    m_boneMap = std::move(boneMap);
+    m_boneMatrices = std::move(boneMatrices);
+    m_graph = std::move(graph);
+    m_bonesReady = true;
+    m_animation = std::move(animation);
+    m_modelName = aiScene->mName.C_Str();
+    m_loaded = true;
+}
+
+std::shared_ptr<Material> SceneStream::getMaterial(int index) {
+    if (index < 0 || index >= (int)m_materialDescs.size())
+        return nullptr;
+    if (m_materials.size() < m_materialDescs.size())
+        m_materials.resize(m_materialDescs.size());
+    // created on first use, meshes share them
+    if (!m_materials[index])
+        m_materials[index] = createBaseMaterialFromDesc(m_materialDescs[index]);
+    return m_materials[index];
+}
+
+bool SceneStream::update(Scene& scene, size_t byteBudget) {
+    if (m_finished)
+        return !releaseCachedMeshes();
+    vector<PendingMesh> batch;
+    bool loaded;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        size_t bytes = 0;
+        while (!m_pending.empty() && (batch.empty() || bytes < byteBudget)) {
+            bytes += countUploadBytes(*m_pending.front().mesh);
+            batch.push_back(std::move(m_pending.front()));
+            m_pending.pop_front();
+        }
+        if (!m_bonesHandedOver && m_bonesReady) {
+            // skinned meshes need the bone tables as soon as they show up
+            scene.boneMap = m_boneMap;
+            scene.boneMatrices = m_boneMatrices;
+            scene.graph = m_graph;
+            m_bonesHandedOver = true;
+        }
+        loaded = m_loaded && m_pending.empty();
+    }
+
+    // the cache is written from the uploaded meshes, they keep their data
+    // until then
+    bool releaseNow = !m_options.useCache || m_fromCache;
+    vector<shared_ptr<Mesh>> meshes;
+    meshes.reserve(batch.size());
+    for (auto& pending : batch) {
+        auto& mesh = pending.mesh;
+        if (pending.materialIndex >= 0)
+            mesh->material = getMaterial(pending.materialIndex);
+        mesh->vertexFormat = m_options.vertexFormat;
+        mesh->setDataSource(m_dataSource);
+        mesh->prepare(scene.geometryArena.get());
+        if (releaseNow) {
+            size_t bytes = mesh->releaseCpuData(m_options.residency);
+            m_residencyStats.meshCount += bytes != 0;
+            m_residencyStats.reclaimedBytes += bytes;
+        }
+        meshes.push_back(mesh);
+    }
+    m_uploadedMeshes.insert(m_uploadedMeshes.end(), meshes.begin(),
+                            meshes.end());
+    scene.addMeshes(std::move(meshes));
+
+    if (loaded)
+        finish(scene);
+    return !m_finished || !releaseCachedMeshes();
+}
+
+bool SceneStream::releaseCachedMeshes() {
+    if (m_cacheWritten && !m_cacheWritten->load())
+        return false;
+    for (const auto& mesh : m_cachedMeshes) {
+        size_t bytes = mesh->releaseCpuData(m_options.residency);
+        m_residencyStats.meshCount += bytes != 0;
+        m_residencyStats.reclaimedBytes += bytes;
+    }
+    m_cachedMeshes.clear();
+    m_cacheWritten.reset();
+    if (m_residencyStats.meshCount) {
+        LOG(INFO) << "released CPU data of " << m_residencyStats.meshCount
+                  << " streamed meshes, reclaimed "
+                  << m_residencyStats.reclaimedBytes / double(1 << 20)
+                  << "MB";
+        m_residencyStats = {};
+    }
+    return true;
+}
+
+void SceneStream::finish(Scene& scene) {
+    m_finished = true;
+    if (m_loader.joinable())
+        m_loader.join();
+    scene.boneMap = m_boneMap;
+    scene.boneMatrices = m_boneMatrices;
+    scene.animation = m_animation;
+    if (!m_modelName.empty())
+        scene.modelName = m_modelName;
+    LOG(INFO) << "Scene " << m_filename << " streamed, "
+              << m_uploadedMeshes.size() << " meshes";
+    if (!m_options.useCache || m_fromCache || m_uploadedMeshes.empty())
+        return;
+    // the geometry is left alone once uploaded, the cache is written off the
+    // GL thread from a snapshot of the scene; it shares the live meshes, so
+    // they are not passed through addMeshes(), which would reset their
+    // matrices to the load time graph
+    auto snapshot = make_shared<Scene>();
+    snapshot->modelName = scene.modelName;
+    snapshot->boneMap = m_boneMap;
+    snapshot->boneMatrices = m_boneMatrices;
+    snapshot->graph = m_graph;
+    snapshot->animation = m_animation;
+    // keep the import order, released meshes reload by their position
+    sort(m_uploadedMeshes.begin(), m_uploadedMeshes.end(),
+         [](const shared_ptr<Mesh>& a, const shared_ptr<Mesh>& b) {
+             return a->sourceIndex < b->sourceIndex;
+         });
+    if (m_options.residency != MeshResidency::Keep)
+        m_cachedMeshes = m_uploadedMeshes;
+    snapshot->m_meshes = std::move(m_uploadedMeshes);
+    m_cacheWritten = make_shared<atomic<bool>>(false);
+    ThreadPool::global().enqueue([snapshot, cachePath = m_cachePath,
+                                  cacheKey = m_cacheKey,
+                                  written = m_cacheWritten] {
+        writeSceneCache(cachePath, cacheKey, *snapshot);
+        written->store(true);
+    });
+}
+
+}  // namespace loo
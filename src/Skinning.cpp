@@ -0,0 +1,244 @@
+#include "loo/Skinning.hpp"
+#include <glog/logging.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include "loo/Mesh.hpp"
+#include "loo/ThreadPool.hpp"
+#include "loo/glError.hpp"
+#include "loo/simd.hpp"
+namespace loo {
+
+// vertices per parallelFor item
+static constexpr size_t SKINNING_GRAIN = 1024;
+
+SkinnedStreams getVertexStreams(void* base) {
+    char* bytes = static_cast<char*>(base);
+    SkinnedStreams streams;
+    streams.positions = bytes + offsetof(Vertex, position);
+    streams.normals = bytes + offsetof(Vertex, normal);
+    streams.tangents = bytes + offsetof(Vertex, tangent);
+    streams.stride = sizeof(Vertex);
+    return streams;
+}
+
+static inline float* getElement(void* stream, size_t stride, size_t i) {
+    return reinterpret_cast<float*>(static_cast<char*>(stream) + i * stride);
+}
+
+#if defined(LOO_SIMD_SSE)
+static inline __m128 multiplyAdd(__m128 a, __m128 b, __m128 c) {
+#if defined(LOO_SIMD_AVX2)
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+// columns of the weighted sum of the bone matrices of v, false without bones
+static inline bool blendBones(const Vertex& v, const glm::mat4* palette,
+                              __m128 columns[4]) {
+    bool skinned = false;
+    for (int c = 0; c < 4; c++)
+        columns[c] = _mm_setzero_ps();
+    for (int k = 0; k < 4; k++) {
+        int bone = v.boneIds[k];
+        if (bone < 0)
+            continue;
+        __m128 weight = _mm_set1_ps(v.boneWeights[k]);
+        for (int c = 0; c < 4; c++) {
+            columns[c] = multiplyAdd(_mm_loadu_ps(&palette[bone][c][0]),
+                                     weight, columns[c]);
+        }
+        skinned = true;
+    }
+    return skinned;
+}
+
+static inline __m128 transformDirection(const __m128 columns[4],
+                                        const glm::vec3& d) {
+    __m128 r = _mm_mul_ps(columns[0], _mm_set1_ps(d.x));
+    r = multiplyAdd(columns[1], _mm_set1_ps(d.y), r);
+    return multiplyAdd(columns[2], _mm_set1_ps(d.z), r);
+}
+
+// length of xyz in every lane
+static inline __m128 getLength3(__m128 v) {
+    __m128 sq = _mm_mul_ps(v, v);
+    __m128 sum = _mm_add_ss(
+        _mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))),
+        _mm_movehl_ps(sq, sq));
+    __m128 length = _mm_sqrt_ss(sum);
+    return _mm_shuffle_ps(length, length, 0);
+}
+
+static inline __m128 normalize3(__m128 v) {
+    __m128 length = getLength3(v);
+    __m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+    return _mm_and_ps(_mm_div_ps(v, length), valid);
+}
+
+static inline void storeXYZ(float* dst, __m128 v) {
+    _mm_storel_pi(reinterpret_cast<__m64*>(dst), v);
+    _mm_store_ss(dst + 2, _mm_movehl_ps(v, v));
+}
+#endif
+
+AABB skinVertices(const Vertex* vertices, size_t count,
+                  const glm::mat4* palette, const SkinnedStreams& output) {
+    size_t stride = output.stride ? output.stride : sizeof(glm::vec3);
+    AABB bounds;
+#if defined(LOO_SIMD_SSE)
+    __m128 min = _mm_set1_ps(bounds.min.x), max = _mm_set1_ps(bounds.max.x);
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& v = vertices[i];
+        __m128 columns[4];
+        if (!blendBones(v, palette, columns)) {
+            columns[0] = _mm_setr_ps(1.0f, 0.0f, 0.0f, 0.0f);
+            columns[1] = _mm_setr_ps(0.0f, 1.0f, 0.0f, 0.0f);
+            columns[2] = _mm_setr_ps(0.0f, 0.0f, 1.0f, 0.0f);
+            columns[3] = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+        __m128 position =
+            _mm_add_ps(transformDirection(columns, v.position), columns[3]);
+        min = _mm_min_ps(min, position);
+        max = _mm_max_ps(max, position);
+        if (output.positions)
+            storeXYZ(getElement(output.positions, stride, i), position);
+        if (output.normals) {
+            storeXYZ(getElement(output.normals, stride, i),
+                     normalize3(transformDirection(columns, v.normal)));
+        }
+        if (output.tangents) {
+            storeXYZ(getElement(output.tangents, stride, i),
+                     normalize3(transformDirection(columns, v.tangent)));
+        }
+    }
+    float lanes[4];
+    _mm_storeu_ps(lanes, min);
+    bounds.min = glm::vec3(lanes[0], lanes[1], lanes[2]);
+    _mm_storeu_ps(lanes, max);
+    bounds.max = glm::vec3(lanes[0], lanes[1], lanes[2]);
+#else
+    for (size_t i = 0; i < count; i++) {
+        const Vertex& v = vertices[i];
+        glm::mat4 blended(0.0f);
+        bool skinned = false;
+        for (int k = 0; k < 4; k++) {
+            if (v.boneIds[k] < 0)
+                continue;
+            blended = blended + palette[v.boneIds[k]] * v.boneWeights[k];
+            skinned = true;
+        }
+        if (!skinned)
+            blended = glm::mat4(1.0f);
+        glm::mat3 rotation(blended);
+        glm::vec3 position = rotation * v.position + glm::vec3(blended[3]);
+        bounds.merge(AABB(position, position));
+        auto store = [&](void* stream, const glm::vec3& value) {
+            float* dst = getElement(stream, stride, i);
+            dst[0] = value.x;
+            dst[1] = value.y;
+            dst[2] = value.z;
+        };
+        auto normalize = [](const glm::vec3& d) {
+            float length = glm::length(d);
+            return length > 0.0f ? d / length : glm::vec3(0.0f);
+        };
+        if (output.positions)
+            store(output.positions, position);
+        if (output.normals)
+            store(output.normals, normalize(rotation * v.normal));
+        if (output.tangents)
+            store(output.tangents, normalize(rotation * v.tangent));
+    }
+#endif
+    return bounds;
+}
+
+AABB skinMesh(const Mesh& mesh, const glm::mat4* palette,
+              const SkinnedStreams& output, ThreadPool* pool) {
+    size_t count = mesh.vertices.size();
+    size_t chunkCount = (count + SKINNING_GRAIN - 1) / SKINNING_GRAIN;
+    if (!pool)
+        pool = &ThreadPool::global();
+    size_t stride = output.stride ? output.stride : sizeof(glm::vec3);
+    // every chunk writes its own bounds and its own range of the streams
+    std::vector<AABB> chunkBounds(chunkCount);
+    pool->parallelFor(chunkCount, [&](size_t chunk) {
+        size_t first = chunk * SKINNING_GRAIN;
+        SkinnedStreams streams = output;
+        streams.stride = stride;
+        for (void** stream :
+             {&streams.positions, &streams.normals, &streams.tangents}) {
+            if (*stream)
+                *stream = static_cast<char*>(*stream) + first * stride;
+        }
+        chunkBounds[chunk] =
+            skinVertices(mesh.vertices.data() + first,
+                         std::min(SKINNING_GRAIN, count - first), palette,
+                         streams);
+    });
+    AABB bounds;
+    for (const auto& aabb : chunkBounds)
+        bounds.merge(aabb);
+    return bounds;
+}
+
+AABB skinMeshIntoBuffer(const Mesh& mesh, const glm::mat4* palette,
+                        GLuint buffer, size_t byteOffset, ThreadPool* pool) {
+#ifdef OGL_46
+    size_t size = mesh.vertices.size() * sizeof(Vertex);
+    if (!size)
+        return AABB();
+    // no invalidation, the other attributes stay
+    void* mapped =
+        glMapNamedBufferRange(buffer, byteOffset, size, GL_MAP_WRITE_BIT);
+    if (!mapped) {
+        logPossibleGLError();
+        return AABB();
+    }
+    AABB bounds = skinMesh(mesh, palette, getVertexStreams(mapped), pool);
+    glUnmapNamedBuffer(buffer);
+    return bounds;
+#else
+    NOT_IMPLEMENTED_RUNTIME();
+    return AABB();
+#endif
+}
+
+double measureSkinning(const Mesh& mesh, const std::vector<glm::mat4>& palette,
+                       size_t iterationCount) {
+    using namespace std::chrono;
+    size_t count = mesh.vertices.size();
+    for (const auto& v : mesh.vertices) {
+        for (int k = 0; k < 4; k++)
+            CHECK_LT(v.boneIds[k], (int)palette.size())
+                << "bone out of the palette";
+    }
+    std::vector<glm::vec3> positions(count), normals(count), tangents(count);
+    SkinnedStreams streams;
+    streams.positions = positions.data();
+    streams.normals = normals.data();
+    streams.tangents = tangents.data();
+    double rate = 0.0;
+    size_t hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t threadCount : {size_t(1), hardwareThreads}) {
+        ThreadPool pool(threadCount - 1);
+        AABB bounds;
+        auto start = steady_clock::now();
+        for (size_t iteration = 0; iteration < iterationCount; iteration++)
+            bounds = skinMesh(mesh, palette.data(), streams, &pool);
+        double seconds =
+            duration<double>(steady_clock::now() - start).count();
+        rate = seconds > 0.0 ? count * iterationCount / seconds : 0.0;
+        LOG(INFO) << "skinning of " << count << " vertices, " << threadCount
+                  << " threads: " << rate << " vertices/s, bounds volume "
+                  << bounds.getVolume();
+    }
+    return rate;
+}
+
+}  // namespace loo
@@ -0,0 +1,170 @@
+#include "loo/ThreadPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace loo {
+
+using namespace std;
+
+ThreadPool::ThreadPool(size_t workerCount) {
+    m_workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; i++) {
+        m_workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_condition.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_condition.wait(lock,
+                             [this] { return m_stop || !m_tasks.empty(); });
+            if (m_stop && m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+    if (m_workers.empty()) {
+        task();
+        return;
+    }
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+// [begin, end) packed in one word so that it changes with a single CAS,
+// loops are well below 2^32 items
+static uint64_t packRange(size_t begin, size_t end) {
+    return uint64_t(begin) << 32 | uint64_t(end);
+}
+static size_t getRangeBegin(uint64_t range) {
+    return range >> 32;
+}
+static size_t getRangeEnd(uint64_t range) {
+    return range & 0xffffffffu;
+}
+
+void ThreadPool::parallelFor(size_t count,
+                             const std::function<void(size_t)>& task,
+                             size_t grainSize) {
+    grainSize = std::max<size_t>(grainSize, 1);
+    size_t chunkCount = (count + grainSize - 1) / grainSize;
+    if (chunkCount == 0)
+        return;
+    if (chunkCount == 1 || m_workers.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            task(i);
+        }
+        return;
+    }
+    // Work stealing: every participant starts on its own slice of the range
+    // and takes grainSize items at a time from its front. Once dry it takes
+    // the back half of the largest slice left, or all of it when that is
+    // no more than a grain, so the calling thread can always finish the
+    // loop alone. Helpers may start after the loop is over, so the shared
+    // state outlives this call.
+    size_t participantCount = std::min(m_workers.size() + 1, chunkCount);
+    struct State {
+        explicit State(size_t n) : ranges(n) {}
+        vector<atomic<uint64_t>> ranges;
+        atomic<size_t> nextParticipant{0};
+        atomic<size_t> doneCount{0};
+        mutex doneMutex;
+        condition_variable doneCondition;
+    };
+    auto state = make_shared<State>(participantCount);
+    for (size_t p = 0; p < participantCount; p++) {
+        size_t begin = chunkCount * p / participantCount * grainSize;
+        size_t end = std::min(
+            count, chunkCount * (p + 1) / participantCount * grainSize);
+        state->ranges[p].store(packRange(begin, end));
+    }
+    auto run = [state, count, participantCount, grainSize, &task] {
+        size_t self = state->nextParticipant.fetch_add(1);
+        if (self >= participantCount)
+            return;
+        auto& own = state->ranges[self];
+        while (true) {
+            uint64_t range = own.load();
+            size_t begin = getRangeBegin(range), end = getRangeEnd(range);
+            if (begin < end) {
+                size_t last = std::min(end, begin + grainSize);
+                if (!own.compare_exchange_weak(range, packRange(last, end)))
+                    continue;
+                for (size_t i = begin; i < last; i++) {
+                    task(i);
+                }
+                size_t done = last - begin;
+                if (state->doneCount.fetch_add(done) + done == count) {
+                    lock_guard<mutex> lock(state->doneMutex);
+                    state->doneCondition.notify_all();
+                }
+                continue;
+            }
+            size_t victim = participantCount, victimSize = 0;
+            uint64_t victimRange = 0;
+            for (size_t p = 0; p < participantCount; p++) {
+                uint64_t other = state->ranges[p].load();
+                size_t otherBegin = getRangeBegin(other),
+                       otherEnd = getRangeEnd(other);
+                if (otherBegin < otherEnd &&
+                    otherEnd - otherBegin > victimSize) {
+                    victim = p;
+                    victimSize = otherEnd - otherBegin;
+                    victimRange = other;
+                }
+            }
+            // late helpers find no work left and never touch `task`
+            if (victim == participantCount)
+                return;
+            size_t otherBegin = getRangeBegin(victimRange),
+                   otherEnd = getRangeEnd(victimRange);
+            size_t middle = victimSize > grainSize
+                                ? otherBegin + victimSize / 2
+                                : otherBegin;
+            if (state->ranges[victim].compare_exchange_weak(
+                    victimRange, packRange(otherBegin, middle))) {
+                // nobody else writes an empty slice
+                own.store(packRange(middle, otherEnd));
+            }
+        }
+    };
+    for (size_t i = 0; i + 1 < participantCount; i++) {
+        enqueue(run);
+    }
+    run();
+    unique_lock<mutex> lock(state->doneMutex);
+    state->doneCondition.wait(
+        lock, [&] { return state->doneCount.load() == count; });
+}
+
+ThreadPool& ThreadPool::global() {
+    static ThreadPool pool(
+        std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+}  // namespace loo
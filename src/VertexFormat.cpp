@@ -0,0 +1,199 @@
+#include "loo/VertexFormat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <limits>
+
+#include "loo/Mesh.hpp"
+
+namespace loo {
+
+using namespace std;
+using namespace glm;
+
+static inline float signNotZero(float v) {
+    return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// "A Survey of Efficient Representations for Independent Unit Vectors"
+static vec2 octEncode(vec3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p = vec2((1.0f - std::abs(n.y)) * signNotZero(n.x),
+                 (1.0f - std::abs(n.x)) * signNotZero(n.y));
+    }
+    return p;
+}
+
+static inline int16_t packSnorm16(float v) {
+    return static_cast<int16_t>(
+        std::round(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+}
+
+static inline uint16_t packUnorm16(float v) {
+    return static_cast<uint16_t>(
+        std::round(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+}
+
+static inline uint8_t packUnorm8(float v) {
+    return static_cast<uint8_t>(
+        std::round(std::clamp(v, 0.0f, 1.0f) * 255.0f));
+}
+
+static void packUnitVector(vec3 v, int16_t out[2]) {
+    if (dot(v, v) == 0.0f) {
+        // no data, any unit vector will do
+        v = vec3(0.0f, 0.0f, 1.0f);
+    }
+    vec2 e = octEncode(v);
+    out[0] = packSnorm16(e.x);
+    out[1] = packSnorm16(e.y);
+}
+
+static void packBaseVertex(const Vertex& v, const PackedVertexStream& stream,
+                           bool unormTexCoord, PackedVertex& out) {
+    vec3 q = (v.position - stream.positionOffset) / stream.positionScale;
+    out.position[0] = packUnorm16(q.x);
+    out.position[1] = packUnorm16(q.y);
+    out.position[2] = packUnorm16(q.z);
+    float bitangentSign =
+        signNotZero(dot(cross(v.normal, v.tangent), v.bitangent));
+    out.position[3] = bitangentSign > 0.0f ? 65535 : 0;
+    packUnitVector(v.normal, out.normal);
+    packUnitVector(v.tangent, out.tangent);
+    for (int i = 0; i < 2; i++) {
+        out.texCoord[i] = unormTexCoord ? packUnorm16(v.texCoord[i])
+                                        : packHalf1x16(v.texCoord[i]);
+    }
+}
+
+bool packVertices(const std::vector<Vertex>& vertices,
+                  PackedVertexStream& stream) {
+    vec3 minPos(numeric_limits<float>::infinity()),
+        maxPos(-numeric_limits<float>::infinity());
+    bool unormTexCoord = true;
+    stream.skinned = false;
+    for (const auto& v : vertices) {
+        minPos = glm::min(minPos, v.position);
+        maxPos = glm::max(maxPos, v.position);
+        unormTexCoord = unormTexCoord && v.texCoord.x >= 0.0f &&
+                        v.texCoord.x <= 1.0f && v.texCoord.y >= 0.0f &&
+                        v.texCoord.y <= 1.0f;
+        for (int k = 0; k < 4; k++) {
+            if (v.boneIds[k] > 255)
+                return false;
+            stream.skinned = stream.skinned || v.boneIds[k] >= 0;
+        }
+    }
+    if (vertices.empty()) {
+        minPos = maxPos = vec3(0.0f);
+    }
+    stream.positionOffset = minPos;
+    stream.positionScale = maxPos - minPos;
+    for (int i = 0; i < 3; i++) {
+        // flat axis, every vertex quantizes to 0 anyway
+        if (!(stream.positionScale[i] > 0.0f))
+            stream.positionScale[i] = 1.0f;
+    }
+    stream.texCoordType = unormTexCoord ? GL_UNSIGNED_SHORT : GL_HALF_FLOAT;
+
+    if (stream.skinned) {
+        vector<PackedSkinnedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            const auto& v = vertices[i];
+            packBaseVertex(v, stream, unormTexCoord, packed[i].base);
+            for (int k = 0; k < 4; k++) {
+                bool used = v.boneIds[k] >= 0;
+                packed[i].boneIds[k] = used ? v.boneIds[k] : 0;
+                packed[i].boneWeights[k] =
+                    used ? packUnorm8(v.boneWeights[k]) : 0;
+            }
+        }
+        stream.stride = sizeof(PackedSkinnedVertex);
+        stream.data.resize(packed.size() * sizeof(PackedSkinnedVertex));
+        memcpy(stream.data.data(), packed.data(), stream.data.size());
+    } else {
+        vector<PackedVertex> packed(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            packBaseVertex(vertices[i], stream, unormTexCoord, packed[i]);
+        }
+        stream.stride = sizeof(PackedVertex);
+        stream.data.resize(packed.size() * sizeof(PackedVertex));
+        memcpy(stream.data.data(), packed.data(), stream.data.size());
+    }
+    return true;
+}
+
+void setupFullVertexAttributes() {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid*)offsetof(Vertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid*)(offsetof(Vertex, normal)));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid*)offsetof(Vertex, texCoord));
+    glEnableVertexAttribArray(2);
+
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid*)(offsetof(Vertex, tangent)));
+    glEnableVertexAttribArray(3);
+
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid*)offsetof(Vertex, bitangent));
+    glEnableVertexAttribArray(4);
+
+    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex),
+                           (GLvoid*)offsetof(Vertex, boneIds));
+    glEnableVertexAttribArray(5);
+
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (GLvoid*)offsetof(Vertex, boneWeights));
+    glEnableVertexAttribArray(6);
+}
+
+void setupPackedVertexAttributes(const PackedVertexStream& stream) {
+    GLsizei stride = stream.stride;
+    glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                          (GLvoid*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride,
+                          (GLvoid*)offsetof(PackedVertex, normal));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(
+        2, 2, stream.texCoordType,
+        stream.texCoordType == GL_UNSIGNED_SHORT ? GL_TRUE : GL_FALSE, stride,
+        (GLvoid*)offsetof(PackedVertex, texCoord));
+    glEnableVertexAttribArray(2);
+
+    glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, stride,
+                          (GLvoid*)offsetof(PackedVertex, tangent));
+    glEnableVertexAttribArray(3);
+
+    if (stream.skinned) {
+        glVertexAttribIPointer(
+            5, 4, GL_UNSIGNED_BYTE, stride,
+            (GLvoid*)offsetof(PackedSkinnedVertex, boneIds));
+        glEnableVertexAttribArray(5);
+
+        glVertexAttribPointer(
+            6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+            (GLvoid*)offsetof(PackedSkinnedVertex, boneWeights));
+        glEnableVertexAttribArray(6);
+    } else {
+        // disabled arrays read the current attribute value, (0, 0, 0, 1) by
+        // default, which is a weight of 1 on bone slot 3
+        glVertexAttribI4i(5, 0, 0, 0, 0);
+        glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+}  // namespace loo
@@ -0,0 +1,178 @@
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <random>
+#include <vector>
+
+#include "loo/BVH.hpp"
+#include "loo/ThreadPool.hpp"
+
+using namespace loo;
+using namespace std;
+using glm::vec3;
+
+struct Soup {
+    vector<vec3> positions;
+    vector<unsigned int> indices;
+};
+
+// small random triangles scattered through a box, plus a few long slivers
+static Soup makeSoup(size_t triangleCount, mt19937& random) {
+    uniform_real_distribution<float> place(-10.0f, 10.0f), size(-1.0f, 1.0f);
+    Soup soup;
+    for (size_t i = 0; i < triangleCount; i++) {
+        vec3 center(place(random), place(random), place(random));
+        float scale = i % 50 == 0 ? 8.0f : 1.0f;
+        for (int k = 0; k < 3; k++) {
+            soup.indices.push_back(soup.positions.size());
+            soup.positions.push_back(
+                center +
+                vec3(size(random), size(random), size(random)) * scale);
+        }
+    }
+    return soup;
+}
+
+// the test of MeshBVH, over every triangle
+static bool intersectTriangle(const vec3& a, const vec3& b, const vec3& c,
+                              const Ray& ray, float tMax, float& t, float& u,
+                              float& v) {
+    vec3 edge1 = b - a, edge2 = c - a;
+    vec3 p = glm::cross(ray.direction, edge2);
+    float det = glm::dot(edge1, p);
+    if (det == 0.0f)
+        return false;
+    float invDet = 1.0f / det;
+    vec3 s = ray.origin - a;
+    u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+    vec3 q = glm::cross(s, edge1);
+    v = glm::dot(ray.direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+    t = glm::dot(edge2, q) * invDet;
+    return t >= ray.tMin && t < tMax;
+}
+
+static RayHit intersectAll(const Soup& soup, const Ray& ray) {
+    RayHit hit;
+    for (size_t i = 0; i < soup.indices.size() / 3; i++) {
+        float t, u, v;
+        if (intersectTriangle(soup.positions[soup.indices[i * 3]],
+                              soup.positions[soup.indices[i * 3 + 1]],
+                              soup.positions[soup.indices[i * 3 + 2]], ray,
+                              std::min(ray.tMax, hit.t), t, u, v)) {
+            hit.t = t;
+            hit.u = u;
+            hit.v = v;
+            hit.triangle = i;
+        }
+    }
+    return hit;
+}
+
+// hits this close to an edge may go either way with another rounding
+static bool isNearEdge(const RayHit& hit) {
+    const float epsilon = 1e-4f;
+    return hit.u < epsilon || hit.v < epsilon ||
+           1.0f - hit.u - hit.v < epsilon;
+}
+
+static void checkTree(const BVH4& bvh, const vector<AABB>& bounds) {
+    const auto& order = bvh.getPrimitiveOrder();
+    CHECK_EQ(order.size(), bounds.size());
+    vector<uint32_t> sorted(order);
+    sort(sorted.begin(), sorted.end());
+    for (size_t i = 0; i < sorted.size(); i++)
+        CHECK_EQ(sorted[i], i) << "primitive missing or repeated";
+    for (const auto& node : bvh.getNodes()) {
+        for (int c = 0; c < 4; c++) {
+            if (!node.isLeaf(c))
+                continue;
+            CHECK_LE(node.count[c], BVH_MAX_LEAF_SIZE);
+            for (uint32_t i = node.child[c]; i < node.child[c] + node.count[c];
+                 i++) {
+                const AABB& box = bounds[order[i]];
+                CHECK(box.min.x >= node.minX[c] && box.max.x <= node.maxX[c] &&
+                      box.min.y >= node.minY[c] && box.max.y <= node.maxY[c] &&
+                      box.min.z >= node.minZ[c] && box.max.z <= node.maxZ[c])
+                    << "primitive outside its leaf box";
+            }
+        }
+    }
+}
+
+static void testAgainstBruteForce(size_t workerCount) {
+    mt19937 random(11);
+    Soup soup = makeSoup(3000, random);
+    ThreadPool pool(workerCount);
+    MeshBVH bvh;
+    bvh.build(soup.positions, soup.indices, &pool);
+    CHECK_EQ(bvh.countTriangles(), 3000u);
+
+    vector<AABB> bounds;
+    for (size_t i = 0; i < soup.positions.size(); i += 3) {
+        AABB box;
+        for (int k = 0; k < 3; k++)
+            box.merge(AABB(soup.positions[i + k], soup.positions[i + k]));
+        bounds.push_back(box);
+    }
+    BVH4 tree;
+    tree.build(bounds, &pool);
+    checkTree(tree, bounds);
+
+    uniform_real_distribution<float> place(-12.0f, 12.0f);
+    uniform_int_distribution<size_t> pick(0, soup.positions.size() - 1);
+    size_t hitCount = 0;
+    for (int i = 0; i < 4000; i++) {
+        Ray ray;
+        ray.origin = vec3(place(random), place(random), place(random));
+        // half of the rays aim at a vertex so that most of them hit
+        vec3 target = i % 2 ? soup.positions[pick(random)]
+                            : vec3(place(random), place(random), place(random));
+        ray.direction = target - ray.origin + vec3(1e-3f, 0.0f, 0.0f);
+        if (i % 3 == 0)
+            ray.tMax = 0.5f;
+        RayHit expected = intersectAll(soup, ray);
+        RayHit hit;
+        bool found = bvh.intersect(ray, hit);
+        CHECK_EQ(found, hit.isHit());
+        if (found != expected.isHit()) {
+            CHECK(isNearEdge(found ? hit : expected))
+                << "ray " << i << " disagrees with the brute force";
+            continue;
+        }
+        CHECK_EQ(bvh.occluded(ray), found) << "ray " << i;
+        if (!found)
+            continue;
+        hitCount++;
+        CHECK_LE(std::abs(hit.t - expected.t), 1e-5f * std::max(1.0f, hit.t))
+            << "ray " << i << " hit triangle " << hit.triangle
+            << " instead of " << expected.triangle;
+    }
+    // the comparison means little if hardly anything is hit
+    CHECK_GT(hitCount, 1000u);
+}
+
+static void testEmpty() {
+    MeshBVH bvh;
+    bvh.build(vector<vec3>(), vector<unsigned int>());
+    Ray ray;
+    ray.origin = vec3(0.0f);
+    ray.direction = vec3(0.0f, 0.0f, 1.0f);
+    RayHit hit;
+    CHECK(!bvh.intersect(ray, hit));
+    CHECK(!bvh.occluded(ray));
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    testAgainstBruteForce(0);
+    testAgainstBruteForce(3);
+    testEmpty();
+    LOG(INFO) << "BVH tests passed";
+    return 0;
+}
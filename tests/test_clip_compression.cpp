@@ -0,0 +1,187 @@
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <string>
+#include <vector>
+
+#include "loo/Animation.hpp"
+#include "loo/ClipCompression.hpp"
+
+using namespace loo;
+using namespace std;
+using glm::vec3;
+
+// worst rounding of the smallest three encoding as an angle, a little over
+// twice the length of the error of the four components
+static const float ROTATION_QUANTIZATION = 6e-5f;
+// float rounding of the sampling itself
+static const float EPSILON = 1e-5f;
+
+enum BoneKind { Constant, Linear, Wave, Flipping, Scaled, KindCount };
+
+// one key a tick over [0, keyCount), so that the key times are on a grid
+static Bone makeBone(int id, size_t keyCount) {
+    vector<KeyPosition> positions;
+    vector<KeyRotation> rotations;
+    vector<KeyScale> scales;
+    BoneKind kind = BoneKind(id % KindCount);
+    float phase = id * 0.37f;
+    vec3 axis = glm::normalize(vec3(0.3f, 0.8f, 0.5f));
+    for (size_t k = 0; k < keyCount; k++) {
+        float t = float(k);
+        vec3 position(1.0f, 2.0f, 3.0f);
+        float angle = 0.3f;
+        vec3 scale(1.0f);
+        if (kind == Linear) {
+            position += vec3(0.01f, -0.02f, 0.0f) * t;
+            angle += 0.001f * t;
+        } else if (kind != Constant) {
+            position = vec3(10.0f * sin(t * 0.01f + phase),
+                            5.0f * cos(t * 0.02f), 0.002f * t);
+            angle = 1.5f * sin(t * 0.005f + phase);
+        }
+        if (kind == Scaled)
+            scale = vec3(1.0f + 0.5f * sin(t * 0.03f), 1.0f, 2.0f);
+        glm::quat rotation = glm::angleAxis(angle, axis);
+        // the same rotation from the other hemisphere now and then
+        if (kind == Flipping && k % 7 == 0)
+            rotation = -rotation;
+        positions.push_back({position, t});
+        rotations.push_back({rotation, t});
+        scales.push_back({scale, t});
+    }
+    return Bone("bone" + to_string(id), id, std::move(positions),
+                std::move(rotations), std::move(scales));
+}
+
+static Animation makeAnimation(int boneCount, size_t keyCount) {
+    Animation animation;
+    animation.duration = float(keyCount - 1);
+    animation.ticksPerSecond = 30;
+    for (int i = 0; i < boneCount; i++)
+        animation.bones.push_back(makeBone(i, keyCount));
+    return animation;
+}
+
+// from the chord, acos of the dot product is off by far more than the
+// tolerances near a dot of 1
+static float getAngle(const glm::quat& a, const glm::quat& b) {
+    glm::quat nearest = glm::dot(a, b) < 0.0f ? -b : b;
+    float chord = glm::length(a - nearest);
+    return 4.0f * std::asin(std::min(chord * 0.5f, 1.0f));
+}
+
+static float getMaxDifference(const vec3& a, const vec3& b) {
+    vec3 d = glm::abs(a - b);
+    return std::max({d.x, d.y, d.z});
+}
+
+// every bone sampled off the keys as well, against tolerance plus the
+// rounding of its own quantization range
+static void checkErrors(const Animation& animation, const CompressedClip& clip,
+                        const ClipCompressionOptions& options) {
+    CHECK_EQ(clip.size(), animation.bones.size());
+    for (size_t i = 0; i < clip.size(); i++) {
+        const auto& tracks = clip.bones[i];
+        CHECK_EQ(tracks.name, animation.bones[i].name);
+        float translationBound = options.translationTolerance +
+                                 glm::length(tracks.translation.step) * 0.5f +
+                                 EPSILON;
+        float rotationBound =
+            options.rotationTolerance + ROTATION_QUANTIZATION + EPSILON;
+        float scaleBound = options.scaleTolerance +
+                           getMaxDifference(tracks.scale.step, vec3(0.0f)) *
+                               0.5f +
+                           EPSILON;
+        BoneCursor rawCursor, cursor;
+        // past both ends too, where both clamp
+        for (float time = -2.0f; time <= animation.duration + 2.0f;
+             time += 0.37f) {
+            BonePose raw = animation.bones[i].sample(time, rawCursor);
+            BonePose pose = clip.sample(i, time, cursor);
+            CHECK_LE(glm::length(raw.translation - pose.translation),
+                     translationBound)
+                << "bone " << i << " at " << time;
+            CHECK_LE(getAngle(raw.rotation, pose.rotation), rotationBound)
+                << "bone " << i << " at " << time;
+            CHECK_LE(getMaxDifference(raw.scale, pose.scale), scaleBound)
+                << "bone " << i << " at " << time;
+        }
+    }
+}
+
+static void testTolerances() {
+    const int boneCount = 20;
+    const size_t keyCount = 1500;
+    Animation animation = makeAnimation(boneCount, keyCount);
+    size_t previousKeyCount = 0;
+    for (float tolerance : {1e-4f, 1e-3f, 1e-2f}) {
+        ClipCompressionOptions options;
+        options.translationTolerance = tolerance;
+        options.rotationTolerance = tolerance;
+        options.scaleTolerance = tolerance;
+        CompressedClip clip(animation, options);
+        // the keys are on a grid of one tick
+        CHECK_EQ(clip.timeStep, 1.0f);
+        checkErrors(animation, clip, options);
+
+        ClipCompressionReport report = measureClipCompression(animation, clip);
+        CHECK_EQ(report.rawKeyCount, boneCount * keyCount * 3);
+        CHECK_LT(report.keyCount, report.rawKeyCount);
+        CHECK_GT(report.ratio, 1.0f);
+        // looser tolerances keep fewer keys
+        if (previousKeyCount)
+            CHECK_LT(report.keyCount, previousKeyCount);
+        previousKeyCount = report.keyCount;
+
+        for (size_t i = 0; i < clip.size(); i++) {
+            const auto& tracks = clip.bones[i];
+            BoneKind kind = BoneKind(i % KindCount);
+            // constant channels fold, straight ones keep their two ends
+            // once the tolerance is above the rounding of the keys
+            CHECK(tracks.scale.times.empty() == (kind != Scaled)) << i;
+            if (kind == Constant) {
+                CHECK(tracks.translation.times.empty()) << i;
+                CHECK(tracks.rotation.times.empty()) << i;
+            } else if (kind == Linear && tolerance >= 1e-3f) {
+                CHECK_EQ(tracks.translation.size(), 2u) << i;
+            }
+        }
+    }
+}
+
+// key times off any grid are quantized over the duration instead
+static void testIrregularTimes() {
+    vector<KeyPosition> positions;
+    vector<KeyRotation> rotations;
+    for (int k = 0; k < 200; k++) {
+        float t = k * 1.1f + (k % 3) * 0.013f;
+        positions.push_back({vec3(std::sin(t * 0.1f), 0.0f, 0.0f), t});
+        rotations.push_back(
+            {glm::angleAxis(t * 0.01f, vec3(0.0f, 1.0f, 0.0f)), t});
+    }
+    Animation animation;
+    animation.duration = positions.back().timeStamp;
+    animation.ticksPerSecond = 30;
+    animation.bones.emplace_back("bone", 0, positions, rotations,
+                                 vector<KeyScale>{{vec3(1.0f), 0.0f}});
+    ClipCompressionOptions options;
+    CompressedClip clip(animation, options);
+    CHECK_EQ(clip.timeStep, animation.duration / 65535.0f);
+    // a key moves by at most half a time step, a tiny fraction of a tick
+    ClipCompressionReport report = measureClipCompression(animation, clip);
+    CHECK_LE(report.maxTranslationError, 2e-3f);
+    CHECK_LE(report.maxRotationError, 1e-3f + ROTATION_QUANTIZATION);
+    CHECK_EQ(report.constantTrackCount, 1u);
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    testTolerances();
+    testIrregularTimes();
+    LOG(INFO) << "clip compression tests passed";
+    return 0;
+}
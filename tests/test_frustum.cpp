@@ -0,0 +1,125 @@
+#include <glog/logging.h>
+
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+#include "loo/Frustum.hpp"
+#include "loo/simd.hpp"
+
+using namespace loo;
+using namespace std;
+using glm::vec3;
+using glm::vec4;
+
+enum class Side { Inside, Outside, Unsure };
+
+// scalar reference in double, boxes within epsilon of a plane may go either
+// way with float rounding
+static Side classify(const Frustum& frustum, const AABB& aabb) {
+    const double epsilon = 1e-4;
+    vec3 center = aabb.getCenter(), extent = aabb.getDiagonal() * 0.5f;
+    bool unsure = false;
+    for (const auto& plane : frustum.planes) {
+        double distance = double(plane.x) * center.x +
+                          double(plane.y) * center.y +
+                          double(plane.z) * center.z + plane.w +
+                          std::abs(double(plane.x)) * extent.x +
+                          std::abs(double(plane.y)) * extent.y +
+                          std::abs(double(plane.z)) * extent.z;
+        if (distance < -epsilon)
+            return Side::Outside;
+        unsure |= distance < epsilon;
+    }
+    return unsure ? Side::Unsure : Side::Inside;
+}
+
+static vector<AABB> makeBoxes(size_t count, mt19937& random) {
+    uniform_real_distribution<float> place(-30.0f, 30.0f), size(0.0f, 4.0f);
+    vector<AABB> boxes;
+    for (size_t i = 0; i < count; i++) {
+        vec3 center(place(random), place(random), place(random));
+        vec3 extent(size(random), size(random), size(random));
+        // some flat and some empty boxes
+        if (i % 17 == 0)
+            extent.y = 0.0f;
+        if (i % 101 == 0)
+            extent = vec3(0.0f);
+        boxes.emplace_back(center - extent, center + extent);
+    }
+    return boxes;
+}
+
+static void checkCulling(const Frustum& frustum, const vector<AABB>& boxes) {
+    CullingBounds bounds;
+    bounds.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+        bounds.set(i, boxes[i]);
+    vector<uint32_t> visible;
+    size_t count = cullFrustum(frustum, bounds, visible);
+    CHECK_EQ(count, visible.size());
+    // increasing indices, each box reported as the reference says
+    size_t next = 0;
+    for (uint32_t index : visible) {
+        CHECK_LT(index, boxes.size());
+        CHECK_GE(index, next) << "indices out of order";
+        for (; next < index; next++) {
+            CHECK(classify(frustum, boxes[next]) != Side::Inside)
+                << "box " << next << " of " << boxes.size() << " culled";
+        }
+        CHECK(classify(frustum, boxes[index]) != Side::Outside)
+            << "box " << index << " of " << boxes.size() << " kept";
+        next = index + 1;
+    }
+    for (; next < boxes.size(); next++) {
+        CHECK(classify(frustum, boxes[next]) != Side::Inside)
+            << "box " << next << " of " << boxes.size() << " culled";
+    }
+    // the single box test agrees too
+    for (size_t i = 0; i < boxes.size(); i++) {
+        Side side = classify(frustum, boxes[i]);
+        if (side != Side::Unsure)
+            CHECK_EQ(frustum.intersects(boxes[i]), side == Side::Inside);
+    }
+}
+
+// random planes, unlike a camera frustum they need not enclose anything
+static Frustum makeRandomFrustum(mt19937& random) {
+    uniform_real_distribution<float> component(-1.0f, 1.0f),
+        offset(-10.0f, 30.0f);
+    Frustum frustum;
+    for (auto& plane : frustum.planes) {
+        vec3 normal(component(random), component(random), component(random));
+        plane = vec4(glm::normalize(normal + vec3(1e-3f)), offset(random));
+    }
+    return frustum;
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+#if defined(LOO_SIMD_AVX2)
+    LOG(INFO) << "testing the AVX2 path";
+#elif defined(LOO_SIMD_SSE)
+    LOG(INFO) << "testing the SSE path";
+#else
+    LOG(INFO) << "testing the scalar path";
+#endif
+    mt19937 random(5);
+    glm::mat4 view = glm::lookAt(vec3(0.0f, 5.0f, -20.0f), vec3(0.0f),
+                                 vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection =
+        glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 60.0f);
+    Frustum camera = Frustum::fromMatrix(projection * view);
+    // every tail length of the 8 and 4 wide loops
+    for (size_t count : {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 1003}) {
+        checkCulling(camera, makeBoxes(count, random));
+        for (int i = 0; i < 10; i++)
+            checkCulling(makeRandomFrustum(random), makeBoxes(count, random));
+    }
+    for (int i = 0; i < 50; i++)
+        checkCulling(makeRandomFrustum(random), makeBoxes(500, random));
+    LOG(INFO) << "frustum tests passed";
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include <glog/logging.h>
+
+#include <cmath>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "loo/Mesh.hpp"
+#include "loo/MeshLod.hpp"
+
+using namespace loo;
+using namespace std;
+
+// n x n quads of a gently curved sheet, with shared vertices or with three
+// of their own for every triangle
+static unique_ptr<Mesh> makeSheet(int n, bool welded) {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    auto makeVertex = [&](int x, int y) {
+        Vertex v{};
+        v.position = glm::vec3(
+            x, y, 0.01f * std::sin(x * 0.3f) * std::cos(y * 0.2f));
+        v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+        v.texCoord = glm::vec2(x, y) / float(n);
+        return v;
+    };
+    if (welded) {
+        for (int y = 0; y <= n; y++)
+            for (int x = 0; x <= n; x++)
+                vertices.push_back(makeVertex(x, y));
+    }
+    auto corner = [&](int x, int y) {
+        if (welded)
+            return (unsigned int)(y * (n + 1) + x);
+        vertices.push_back(makeVertex(x, y));
+        return (unsigned int)(vertices.size() - 1);
+    };
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            indices.insert(indices.end(), {corner(x, y), corner(x + 1, y),
+                                           corner(x + 1, y + 1)});
+            indices.insert(indices.end(), {corner(x, y), corner(x + 1, y + 1),
+                                           corner(x, y + 1)});
+        }
+    }
+    return make_unique<Mesh>(std::move(vertices), std::move(indices), nullptr,
+                             "sheet", glm::mat4(1.0f), AABB());
+}
+
+using Position = pair<float, float>;
+
+static set<Position> getBorder(const Mesh& mesh, int n,
+                               const vector<unsigned int>& indices) {
+    set<Position> border;
+    for (unsigned int index : indices) {
+        const glm::vec3& p = mesh.vertices[index].position;
+        if (p.x == 0.0f || p.y == 0.0f || p.x == n || p.y == n)
+            border.emplace(p.x, p.y);
+    }
+    return border;
+}
+
+static void checkLevels(const Mesh& mesh, int n,
+                        const MeshLodOptions& options) {
+    CHECK(!mesh.lods.empty()) << "sheet not simplified";
+    CHECK_LE(mesh.lods.size(), options.maxLevels);
+    set<Position> border = getBorder(mesh, n, mesh.indices);
+    size_t previousCount = mesh.indices.size();
+    float previousError = 0.0f;
+    for (const auto& lod : mesh.lods) {
+        CHECK_EQ(lod.indices.size() % 3, 0u);
+        CHECK_GT(lod.indices.size(), 0u);
+        CHECK_LE(lod.indices.size(), previousCount * options.minProgress);
+        CHECK_GE(lod.error, previousError);
+        if (options.maxError > 0.0f)
+            CHECK_LE(lod.error, options.maxError);
+        for (unsigned int index : lod.indices)
+            CHECK_LT(index, mesh.vertices.size());
+        // the border can't move, or neighbouring meshes would crack
+        CHECK(getBorder(mesh, n, lod.indices) == border)
+            << "border vertex collapsed";
+        previousCount = lod.indices.size();
+        previousError = lod.error;
+    }
+}
+
+static void testSheet(bool welded) {
+    const int n = 32;
+    auto mesh = makeSheet(n, welded);
+    MeshLodOptions options;
+    generateMeshLods(*mesh, options);
+    checkLevels(*mesh, n, options);
+
+    // an error limit ends the chain earlier
+    auto limited = makeSheet(n, welded);
+    MeshLodOptions strict;
+    strict.maxError = mesh->lods.back().error * 0.5f;
+    generateMeshLods(*limited, strict);
+    CHECK_LE(limited->lods.size(), mesh->lods.size());
+    for (const auto& lod : limited->lods)
+        CHECK_LE(lod.error, strict.maxError);
+}
+
+// duplicated vertices simplify as far as shared ones
+static void testUnweldedMatchesWelded() {
+    auto welded = makeSheet(16, true);
+    auto unwelded = makeSheet(16, false);
+    generateMeshLods(*welded);
+    generateMeshLods(*unwelded);
+    CHECK_EQ(unwelded->lods.size(), welded->lods.size());
+    for (size_t i = 0; i < welded->lods.size(); i++) {
+        CHECK_EQ(unwelded->lods[i].indices.size(),
+                 welded->lods[i].indices.size());
+    }
+}
+
+// a normal of its own on every triangle puts a seam on every edge
+static void testFlatShaded() {
+    auto mesh = makeSheet(8, false);
+    for (size_t i = 0; i < mesh->vertices.size(); i++)
+        mesh->vertices[i].normal = glm::vec3(0.0f, 0.0f, 1.0f + float(i / 3));
+    generateMeshLods(*mesh);
+    CHECK(mesh->lods.empty());
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    testSheet(true);
+    testSheet(false);
+    testUnweldedMatchesWelded();
+    testFlatShaded();
+    LOG(INFO) << "mesh LOD tests passed";
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "loo/Pose.hpp"
+#include "loo/simd.hpp"
+
+using namespace loo;
+using namespace std;
+
+// scalar reference in double, quaternions as x, y, z, w
+struct Quat {
+    double x, y, z, w;
+};
+
+static Quat multiply(const Quat& a, const Quat& b) {
+    return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+            a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+            a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+            a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+static double dot(const Quat& a, const Quat& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+static Quat normalize(const Quat& q) {
+    double length = std::sqrt(dot(q, q));
+    return {q.x / length, q.y / length, q.z / length, q.w / length};
+}
+
+// from the chord, which stays precise for tiny angles
+static double getAngle(const Quat& a, const Quat& b) {
+    double sign = dot(a, b) < 0.0 ? -1.0 : 1.0;
+    double dx = a.x - b.x * sign, dy = a.y - b.y * sign;
+    double dz = a.z - b.z * sign, dw = a.w - b.w * sign;
+    double chord = std::sqrt(dx * dx + dy * dy + dz * dz + dw * dw);
+    return 4.0 * std::asin(std::min(chord * 0.5, 1.0));
+}
+
+static Quat nlerp(const Quat& a, const Quat& b, double t) {
+    double sign = dot(a, b) < 0.0 ? -1.0 : 1.0;
+    return normalize({a.x + (b.x * sign - a.x) * t,
+                      a.y + (b.y * sign - a.y) * t,
+                      a.z + (b.z * sign - a.z) * t,
+                      a.w + (b.w * sign - a.w) * t});
+}
+
+static Quat slerp(const Quat& a, const Quat& b, double t) {
+    double d = dot(a, b), sign = d < 0.0 ? -1.0 : 1.0;
+    double angle = std::acos(std::min(std::abs(d), 1.0));
+    if (angle < 1e-9)
+        return a;
+    double wa = std::sin((1.0 - t) * angle) / std::sin(angle);
+    double wb = std::sin(t * angle) / std::sin(angle) * sign;
+    return {a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb,
+            a.w * wa + b.w * wb};
+}
+
+static Quat getRotation(const BonePose& pose) {
+    return {pose.rotation.x, pose.rotation.y, pose.rotation.z,
+            pose.rotation.w};
+}
+
+struct RandomPoses {
+    mt19937 random;
+    uniform_real_distribution<float> unit{0.0f, 1.0f};
+    normal_distribution<double> normal;
+
+    explicit RandomPoses(unsigned int seed) : random(seed) {}
+
+    Quat rotation() {
+        return normalize(
+            {normal(random), normal(random), normal(random), normal(random)});
+    }
+
+    BonePose pose() {
+        BonePose pose;
+        Quat q = rotation();
+        pose.rotation = glm::quat(q.w, q.x, q.y, q.z);
+        for (int k = 0; k < 3; k++) {
+            pose.translation[k] = unit(random) * 4.0f - 2.0f;
+            pose.scale[k] = 0.5f + unit(random);
+        }
+        return pose;
+    }
+
+    void fill(PoseBuffer& buffer, size_t count) {
+        buffer.resize(count);
+        for (size_t i = 0; i < count; i++)
+            buffer.setPose(i, pose());
+    }
+
+    vector<float> weights(size_t count) {
+        vector<float> result(count);
+        for (auto& w : result)
+            w = unit(random);
+        // both ends exactly
+        if (count > 1) {
+            result[0] = 0.0f;
+            result[1] = 1.0f;
+        }
+        return result;
+    }
+};
+
+static const double EPSILON = 1e-5;
+
+static void testBlend(size_t count, RandomPoses& random) {
+    PoseBuffer a, b, result;
+    random.fill(a, count);
+    random.fill(b, count);
+    result.resize(count);
+    vector<float> weights = random.weights(count);
+    blendPoses(a.getArrays(), b.getArrays(), weights.data(), count,
+               result.getArrays());
+    for (size_t i = 0; i < count; i++) {
+        BonePose from = a.getPose(i), to = b.getPose(i),
+                 pose = result.getPose(i);
+        double w = weights[i];
+        for (int k = 0; k < 3; k++) {
+            CHECK_NEAR(pose.translation[k],
+                       from.translation[k] +
+                           (to.translation[k] - from.translation[k]) * w,
+                       EPSILON);
+            CHECK_NEAR(pose.scale[k],
+                       from.scale[k] + (to.scale[k] - from.scale[k]) * w,
+                       EPSILON);
+        }
+        Quat expected = nlerp(getRotation(from), getRotation(to), w);
+        CHECK_LE(getAngle(getRotation(pose), expected), EPSILON)
+            << "bone " << i << " of " << count;
+    }
+
+    // in place, into the first input
+    blendPoses(a.getArrays(), b.getArrays(), weights.data(), count,
+               a.getArrays());
+    for (size_t i = 0; i < count; i++) {
+        BonePose inPlace = a.getPose(i), pose = result.getPose(i);
+        CHECK(inPlace.translation == pose.translation) << i;
+        CHECK(inPlace.scale == pose.scale) << i;
+        CHECK_EQ(getAngle(getRotation(inPlace), getRotation(pose)), 0.0);
+    }
+}
+
+static void testSlerp(size_t count, RandomPoses& random) {
+    PoseBuffer a, b, result;
+    random.fill(a, count);
+    random.fill(b, count);
+    result.resize(count);
+    vector<float> factors = random.weights(count);
+    BonePoseArrays from = a.getArrays(), to = b.getArrays(),
+                   out = result.getArrays();
+    slerpQuats(from.rotation, to.rotation, factors.data(), count,
+               out.rotation);
+    for (size_t i = 0; i < count; i++) {
+        Quat expected = slerp(getRotation(a.getPose(i)),
+                              getRotation(b.getPose(i)), factors[i]);
+        // the fitted correction promises about 1e-3 radians
+        CHECK_LE(getAngle(getRotation(result.getPose(i)), expected), 1.5e-3)
+            << "bone " << i << " of " << count;
+    }
+}
+
+static void testAdd(size_t count, RandomPoses& random) {
+    PoseBuffer base, additive, reference, inverseReference, result;
+    random.fill(base, count);
+    random.fill(additive, count);
+    random.fill(reference, count);
+    inverseReference.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        BonePose pose = reference.getPose(i);
+        pose.translation = -pose.translation;
+        pose.rotation = glm::conjugate(pose.rotation);
+        pose.scale = 1.0f / pose.scale;
+        inverseReference.setPose(i, pose);
+    }
+    result.resize(count);
+    vector<float> weights = random.weights(count);
+    addPoses(base.getArrays(), additive.getArrays(),
+             inverseReference.getArrays(), weights.data(), count,
+             result.getArrays());
+    for (size_t i = 0; i < count; i++) {
+        BonePose b = base.getPose(i), a = additive.getPose(i),
+                 r = reference.getPose(i), pose = result.getPose(i);
+        double w = weights[i];
+        for (int k = 0; k < 3; k++) {
+            CHECK_NEAR(pose.translation[k],
+                       b.translation[k] +
+                           w * (a.translation[k] - r.translation[k]),
+                       EPSILON);
+            CHECK_NEAR(pose.scale[k],
+                       b.scale[k] *
+                           (1.0 + w * (double(a.scale[k]) / r.scale[k] - 1.0)),
+                       1e-4);
+        }
+        // base times the difference scaled from the identity on the
+        // shortest path
+        Quat inverse = getRotation(r);
+        inverse = {-inverse.x, -inverse.y, -inverse.z, inverse.w};
+        Quat difference = multiply(inverse, getRotation(a));
+        Quat expected = multiply(getRotation(b),
+                                 nlerp({0.0, 0.0, 0.0, 1.0}, difference, w));
+        CHECK_LE(getAngle(getRotation(pose), expected), 1e-4)
+            << "bone " << i << " of " << count;
+    }
+
+    // at full weight against a reference equal to base the layer replaces it
+    vector<float> ones(count, 1.0f);
+    for (size_t i = 0; i < count; i++) {
+        BonePose pose = base.getPose(i);
+        pose.translation = -pose.translation;
+        pose.rotation = glm::conjugate(pose.rotation);
+        pose.scale = 1.0f / pose.scale;
+        inverseReference.setPose(i, pose);
+    }
+    addPoses(base.getArrays(), additive.getArrays(),
+             inverseReference.getArrays(), ones.data(), count,
+             base.getArrays());
+    for (size_t i = 0; i < count; i++) {
+        CHECK_LE(getAngle(getRotation(base.getPose(i)),
+                          getRotation(additive.getPose(i))),
+                 1e-4)
+            << "bone " << i << " of " << count;
+    }
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+#if defined(LOO_SIMD_AVX2)
+    LOG(INFO) << "testing the AVX2 path";
+#elif defined(LOO_SIMD_SSE)
+    LOG(INFO) << "testing the SSE path";
+#else
+    LOG(INFO) << "testing the scalar path";
+#endif
+    RandomPoses random(3);
+    // every tail length of the 8 and 4 wide loops
+    for (size_t count : {0, 1, 3, 4, 5, 7, 8, 9, 13, 16, 31, 200}) {
+        testBlend(count, random);
+        testSlerp(count, random);
+        testAdd(count, random);
+    }
+    LOG(INFO) << "pose tests passed";
+    return 0;
+}
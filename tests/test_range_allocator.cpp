@@ -0,0 +1,109 @@
+#include <glog/logging.h>
+
+#include <random>
+#include <vector>
+
+#include "loo/GeometryArena.hpp"
+
+using namespace loo;
+using namespace std;
+
+static void testFirstFit() {
+    RangeAllocator allocator;
+    allocator.grow(100);
+    size_t a, b, c;
+    CHECK(allocator.allocate(10, 1, a));
+    CHECK(allocator.allocate(20, 16, b));
+    CHECK(allocator.allocate(30, 1, c));
+    CHECK_EQ(a, 0u);
+    CHECK_EQ(b, 16u);
+    // the gap left by the alignment of b comes first
+    CHECK_EQ(c, 36u);
+    size_t gap;
+    CHECK(allocator.allocate(6, 1, gap));
+    CHECK_EQ(gap, 10u);
+    CHECK_EQ(allocator.getUsed(), 66u);
+    size_t tooLarge;
+    CHECK(!allocator.allocate(35, 1, tooLarge));
+
+    // b and its neighbours merge back into one range
+    allocator.free(b, 20);
+    allocator.free(gap, 6);
+    allocator.free(a, 10);
+    size_t merged;
+    CHECK(allocator.allocate(36, 1, merged));
+    CHECK_EQ(merged, 0u);
+}
+
+static void testGrow() {
+    RangeAllocator allocator;
+    allocator.grow(64);
+    size_t a, b;
+    CHECK(allocator.allocate(48, 1, a));
+    CHECK(!allocator.allocate(32, 1, b));
+    // the new tail merges with the 16 bytes left free
+    allocator.grow(80);
+    CHECK_EQ(allocator.getCapacity(), 80u);
+    CHECK(allocator.allocate(32, 1, b));
+    CHECK_EQ(b, 48u);
+    // shrinking is ignored
+    allocator.grow(10);
+    CHECK_EQ(allocator.getCapacity(), 80u);
+}
+
+// random allocations checked against a map of the bytes in use
+static void testRandom() {
+    const size_t capacity = 1 << 14;
+    RangeAllocator allocator;
+    allocator.grow(capacity);
+    vector<bool> used(capacity, false);
+    struct Range {
+        size_t offset, size;
+    };
+    vector<Range> live;
+    mt19937 random(7);
+    size_t usedBytes = 0;
+    for (int step = 0; step < 20000; step++) {
+        if (live.empty() || random() % 3 != 0) {
+            size_t size = 1 + random() % 256;
+            size_t alignment = size_t(1) << (random() % 5);
+            size_t offset;
+            if (!allocator.allocate(size, alignment, offset))
+                continue;
+            CHECK_EQ(offset % alignment, 0u);
+            CHECK_LE(offset + size, capacity);
+            for (size_t i = offset; i < offset + size; i++) {
+                CHECK(!used[i]) << "byte " << i << " handed out twice";
+                used[i] = true;
+            }
+            live.push_back({offset, size});
+            usedBytes += size;
+        } else {
+            size_t k = random() % live.size();
+            Range range = live[k];
+            live[k] = live.back();
+            live.pop_back();
+            allocator.free(range.offset, range.size);
+            for (size_t i = range.offset; i < range.offset + range.size; i++)
+                used[i] = false;
+            usedBytes -= range.size;
+        }
+        CHECK_EQ(allocator.getUsed(), usedBytes);
+    }
+    for (const auto& range : live)
+        allocator.free(range.offset, range.size);
+    CHECK_EQ(allocator.getUsed(), 0u);
+    // everything merged back into a single range
+    size_t offset;
+    CHECK(allocator.allocate(capacity, 1, offset));
+    CHECK_EQ(offset, 0u);
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    testFirstFit();
+    testGrow();
+    testRandom();
+    LOG(INFO) << "range allocator tests passed";
+    return 0;
+}
@@ -0,0 +1,189 @@
+#include <glog/logging.h>
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <memory>
+#include <vector>
+
+#include "loo/Mesh.hpp"
+#include "loo/MeshLod.hpp"
+#include "loo/Meshlet.hpp"
+#include "loo/Scene.hpp"
+#include "loo/SceneCache.hpp"
+
+using namespace loo;
+using namespace std;
+namespace fs = std::filesystem;
+
+// n x n quads in the xy plane
+static shared_ptr<Mesh> makeGrid(int n, const string& name) {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    for (int y = 0; y <= n; y++) {
+        for (int x = 0; x <= n; x++) {
+            Vertex v{};
+            v.position = glm::vec3(x, y, 0.0f);
+            v.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            v.texCoord = glm::vec2(x, y) / float(n);
+            vertices.push_back(v);
+        }
+    }
+    for (int y = 0; y < n; y++) {
+        for (int x = 0; x < n; x++) {
+            unsigned int i = y * (n + 1) + x;
+            indices.insert(indices.end(), {i, i + 1, i + n + 2});
+            indices.insert(indices.end(), {i, i + n + 2, i + n + 1});
+        }
+    }
+    AABB aabb(glm::vec3(0.0f), glm::vec3(n, n, 0.0f));
+    return make_shared<Mesh>(std::move(vertices), std::move(indices), nullptr,
+                             name, glm::mat4(1.0f), aabb);
+}
+
+struct CacheFixture {
+    fs::path dir = fs::temp_directory_path() / "loo_test_scene_cache";
+    string source = (dir / "model.obj").string();
+    SceneCacheKey key;
+    string path;
+
+    CacheFixture() {
+        fs::create_directories(dir);
+        // the key only needs the file to exist for its write time
+        ofstream(source) << "# placeholder\n";
+        key = createSceneCacheKey(source, 0x1234, 42);
+        path = getSceneCachePath(key);
+    }
+    ~CacheFixture() {
+        std::error_code ec;
+        fs::remove_all(dir, ec);
+    }
+};
+
+// two meshes on a two node graph, the second one instanced on both nodes
+static Scene makeScene() {
+    Scene scene;
+    scene.modelName = "model";
+    uint32_t root = scene.graph.addNode(
+        SCENE_GRAPH_NO_NODE,
+        glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 2.0f, 3.0f)), "root");
+    uint32_t child = scene.graph.addNode(
+        root, glm::scale(glm::mat4(1.0f), glm::vec3(2.0f)), "child");
+    scene.graph.update();
+    auto grid = makeGrid(16, "grid");
+    grid->node = root;
+    buildMeshlets(*grid, 32, 16);
+    generateMeshLods(*grid);
+    auto quad = makeGrid(2, "quad");
+    quad->node = child;
+    quad->sourceIndex = 1;
+    MeshInstance instance;
+    instance.node = root;
+    quad->instances.push_back(instance);
+    scene.addMeshes({grid, quad});
+    return scene;
+}
+
+static void checkSameGeometry(const Mesh& a, const Mesh& b) {
+    CHECK(a.vertices == b.vertices) << a.name;
+    CHECK(a.indices == b.indices) << a.name;
+    CHECK_EQ(a.meshlets.size(), b.meshlets.size()) << a.name;
+    CHECK(a.meshletVertices == b.meshletVertices) << a.name;
+    CHECK(a.meshletTriangles == b.meshletTriangles) << a.name;
+    CHECK_EQ(a.lods.size(), b.lods.size()) << a.name;
+    for (size_t i = 0; i < a.lods.size(); i++) {
+        CHECK(a.lods[i].indices == b.lods[i].indices) << a.name;
+        CHECK_EQ(a.lods[i].error, b.lods[i].error) << a.name;
+    }
+}
+
+static void testRoundTrip() {
+    CacheFixture fixture;
+    Scene scene = makeScene();
+    CHECK(!scene.getMeshes()[0]->meshlets.empty());
+    CHECK(!scene.getMeshes()[0]->lods.empty());
+    CHECK(writeSceneCache(fixture.path, fixture.key, scene));
+
+    Scene loaded;
+    CHECK(readSceneCache(fixture.path, fixture.key, loaded));
+    CHECK_EQ(loaded.modelName, scene.modelName);
+    CHECK_EQ(loaded.graph.size(), scene.graph.size());
+    const auto& meshes = scene.getMeshes();
+    const auto& loadedMeshes = loaded.getMeshes();
+    CHECK_EQ(loadedMeshes.size(), meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const auto& mesh = *meshes[i];
+        const auto& copy = *loadedMeshes[i];
+        CHECK_EQ(copy.name, mesh.name);
+        CHECK_EQ(copy.sourceIndex, i);
+        CHECK_EQ(copy.node, mesh.node);
+        CHECK_EQ(copy.instances.size(), mesh.instances.size());
+        for (size_t k = 0; k < mesh.countInstances(); k++) {
+            CHECK_EQ(copy.getInstanceNode(k), mesh.getInstanceNode(k));
+            CHECK(copy.getInstanceMatrix(k) == mesh.getInstanceMatrix(k));
+        }
+        checkSameGeometry(mesh, copy);
+    }
+
+    // geometry alone, in the order asked for
+    vector<shared_ptr<Mesh>> geometry;
+    CHECK(readSceneCacheGeometry(fixture.path, fixture.key, {1, 0, 1},
+                                 geometry));
+    CHECK_EQ(geometry.size(), 3u);
+    checkSameGeometry(*meshes[1], *geometry[0]);
+    checkSameGeometry(*meshes[0], *geometry[1]);
+    checkSameGeometry(*meshes[1], *geometry[2]);
+    CHECK(!geometry[0]->material);
+    CHECK(!readSceneCacheGeometry(fixture.path, fixture.key, {2}, geometry));
+}
+
+static void testStaleKey() {
+    CacheFixture fixture;
+    Scene scene = makeScene();
+    CHECK(writeSceneCache(fixture.path, fixture.key, scene));
+    SceneCacheKey other = fixture.key;
+    other.processingKey++;
+    Scene loaded;
+    CHECK(!readSceneCache(fixture.path, other, loaded));
+    other = fixture.key;
+    other.importFlags ^= 1;
+    CHECK(!readSceneCache(fixture.path, other, loaded));
+}
+
+// a cache which reads fine but would draw out of bounds is rejected
+static void checkRejected(const function<void(Mesh&)>& corrupt) {
+    CacheFixture fixture;
+    Scene scene = makeScene();
+    corrupt(*scene.getMeshes()[0]);
+    CHECK(writeSceneCache(fixture.path, fixture.key, scene));
+    Scene loaded;
+    CHECK(!readSceneCache(fixture.path, fixture.key, loaded));
+    vector<shared_ptr<Mesh>> geometry;
+    CHECK(!readSceneCacheGeometry(fixture.path, fixture.key, {0}, geometry));
+}
+
+static void testValidation() {
+    checkRejected([](Mesh& mesh) { mesh.indices[4] = mesh.vertices.size(); });
+    checkRejected([](Mesh& mesh) {
+        mesh.lods[0].indices[0] = mesh.vertices.size();
+    });
+    checkRejected([](Mesh& mesh) {
+        mesh.meshletVertices[0] = mesh.vertices.size();
+    });
+    checkRejected([](Mesh& mesh) {
+        mesh.meshletTriangles[0] = mesh.meshlets[0].vertexCount;
+    });
+    checkRejected([](Mesh& mesh) { mesh.meshlets.back().triangleCount++; });
+    // the scene has no bones at all
+    checkRejected([](Mesh& mesh) { mesh.vertices[0].boneIds[0] = 0; });
+}
+
+int main(int argc, char** argv) {
+    google::InitGoogleLogging(argv[0]);
+    testRoundTrip();
+    testStaleKey();
+    testValidation();
+    LOG(INFO) << "scene cache tests passed";
+    return 0;
+}
@@ -6,6 +6,12 @@ add_requires("imgui v1.89", {configs = {glfw_opengl3 = true, use_glad = true}})
 add_requires("glslang", {configs = {binaryonly = true}})
 add_requires("glad")
 
+option("avx2")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Build the SIMD kernels with AVX2 and FMA, see loo/simd.hpp")
+option_end()
+
 
 target("loo")
     set_kind("static")
@@ -24,6 +30,9 @@ target("loo")
         ogl_ver = "46"
     end
     add_defines("OGL_" .. ogl_ver, "_USE_MATH_DEFINES", "NOMINMAX", {public = true})
+    if has_config("avx2") then
+        add_vectorexts("avx2", "fma")
+    end
 
     on_config(function (target)
         local ogl_ver = "4.6"
@@ -37,3 +46,16 @@ target("loo")
     add_rules("utils.install.cmake_importfiles")
     add_rules("utils.install.pkgconfig_importfiles")
     -- add_rules("utils.symbols.export_all", {export_classes = true})
+
+-- one binary per tests/test_*.cpp, failures abort through glog CHECKs; run
+-- them with `xmake test`
+for _, file in ipairs(os.files("tests/test_*.cpp")) do
+    target(path.basename(file))
+        set_kind("binary")
+        set_default(false)
+        set_languages("cxx17")
+        add_deps("loo")
+        add_files(file)
+        add_tests("default")
+    target_end()
+end